@@ -22,9 +22,11 @@
  * THE SOFTWARE.
  */
 #include <cctype>
+#include <numeric>
 
 #include <graphene/app/api.hpp>
 #include <graphene/app/api_access.hpp>
+#include <graphene/app/api_worker_pool.hpp>
 #include <graphene/app/application.hpp>
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/get_config.hpp>
@@ -56,48 +58,64 @@ namespace graphene { namespace app {
 
    /* HELPERS begin */
 
-   time_point_sec get_block_time(const database_api& db_api, uint32_t block_num)
+   // fetches the operations of a page of archived operations, reading every block and every run of
+   // consecutive virtual operations only once; the result is in the order of the page
+   vector<optional<operation_history_object>> get_ohos_without_id(const database& db, const account_archive::account_archive_plugin& ap, const vector<operation_archive_object>& page)
    {
-      const auto& header = db_api.get_block_header(block_num);
-      return header.valid() ? header->timestamp : time_point_sec::min();
-   }
-
-   optional<operation> get_archived_operation(const database& db, const account_archive::account_archive_plugin& ap, const operation_archive_object& oao)
-   {
-      auto op = operation();
-      if (oao.has_virtual_op()) {
-         op = (ap.load(oao.get_virtual_op_db_index())).op;
-      } else {
-         const auto& block = db.fetch_block_by_number(oao.block_num);
-         if (block.valid() && ((size_t)oao.trx_in_block < block->transactions.size())) {
-            const auto& trx = block->transactions[oao.trx_in_block];
-            if ((size_t)oao.op_in_trx < trx.operations.size())
-               op = trx.operations[oao.op_in_trx];
-         }
-      }
-      return op;
-   }
-
-   optional<operation_history_object> get_oho_without_id(const database& db, const account_archive::account_archive_plugin& ap, const operation_archive_object& oao)
-   {
-      auto oho = operation_history_object();
-      if (oao.has_virtual_op()) {
-         oho = ap.load(oao.get_virtual_op_db_index());
-      } else {
-         const auto& block = db.fetch_block_by_number(oao.block_num);
-         if (block.valid() && ((size_t)oao.trx_in_block < block->transactions.size())) {
-            const auto& trx = block->transactions[oao.trx_in_block];
-            if ((size_t)oao.op_in_trx < trx.operations.size()) {
-               oho.op = trx.operations[oao.op_in_trx];
-               oho.result = trx.operation_results[oao.op_in_trx];
-               oho.block_num = oao.block_num;
-               oho.trx_in_block = oao.trx_in_block;
-               oho.op_in_trx = oao.op_in_trx;
-               oho.virtual_op = oao.virtual_op;
+      vector<optional<operation_history_object>> result(page.size(), operation_history_object());
+
+      // visit the page in storage order: virtual operations by operation_database index, the rest by block
+      vector<size_t> order(page.size());
+      std::iota(order.begin(), order.end(), 0);
+      const auto location = [&page](size_t i) {
+         const auto& oao = page[i];
+         return oao.has_virtual_op() ? std::make_pair(true, oao.get_virtual_op_db_index()) : std::make_pair(false, oao.block_num);
+      };
+      std::sort(order.begin(), order.end(), [&location](size_t a, size_t b) { return location(a) < location(b); });
+
+      for (size_t i = 0; i < order.size(); ) {
+         const auto& first = page[order[i]];
+         size_t j = i + 1;
+         if (first.has_virtual_op()) {
+            while (j < order.size() && page[order[j]].has_virtual_op()
+                   && page[order[j]].get_virtual_op_db_index() <= page[order[j - 1]].get_virtual_op_db_index() + 1)
+               j++;
+            const uint32_t begin = first.get_virtual_op_db_index();
+            const auto ohos = ap.load(begin, page[order[j - 1]].get_virtual_op_db_index() - begin + 1);
+            for (size_t k = i; k < j; k++)
+               result[order[k]] = ohos[page[order[k]].get_virtual_op_db_index() - begin];
+         } else {
+            while (j < order.size() && !page[order[j]].has_virtual_op() && page[order[j]].block_num == first.block_num)
+               j++;
+            if (j - i == 1) {
+               // a single operation of the block is unpacked on its own
+               const auto oho = db.fetch_block_operation(first.block_num, first.trx_in_block, first.op_in_trx);
+               if (oho.valid()) {
+                  result[order[i]] = *oho;
+                  result[order[i]]->virtual_op = first.virtual_op;
+               }
+            } else {
+               const auto block = db.fetch_shared_block_by_number(first.block_num);
+               for (size_t k = i; block && k < j; k++) {
+                  const auto& oao = page[order[k]];
+                  if ((size_t)oao.trx_in_block >= block->transactions.size())
+                     continue;
+                  const auto& trx = block->transactions[oao.trx_in_block];
+                  if ((size_t)oao.op_in_trx >= trx.operations.size())
+                     continue;
+                  auto& oho = *result[order[k]];
+                  oho.op = trx.operations[oao.op_in_trx];
+                  oho.result = trx.operation_results[oao.op_in_trx];
+                  oho.block_num = oao.block_num;
+                  oho.trx_in_block = oao.trx_in_block;
+                  oho.op_in_trx = oao.op_in_trx;
+                  oho.virtual_op = oao.virtual_op;
+               }
             }
          }
+         i = j;
       }
-      return oho;
+      return result;
    }
 
    bool check_query_index_input(size_t num_ops, size_t last, size_t count, size_t count_limit)
@@ -126,31 +144,26 @@ namespace graphene { namespace app {
       return (finder != account_archive.end()) ? &(*finder) : nullptr;
    }
 
-   object_id_type get_archived_operation_id(const account_archive_object* archive, const account_id_type* account, size_t index)
+   object_id_type get_archived_operation_id(const account_archive::account_archive_plugin& ap, const account_archive_object* archive, const account_id_type* account, size_t index)
    {
-      return account ? archive->operations[index] : operation_archive_id_type(index);
+      return account ? ap.get_account_operation(*archive, index) : operation_archive_id_type(index);
    }
 
-   fc::time_point_sec get_operation_time(
-         const database_api& db_api,
+   uint32_t get_operation_block_num(
+         const account_archive::account_archive_plugin& ap,
          const operation_archive_index& operation_archive,
          const account_archive_object* account_operations,
          const account_id_type* account,
          size_t index)
    {
-      const auto object_id = get_archived_operation_id(account_operations, account, index);
-      const auto op_object = static_cast<const operation_archive_object &>(operation_archive.get(object_id));
-      return get_block_time(db_api, op_object.block_num);
+      const auto object_id = get_archived_operation_id(ap, account_operations, account, index);
+      return operation_archive.at(object_id.instance()).block_num;
    }
 
-   inline int64_t pick_pivot(int64_t begin, int64_t end)
-   {
-      return (end + begin + 1) >> 1; // average rounded up
-   }
-
-   // finds last operation written later than 'time'
+   // finds the number of operations written earlier than 'time'
    size_t find_operation(
-         const database_api& db_api,
+         const database& db,
+         const account_archive::account_archive_plugin& ap,
          const operation_archive_index& operation_archive,
          const account_archive_object* account_operations,
          const account_id_type* account,
@@ -160,25 +173,41 @@ namespace graphene { namespace app {
       if ( !max_op_count )
          return 0;
 
-      // this is edge case, when every value is > than time and algorithm would return 1 instead of 0
-      auto first_time = get_operation_time(db_api, operation_archive, account_operations, account, 0);
-      if ( first_time >= time )
-         return 0;
+      // block timestamps are monotonic, so the time bound turns into a block number bound
+      const uint32_t block_num = std::min(ap.find_block_by_time(time), db.head_block_num() + 1);
 
-      // use binary search to find specific operation id
-      int64_t begin = 0;
-      int64_t end = (int64_t)max_op_count - 1;
+      // use binary search over the (in memory) operation archive to find the first operation in that block
+      size_t begin = 0;
+      size_t end = max_op_count;
       while (begin < end) {
-         const int64_t pivot = pick_pivot(begin, end);
-         auto pivot_time = get_operation_time(db_api, operation_archive, account_operations, account, pivot);
-         if (pivot_time < time) {
-            begin = pivot;
+         const size_t pivot = (begin + end) >> 1;
+         if (get_operation_block_num(ap, operation_archive, account_operations, account, pivot) < block_num) {
+            begin = pivot + 1;
          } else {
-            end = pivot - 1;
+            end = pivot;
          }
       };
 
-      return begin + 1; // move from index to id space
+      return begin;
+   }
+
+   void add_archived_operations(
+         const database& db,
+         const account_archive::account_archive_plugin& ap,
+         const vector<object_id_type>& ids,
+         const vector<operation_archive_object>& page,
+         archive_api::query_result& result)
+   {
+      const auto ohos = get_ohos_without_id(db, ap, page);
+      result.operations.reserve(ohos.size());
+      for (size_t i = 0; i < ohos.size(); i++) {
+         auto oho = ohos[i];
+         if (oho.valid()) {
+            FC_ASSERT((int64_t)oho->op.which() == (int64_t)page[i].operation_id);
+            oho->id = operation_history_id_type(ids[i].instance());
+            result.operations.push_back(*oho);
+         }
+      }
    }
 
    asset_id_type get_asset_id(const database_api& db_api, const string& id_or_symbol)
@@ -190,22 +219,6 @@ namespace graphene { namespace app {
       return result[0]->get_id();
    }
 
-   struct fee_retrieval_visitor
-   {
-      typedef share_type result_type;
-
-      const account_id_type& account_id;
-      const asset_id_type& asset_id;
-
-      fee_retrieval_visitor(const account_id_type& account_id, const asset_id_type& asset_id) : account_id(account_id), asset_id(asset_id) {}
-
-      template<typename OpType>
-      result_type operator()(OpType& op) const
-      {
-         return ((op.fee_payer() == account_id) && (op.fee.asset_id == asset_id)) ? op.fee.amount : 0;
-      }
-   };
-
    /* HELPERS end */
 
    const uint64_t archive_api::QueryLimitBase = 10;
@@ -224,7 +237,9 @@ namespace graphene { namespace app {
                                                                   uint64_t count,
                                                                   flat_set<int> operation_id_filter) const
    {
-      return my_get_archived_operations(nullptr, last, count, operation_id_filter);
+      return run_api_read(_app.get_api_workers(), "get_archived_operations", [&]() {
+         return my_get_archived_operations(nullptr, last, count, operation_id_filter);
+      });
    }
 
    archive_api::query_result archive_api::get_archived_operations_by_time(time_point_sec inclusive_from,
@@ -232,7 +247,9 @@ namespace graphene { namespace app {
                                                                           uint64_t skip_count,
                                                                           flat_set<int> operation_id_filter) const
    {
-      return my_get_archived_operations_by_time(nullptr, inclusive_from, exclusive_until, skip_count, operation_id_filter);
+      return run_api_read(_app.get_api_workers(), "get_archived_operations_by_time", [&]() {
+         return my_get_archived_operations_by_time(nullptr, inclusive_from, exclusive_until, skip_count, operation_id_filter);
+      });
    }
 
    archive_api::query_result archive_api::archive_api::get_archived_account_operations(const std::string account_id_or_name,
@@ -240,8 +257,10 @@ namespace graphene { namespace app {
                                                                                        uint64_t count,
                                                                                        flat_set<int> operation_id_filter) const
    {
-      const auto account_id = database_api.get_account_id_from_string(account_id_or_name);
-      return my_get_archived_operations(&account_id, last, count, operation_id_filter);
+      return run_api_read(_app.get_api_workers(), "get_archived_account_operations", [&]() {
+         const auto account_id = database_api.get_account_id_from_string(account_id_or_name);
+         return my_get_archived_operations(&account_id, last, count, operation_id_filter);
+      });
    }
 
    archive_api::query_result archive_api::get_archived_account_operations_by_time(const std::string account_id_or_name,
@@ -250,19 +269,23 @@ namespace graphene { namespace app {
                                                                                   uint64_t skip_count,
                                                                                   flat_set<int> operation_id_filter) const
    {
-      const auto account_id = database_api.get_account_id_from_string(account_id_or_name);
-      return my_get_archived_operations_by_time(&account_id, inclusive_from, exclusive_until, skip_count, operation_id_filter);
+      return run_api_read(_app.get_api_workers(), "get_archived_account_operations_by_time", [&]() {
+         const auto account_id = database_api.get_account_id_from_string(account_id_or_name);
+         return my_get_archived_operations_by_time(&account_id, inclusive_from, exclusive_until, skip_count, operation_id_filter);
+      });
    }
 
    uint64_t archive_api::get_archived_account_operation_count(const std::string account_id_or_name) const
    {
-      const auto db = _app.chain_database();
-
-      const auto acc_id = database_api.get_account_id_from_string(account_id_or_name);
-      const auto aao_id = account_archive_id_type(acc_id.instance);
-      const auto& acc_archive = db->get_index_type<account_archive_index>().indices().get<by_id>();
-      const auto& finder = acc_archive.find(aao_id);
-      return (finder != acc_archive.end()) ? (*finder).operations.size() : 0u;
+      return run_api_read(_app.get_api_workers(), "get_archived_account_operation_count", [&]() {
+         const auto db = _app.chain_database();
+
+         const auto acc_id = database_api.get_account_id_from_string(account_id_or_name);
+         const auto aao_id = account_archive_id_type(acc_id.instance);
+         const auto& acc_archive = db->get_index_type<account_archive_index>().indices().get<by_id>();
+         const auto& finder = acc_archive.find(aao_id);
+         return (finder != acc_archive.end()) ? (*finder).num_operations : 0u;
+      });
    }
 
    archive_api::summary_result archive_api::get_account_summary(const std::string account_id_or_name,
@@ -270,37 +293,28 @@ namespace graphene { namespace app {
                                                                 uint64_t last,
                                                                 uint64_t count) const
    {
-      auto result = archive_api::summary_result();
+      return run_api_read(_app.get_api_workers(), "get_account_summary", [&]() {
+         auto result = archive_api::summary_result();
 
-      const auto db = _app.chain_database();
-      const auto ap = _app.get_plugin<account_archive::account_archive_plugin>("account_archive");
-
-      const auto asset_id = get_asset_id(database_api, asset_id_or_name);
-      const auto account_id = database_api.get_account_id_from_string(account_id_or_name);
-      const auto& operation_archive = db->get_index_type<operation_archive_index>();
-      const account_archive_object* account_operations = get_account_operations(*db.get(), account_id);
-      if (!account_operations)
-         return result; // account created in genesis without any operations yet
+         const auto db = _app.chain_database();
+         const auto ap = _app.get_plugin<account_archive::account_archive_plugin>("account_archive");
 
-      size_t num_operations = account_operations->operations.size();
-      if (!check_query_index_input(num_operations, last, count, params.QueryInspectLimit))
-         return result;
+         const auto asset_id = get_asset_id(database_api, asset_id_or_name);
+         const auto account_id = database_api.get_account_id_from_string(account_id_or_name);
+         const account_archive_object* account_operations = get_account_operations(*db.get(), account_id);
+         result.summary.asset_id = asset_id;
+         if (!account_operations)
+            return result; // account created in genesis without any operations yet
 
-      // inspect archived operations
-      num_operations = last + 1; // number of operations left to query
-      count = std::min(count, params.QueryInspectLimit);
-      while (num_operations-- && count--) {
-         result.num_processed++;
-         const auto oao_id = get_archived_operation_id(account_operations, &account_id, num_operations);
-         const auto oao = static_cast<const operation_archive_object&>(operation_archive.get(oao_id));
-         const auto op = get_archived_operation(*db, *ap, oao);
-         if (op.valid()) {
-            FC_ASSERT((int64_t)(*op).which() == (int64_t)oao.operation_id);
-            update_summary(*db.get(), account_id, asset_id, *op, result.summary);
-         }
-      }
+         // the plugin keeps running totals, so a summary costs the same for any number of operations
+         const size_t num_operations = account_operations->num_operations;
+         if (!check_query_index_input(num_operations, last, count, num_operations))
+            return result;
 
-      return result;
+         result.num_processed = count;
+         result.summary = ap->get_account_summary(*account_operations, asset_id, last + 1 - count, last + 1);
+         return result;
+      });
    }
 
    archive_api::summary_result archive_api::get_account_summary_by_time(const std::string account_id_or_name,
@@ -309,46 +323,42 @@ namespace graphene { namespace app {
                                                                         time_point_sec exclusive_until,
                                                                         uint64_t skip_count) const
    {
-      auto result = archive_api::summary_result();
+      return run_api_read(_app.get_api_workers(), "get_account_summary_by_time", [&]() {
+         auto result = archive_api::summary_result();
 
-      const auto db = _app.chain_database();
-      const auto ap = _app.get_plugin<account_archive::account_archive_plugin>("account_archive");
+         const auto db = _app.chain_database();
+         const auto ap = _app.get_plugin<account_archive::account_archive_plugin>("account_archive");
 
-      const auto asset_id = get_asset_id(database_api, asset_id_or_name);
-      const auto account_id = database_api.get_account_id_from_string(account_id_or_name);
-      const auto& operation_archive = db->get_index_type<operation_archive_index>();
-      const account_archive_object* account_operations = get_account_operations(*db.get(), account_id);
-      if (!account_operations)
-         return result; // account created in genesis without any operations yet
+         const auto asset_id = get_asset_id(database_api, asset_id_or_name);
+         const auto account_id = database_api.get_account_id_from_string(account_id_or_name);
+         const auto& operation_archive = db->get_index_type<operation_archive_index>();
+         const account_archive_object* account_operations = get_account_operations(*db.get(), account_id);
+         result.summary.asset_id = asset_id;
+         if (!account_operations)
+            return result; // account created in genesis without any operations yet
 
-      size_t last_op_id = account_operations->operations.size();
-      size_t first_op_id = 0;
+         size_t last_op_id = account_operations->num_operations;
+         size_t first_op_id = 0;
 
-      if (!last_op_id)
-         return result;
+         if (!last_op_id)
+            return result;
 
-      last_op_id  = find_operation(database_api, operation_archive, account_operations, &account_id, last_op_id, exclusive_until);
-      first_op_id = find_operation(database_api, operation_archive, account_operations, &account_id, last_op_id, inclusive_from);
+         last_op_id  = find_operation(*db, *ap, operation_archive, account_operations, &account_id, last_op_id, exclusive_until);
+         first_op_id = find_operation(*db, *ap, operation_archive, account_operations, &account_id, last_op_id, inclusive_from);
 
-      if ( last_op_id > skip_count )
-         last_op_id -= skip_count;
-      else
-         last_op_id = 0;
+         if ( last_op_id > skip_count )
+            last_op_id -= skip_count;
+         else
+            last_op_id = 0;
 
-      // inspect operations inside the time window
-      while ((last_op_id > first_op_id) && (result.num_processed < params.QueryInspectLimit)) {
-         result.num_processed++;
-         const auto oao_id = get_archived_operation_id(account_operations, &account_id, last_op_id - 1);
-         const auto oao = static_cast<const operation_archive_object&>(operation_archive.get(oao_id));
-         const auto op = get_archived_operation(*db, *ap, oao);
-         if (op.valid()) {
-            FC_ASSERT((int64_t)(*op).which() == (int64_t)oao.operation_id);
-            update_summary(*db.get(), account_id, asset_id, *op, result.summary);
+         // summarize all operations inside the time window at once
+         if (last_op_id > first_op_id) {
+            result.num_processed = last_op_id - first_op_id;
+            result.summary = ap->get_account_summary(*account_operations, asset_id, first_op_id, last_op_id);
          }
-         last_op_id--;
-      }
 
-      return result;
+         return result;
+      });
    }
 
    archive_api::query_result archive_api::my_get_archived_operations(const account_id_type* account_id,
@@ -369,7 +379,7 @@ namespace graphene { namespace app {
          account_operations = get_account_operations(*db.get(), *account_id);
          if (!account_operations)
             return result; // account created in genesis without any operations yet
-         num_operations = account_operations->operations.size();
+         num_operations = account_operations->num_operations;
       } else {
          num_operations = operation_archive.size();
       }
@@ -381,24 +391,24 @@ namespace graphene { namespace app {
 
       result.operations.reserve(count);
 
-      // inspect archived operations
+      // gather the page of archived operations first, so that its operations are fetched in storage order
+      vector<object_id_type> ids;
+      vector<operation_archive_object> page;
+      ids.reserve(count);
+      page.reserve(count);
       num_operations = last + 1; // number of operations left to query
-      while (num_operations && count && (result.num_processed < params.QueryInspectLimit)) {
+      while (num_operations && (page.size() < count) && (result.num_processed < params.QueryInspectLimit)) {
          result.num_processed++;
-         const auto oa_id = get_archived_operation_id(account_operations, account_id, num_operations - 1);
-         const auto oao = static_cast<const operation_archive_object&>(operation_archive.get(oa_id));
+         const auto oa_id = get_archived_operation_id(*ap, account_operations, account_id, num_operations - 1);
+         const auto oao = operation_archive.at(oa_id.instance());
          if (!filter || (operation_id_filter.find((int)oao.operation_id) != filter_end)) {
-            auto oho = get_oho_without_id(*db, *ap, oao);
-            if (oho.valid()) {
-               FC_ASSERT((int64_t)oho->op.which() == (int64_t)oao.operation_id);
-               oho->id = operation_history_id_type(oa_id.instance());
-               result.operations.push_back(*oho);
-               count--;
-            }
+            ids.push_back(oa_id);
+            page.push_back(oao);
          }
          num_operations--;
       }
 
+      add_archived_operations(*db, *ap, ids, page, result);
       return result;
    }
 
@@ -425,7 +435,7 @@ namespace graphene { namespace app {
          account_operations = get_account_operations(*db.get(), *account_id);
          if (!account_operations)
             return result; // account created in genesis without any operations yet
-         last_op_id = account_operations->operations.size();
+         last_op_id = account_operations->num_operations;
       } else {
          last_op_id = operation_archive.size();
       }
@@ -435,271 +445,34 @@ namespace graphene { namespace app {
       const auto filter_end = operation_id_filter.end();
       const bool filter = check_query_opid_input(operation_id_filter);
 
-      last_op_id  = find_operation(database_api, operation_archive, account_operations, account_id, last_op_id, exclusive_until);
-      first_op_id = find_operation(database_api, operation_archive, account_operations, account_id, last_op_id, inclusive_from);
+      last_op_id  = find_operation(*db, *ap, operation_archive, account_operations, account_id, last_op_id, exclusive_until);
+      first_op_id = find_operation(*db, *ap, operation_archive, account_operations, account_id, last_op_id, inclusive_from);
 
       if ( last_op_id > skip_count )
          last_op_id -= skip_count;
       else
          last_op_id = 0;
 
-      result.operations.reserve(params.QueryResultLimit);
-
-      // inspect operations inside the time window
-      while ((last_op_id > first_op_id) && (result.num_processed < params.QueryInspectLimit)) {
-         const auto oa_id = get_archived_operation_id(account_operations, account_id, last_op_id - 1);
-         const auto oao = static_cast<const operation_archive_object&>(operation_archive.get(oa_id));
+      // gather the operations inside the time window first, so that they are fetched in storage order
+      vector<object_id_type> ids;
+      vector<operation_archive_object> page;
+      ids.reserve(params.QueryResultLimit);
+      page.reserve(params.QueryResultLimit);
+      while ((last_op_id > first_op_id) && (page.size() < params.QueryResultLimit) && (result.num_processed < params.QueryInspectLimit)) {
+         const auto oa_id = get_archived_operation_id(*ap, account_operations, account_id, last_op_id - 1);
+         const auto oao = operation_archive.at(oa_id.instance());
          result.num_processed++;
          if (!filter || (operation_id_filter.find((int)oao.operation_id) != filter_end)) {
-            auto oho = get_oho_without_id(*db, *ap, oao);
-            if (oho.valid()) {
-               FC_ASSERT((int64_t)oho->op.which() == (int64_t)oao.operation_id);
-               oho->id = operation_history_id_type(oa_id.instance());
-               result.operations.push_back(*oho);
-               if (result.operations.size() == params.QueryResultLimit)
-                  break;
-            }
+            ids.push_back(oa_id);
+            page.push_back(oao);
          }
          last_op_id--;
       }
 
+      add_archived_operations(*db, *ap, ids, page, result);
       return result;
    }
 
-   void archive_api::update_summary(const database& db,
-                                    account_id_type account_id,
-                                    asset_id_type asset_id,
-                                    const operation& op,
-                                    account_archive::account_summary& sum) const
-   {
-      switch(op.which()) {
-         case operation::tag<transfer_operation>::value:
-         {
-            const auto& o = op.get<transfer_operation>();
-            FC_ASSERT((o.from == account_id) || (o.to == account_id));
-            if (o.amount.asset_id == asset_id) {
-               if (o.from == account_id)
-                  sum.debits += o.amount.amount;
-               if (o.to == account_id)
-                  sum.credits += o.amount.amount;
-            }
-            break;
-         }
-         case operation::tag<limit_order_create_operation>::value:
-         {
-            const auto& o = op.get<limit_order_create_operation>();
-            FC_ASSERT(o.seller == account_id);
-            if (o.amount_to_sell.asset_id == asset_id) {
-               sum.debits += o.amount_to_sell.amount;
-            }
-            break;
-         }
-         case operation::tag<limit_order_cancel_operation>::value:
-         {
-            const auto& o = op.get<limit_order_cancel_operation>();
-            const auto& order = o.order(db);
-            FC_ASSERT(order.seller == account_id);
-            FC_ASSERT(order.sell_price.base.asset_id == asset_id);
-            sum.credits += order.sell_price.base.amount;
-            break;
-         }
-         case operation::tag<call_order_update_operation>::value:
-         {
-            const auto& o = op.get<call_order_update_operation>();
-            FC_ASSERT(o.funding_account == account_id);
-            if (o.delta_collateral.asset_id == asset_id) {
-               if (o.delta_collateral.amount > 0)
-                  sum.debits += o.delta_collateral.amount;
-               if (o.delta_collateral.amount < 0)
-                  sum.credits += o.delta_collateral.amount;
-            }
-            if (o.delta_debt.asset_id == asset_id) {
-               if (o.delta_debt.amount > 0)
-                  sum.credits += o.delta_debt.amount;
-               if (o.delta_debt.amount < 0)
-                  sum.debits += o.delta_debt.amount;
-            }
-            break;
-         }
-         case operation::tag<fill_order_operation>::value: // VIRTUAL
-         {
-            const auto& o = op.get<fill_order_operation>();
-            FC_ASSERT(o.account_id == account_id);
-            // seems to be accounted in the limit_order_create_operation
-            //if (o.pays.asset_id == asset_id)
-            //   sum.debits += o.pays.amount;
-            if (o.receives.asset_id == asset_id)
-               sum.credits += o.receives.amount;
-            break;
-         }
-         case operation::tag<asset_issue_operation>::value:
-         {
-            const auto& o = op.get<asset_issue_operation>();
-            FC_ASSERT((o.issuer == account_id) || (o.issue_to_account == account_id));
-            if ((o.asset_to_issue.asset_id == asset_id) && (o.issue_to_account == account_id))
-               sum.credits += o.asset_to_issue.amount;
-            break;
-         }
-         case operation::tag<asset_reserve_operation>::value:
-         {
-            const auto& o = op.get<asset_reserve_operation>();
-            FC_ASSERT(o.payer == account_id);
-            if (o.amount_to_reserve.asset_id == asset_id)
-               sum.debits += o.amount_to_reserve.amount;
-            break;
-         }
-         case operation::tag<asset_fund_fee_pool_operation>::value:
-         {
-            const auto& o = op.get<asset_fund_fee_pool_operation>();
-            FC_ASSERT(o.from_account == account_id);
-            if (o.asset_id == asset_id)
-               sum.debits += o.amount;
-            break;
-         }
-         case operation::tag<asset_settle_operation>::value:
-         {
-            const auto& o = op.get<asset_settle_operation>();
-            FC_ASSERT(o.account == account_id);
-            if (o.amount.asset_id == asset_id)
-               sum.debits += o.amount.amount;
-            break;
-         }
-         case operation::tag<withdraw_permission_claim_operation>::value:
-         {
-            const auto& o = op.get<withdraw_permission_claim_operation>();
-            FC_ASSERT((o.withdraw_from_account == account_id) || (o.withdraw_to_account == account_id));
-            if (o.amount_to_withdraw.asset_id == asset_id) {
-               if (o.withdraw_from_account == account_id)
-                  sum.debits += o.amount_to_withdraw.amount;
-               if (o.withdraw_to_account == account_id)
-                  sum.credits += o.amount_to_withdraw.amount;
-            }
-            break;
-         }
-         case operation::tag<vesting_balance_create_operation>::value:
-         {
-            const auto& o = op.get<vesting_balance_create_operation>();
-            if ((o.creator == account_id) && (o.amount.asset_id == asset_id))
-               sum.debits += o.amount.amount;
-            break;
-         }
-         case operation::tag<vesting_balance_withdraw_operation>::value:
-         {
-            const auto& o = op.get<vesting_balance_withdraw_operation>();
-            FC_ASSERT(o.owner == account_id);
-            if (o.amount.asset_id == asset_id)
-               sum.credits += o.amount.amount;
-            break;
-         }
-         case operation::tag<balance_claim_operation>::value:
-         {
-            const auto& o = op.get<balance_claim_operation>();
-            FC_ASSERT(o.deposit_to_account == account_id);
-            if (o.total_claimed.asset_id == asset_id)
-               sum.credits += o.total_claimed.amount;
-            break;
-         }
-         case operation::tag<override_transfer_operation>::value:
-         {
-            const auto& o = op.get<override_transfer_operation>();
-            FC_ASSERT((o.issuer == account_id) || (o.from == account_id) || (o.to == account_id));
-            if (o.amount.asset_id == asset_id) {
-               if (o.from == account_id)
-                  sum.debits += o.amount.amount;
-               if (o.to == account_id)
-                  sum.credits += o.amount.amount;
-            }
-            break;
-         }
-         case operation::tag<transfer_to_blind_operation>::value:
-         {
-            const auto& o = op.get<transfer_to_blind_operation>();
-            if ((o.from == account_id) && (o.amount.asset_id == asset_id))
-               sum.debits += o.amount.amount;
-            break;
-         }
-         case operation::tag<transfer_from_blind_operation>::value:
-         {
-            const auto& o = op.get<transfer_from_blind_operation>();
-            FC_ASSERT(o.to == account_id);
-            if (o.amount.asset_id == asset_id)
-               sum.credits += o.amount.amount;
-            break;
-         }
-         case operation::tag<asset_settle_cancel_operation>::value: // VIRTUAL
-         {
-            const auto& o = op.get<asset_settle_cancel_operation>();
-            FC_ASSERT(o.account == account_id);
-            if (o.amount.asset_id == asset_id)
-               sum.credits += o.amount.amount;
-            break;
-         }
-         case operation::tag<asset_claim_fees_operation>::value:
-         {
-            const auto& o = op.get<asset_claim_fees_operation>();
-            FC_ASSERT(o.issuer == account_id);
-            if (o.amount_to_claim.asset_id == asset_id)
-               sum.credits += o.amount_to_claim.amount;
-            break;
-         }
-         case operation::tag<bid_collateral_operation>::value:
-         {
-            const auto& o = op.get<bid_collateral_operation>();
-            FC_ASSERT(o.bidder == account_id);
-            if (o.additional_collateral.asset_id == asset_id)
-               sum.debits += o.additional_collateral.amount;
-            break;
-         }
-         case operation::tag<execute_bid_operation>::value: // VIRTUAL
-         {
-            const auto& o = op.get<execute_bid_operation>();
-            FC_ASSERT(o.bidder == account_id);
-            if (o.debt.asset_id == asset_id)
-               sum.credits += o.debt.amount;
-            break;
-         }
-         case operation::tag<asset_claim_pool_operation>::value:
-         {
-            const auto& o = op.get<asset_claim_pool_operation>();
-            FC_ASSERT(o.issuer == account_id);
-            if (o.amount_to_claim.asset_id == asset_id)
-               sum.credits += o.amount_to_claim.amount;
-            break;
-         }
-         default: // These don't modify balances directly.
-            // account_create_operation
-            // account_update_operation
-            // account_whitelist_operation
-            // account_upgrade_operation
-            // account_transfer_operation
-            // asset_create_operation
-            // asset_update_operation
-            // asset_update_bitasset_operation
-            // asset_update_feed_producers_operation
-            // asset_global_settle_operation
-            // asset_publish_feed_operation
-            // witness_create_operation
-            // witness_update_operation
-            // proposal_create_operation
-            // proposal_update_operation
-            // proposal_delete_operation
-            // withdraw_permission_create_operation
-            // withdraw_permission_update_operation
-            // withdraw_permission_delete_operation
-            // committee_member_create_operation
-            // committee_member_update_operation
-            // committee_member_update_global_parameters_operation
-            // worker_create_operation
-            // custom_operation
-            // assert_operation
-            // blind_transfer_operation
-            // fba_distribute_operation // VIRTUAL
-            // asset_update_issuer_operation
-            break;
-      }
-      sum.fees += op.visit(fee_retrieval_visitor(account_id, asset_id));
-   }
-
     login_api::login_api(application& a)
     :_app(a)
     {
@@ -735,7 +508,8 @@ namespace graphene { namespace app {
     {
        if( api_name == "database_api" )
        {
-          _database_api = std::make_shared< database_api >( std::ref( *_app.chain_database() ), &( _app.get_options() ) );
+          _database_api = std::make_shared< database_api >( std::ref( *_app.chain_database() ), &( _app.get_options() ),
+                                                            _app.get_api_workers() );
        }
        else if( api_name == "block_api" )
        {
@@ -844,7 +618,10 @@ namespace graphene { namespace app {
        _app.chain_database()->precompute_parallel( b ).wait();
        _app.chain_database()->push_block(b);
        if( _app.p2p_node() != nullptr )
-          _app.p2p_node()->broadcast( net::block_message( b ));
+       {
+          net::block_message block_msg( b );
+          _app.p2p_node()->broadcast( block_msg, block_msg.block_id );
+       }
     }
 
     void network_broadcast_api::broadcast_transaction_with_callback(confirmation_callback cb, const precomputable_transaction& trx)
@@ -882,6 +659,13 @@ namespace graphene { namespace app {
        return _app.p2p_node()->get_potential_peers();
     }
 
+    fc::variant_object network_node_api::get_api_call_statistics() const
+    {
+       const api_worker_pool* workers = _app.get_api_workers();
+       FC_ASSERT( workers != nullptr, "No API worker threads are running, see the api-worker-threads option" );
+       return workers->get_call_statistics();
+    }
+
     fc::variant_object network_node_api::get_advanced_node_parameters() const
     {
        return _app.p2p_node()->get_advanced_node_parameters();
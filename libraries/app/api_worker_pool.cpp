@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/api_worker_pool.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace app {
+
+api_worker_pool::api_worker_pool( const graphene::chain::database& db, uint16_t num_threads )
+   : _db( db )
+{
+   FC_ASSERT( num_threads > 0, "The API worker pool needs at least one thread" );
+   _workers.reserve( num_threads );
+   for( uint16_t i = 0; i < num_threads; ++i )
+   {
+      _workers.emplace_back( new worker() );
+      _workers.back()->thread.reset( new fc::thread( "api worker " + std::to_string( i ) ) );
+   }
+   ilog( "Running read-only API calls on ${n} worker threads", ("n", num_threads) );
+}
+
+api_worker_pool::~api_worker_pool() {}
+
+api_worker_pool::worker& api_worker_pool::least_busy_worker()
+{
+   return **std::min_element( _workers.begin(), _workers.end(),
+                              []( const std::unique_ptr<worker>& a, const std::unique_ptr<worker>& b ) {
+                                 return a->calls.load() < b->calls.load();
+                              } );
+}
+
+api_worker_pool::call_timer::call_timer( api_worker_pool& p, worker& w, const char* m )
+   : pool( p ), work( w ), method( m ), queued( fc::time_point::now() ), started( queued ), finished( queued )
+{
+   ++work.calls;
+}
+
+api_worker_pool::call_timer::~call_timer()
+{
+   --work.calls;
+   pool.record( method, started - queued, finished - started );
+}
+
+void api_worker_pool::record( const char* method, const fc::microseconds& queue_time,
+                              const fc::microseconds& execution_time )
+{
+   {
+      std::lock_guard<std::mutex> guard( _statistics_mutex );
+      method_statistics& stats = _statistics[method];
+      ++stats.count;
+      stats.queue_time_sum += queue_time.count();
+      stats.queue_time_max = std::max<uint64_t>( stats.queue_time_max, queue_time.count() );
+      stats.execution_time_sum += execution_time.count();
+      stats.execution_time_max = std::max<uint64_t>( stats.execution_time_max, execution_time.count() );
+   }
+   if( queue_time + execution_time > fc::milliseconds(500) )
+      ilog( "API call ${method} took ${total}us, longer than our target maximum of 500ms: it waited ${queue}us "
+            "for a worker and the database lock, and ran for ${execution}us",
+            ("method", method)("total", (queue_time + execution_time).count())
+            ("queue", queue_time.count())("execution", execution_time.count()) );
+}
+
+fc::variant_object api_worker_pool::get_call_statistics()const
+{
+   fc::mutable_variant_object statistics;
+   statistics["_note"] = "All times are in microseconds, queue time is the wait for a worker and the database lock";
+   std::lock_guard<std::mutex> guard( _statistics_mutex );
+   for( const auto& entry : _statistics )
+   {
+      const method_statistics& stats = entry.second;
+      fc::mutable_variant_object method_stats;
+      method_stats["count"] = stats.count;
+      method_stats["queue_time_mean"] = stats.queue_time_sum / stats.count;
+      method_stats["queue_time_max"] = stats.queue_time_max;
+      method_stats["queue_time_sum"] = stats.queue_time_sum;
+      method_stats["execution_time_mean"] = stats.execution_time_sum / stats.count;
+      method_stats["execution_time_max"] = stats.execution_time_max;
+      method_stats["execution_time_sum"] = stats.execution_time_sum;
+      statistics[entry.first] = method_stats;
+   }
+   return statistics;
+}
+
+} } // graphene::app
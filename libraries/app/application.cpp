@@ -30,6 +30,7 @@
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/protocol/fee_schedule.hpp>
 #include <graphene/protocol/operations_permissions.hpp>
+#include <graphene/protocol/recovered_key_cache.hpp>
 #include <graphene/protocol/types.hpp>
 
 #include <graphene/egenesis/egenesis.hpp>
@@ -464,6 +465,57 @@ void application_impl::startup()
       _chain_db->enable_standby_votes_tracking( _options->at("enable-standby-votes-tracking").as<bool>() );
    }
 
+   if( _options->count("block-cache-size") )
+   {
+      _chain_db->set_block_cache_capacity( _options->at("block-cache-size").as<uint64_t>() * 1024 * 1024 );
+   }
+
+   if( _options->count("pending-pool-size") || _options->count("pending-transactions-per-account") )
+   {
+      const uint64_t max_size = _options->count("pending-pool-size")
+                                ? _options->at("pending-pool-size").as<uint64_t>() * 1024 * 1024 : 0;
+      const uint32_t max_per_account = _options->count("pending-transactions-per-account")
+                                       ? _options->at("pending-transactions-per-account").as<uint32_t>() : 0;
+      _chain_db->set_pending_pool_limits( max_size, max_per_account );
+   }
+
+   if( _options->count("api-worker-threads") && _options->at("api-worker-threads").as<uint16_t>() > 0 )
+   {
+      _api_workers.reset( new api_worker_pool( *_chain_db, _options->at("api-worker-threads").as<uint16_t>() ) );
+   }
+
+   if( _options->count("recovered-key-cache-size") )
+   {
+      graphene::protocol::recovered_key_cache::instance().set_capacity(
+            _options->at("recovered-key-cache-size").as<uint64_t>() );
+   }
+
+   if( _options->count("db-checkpoint-interval") )
+   {
+      _chain_db->set_db_checkpoint_interval( _options->at("db-checkpoint-interval").as<uint32_t>() );
+   }
+
+   if( _options->count("replay-queue-depth") )
+   {
+      _chain_db->set_replay_queue_depth( _options->at("replay-queue-depth").as<uint32_t>() );
+   }
+
+   if( _options->count("replay-threads") )
+   {
+      _chain_db->set_replay_threads( _options->at("replay-threads").as<uint32_t>() );
+   }
+
+   if( _options->count("bootstrap-snapshot") )
+   {
+      fc::optional<fc::sha256> state_hash;
+      if( _options->count("bootstrap-state-hash") )
+         state_hash = fc::sha256( _options->at("bootstrap-state-hash").as<string>() );
+      else
+         wlog( "Starting from a snapshot without bootstrap-state-hash, the snapshot is trusted as it is" );
+      _chain_db->set_bootstrap_snapshot( _options->at("bootstrap-snapshot").as<boost::filesystem::path>(),
+                                         state_hash );
+   }
+
    if( _options->count("replay-blockchain") || _options->count("revalidate-blockchain") )
       _chain_db->wipe( _data_dir / "blockchain", false );
 
@@ -751,13 +803,13 @@ message application_impl::get_item(const item_id& id)
   // ilog("Request for item ${id}", ("id", id));
    if( id.item_type == graphene::net::block_message_type )
    {
-      auto opt_block = _chain_db->fetch_block_by_id(id.item_hash);
-      if( !opt_block )
+      auto block = _chain_db->fetch_shared_block_by_id(id.item_hash);
+      if( !block )
          elog("Couldn't find block ${id} -- corresponding ID in our chain is ${id2}",
               ("id", id.item_hash)("id2", _chain_db->get_block_id_for_num(block_header::num_from_id(id.item_hash))));
-      FC_ASSERT( opt_block.valid() );
-      // ilog("Serving up block #${num}", ("num", opt_block->block_num()));
-      return block_message(std::move(*opt_block));
+      FC_ASSERT( block );
+      // ilog("Serving up block #${num}", ("num", block->block_num()));
+      return block_message(*block);
    }
    return trx_message( _chain_db->get_recent_transaction( id.item_hash ) );
 } FC_CAPTURE_AND_RETHROW( (id) ) }
@@ -976,8 +1028,8 @@ uint32_t application_impl::get_block_number(const item_hash_t& block_id)
  */
 fc::time_point_sec application_impl::get_block_time(const item_hash_t& block_id)
 { try {
-   auto opt_block = _chain_db->fetch_block_by_id( block_id );
-   if( opt_block.valid() ) return opt_block->timestamp;
+   auto block = _chain_db->fetch_shared_block_by_id( block_id );
+   if( block ) return block->timestamp;
    return fc::time_point_sec::min();
 } FC_CAPTURE_AND_RETHROW( (block_id) ) }
 
@@ -1056,6 +1108,31 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("enable-standby-votes-tracking", bpo::value<bool>()->implicit_value(true),
           "Whether to enable tracking of votes of standby witnesses and committee members. "
           "Set it to true to provide accurate data to API clients, set to false for slightly better performance.")
+         ("block-cache-size", bpo::value<uint64_t>()->default_value(64),
+          "Maximum size in MiB of the irreversible blocks kept decoded in memory for API and p2p reads, 0 to disable")
+         ("pending-pool-size", bpo::value<uint64_t>()->default_value(64),
+          "Maximum size in MiB of the pending transactions. When it is reached, a new transaction evicts the "
+          "ones with a lower fee per byte, or is refused. 0 for no limit")
+         ("pending-transactions-per-account", bpo::value<uint32_t>()->default_value(1000),
+          "Maximum number of pending transactions whose fee is paid by the same account, 0 for no limit")
+         ("api-worker-threads", bpo::value<uint16_t>()->default_value(0),
+          "Number of threads running read-only API calls, such as get_objects and get_full_accounts, "
+          "beside block processing. 0 to run them on the API thread")
+         ("recovered-key-cache-size", bpo::value<uint64_t>()->default_value(100000),
+          "Maximum number of public keys recovered from transaction signatures kept in memory, so that a "
+          "transaction received before its block is not recovered again, 0 to disable")
+         ("db-checkpoint-interval", bpo::value<uint32_t>()->default_value(10000),
+          "Number of blocks between writing the changed objects to disk, so that a restart after a crash only "
+          "replays the blocks since then, 0 to disable")
+         ("replay-queue-depth", bpo::value<uint32_t>()->default_value(256),
+          "Maximum number of blocks waiting between two stages of the replay (read, decode, apply)")
+         ("replay-threads", bpo::value<uint32_t>()->default_value(0),
+          "Number of threads decoding and precomputing blocks during replay, 0 for one per CPU core")
+         ("bootstrap-snapshot", bpo::value<boost::filesystem::path>(),
+          "Binary snapshot to load the state from when there is no object database yet, "
+          "so that only the blocks after the snapshot are replayed or synced")
+         ("bootstrap-state-hash", bpo::value<string>(),
+          "State hash the bootstrap snapshot must have, as published by a trusted node")
          ("api-limit-get-account-history-operations",boost::program_options::value<uint64_t>()->default_value(100),
           "For history_api::get_account_history_operations to set its default limit value as 100")
          ("api-limit-get-account-history",boost::program_options::value<uint64_t>()->default_value(100),
@@ -1152,6 +1229,11 @@ std::shared_ptr<chain::database> application::chain_database() const
    return my->_chain_db;
 }
 
+api_worker_pool* application::get_api_workers() const
+{
+   return my->_api_workers.get();
+}
+
 void application::set_block_production(bool producing_blocks)
 {
    my->_is_block_producer = producing_blocks;
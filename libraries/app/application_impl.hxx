@@ -5,6 +5,7 @@
 
 #include <graphene/app/application.hpp>
 #include <graphene/app/api_access.hpp>
+#include <graphene/app/api_worker_pool.hpp>
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/protocol/types.hpp>
 #include <graphene/net/message.hpp>
@@ -189,6 +190,8 @@ class application_impl : public net::node_delegate
       api_access _apiaccess;
 
       std::shared_ptr<graphene::chain::database>            _chain_db;
+      /// declared after the database, so that the workers reading it are stopped first
+      std::unique_ptr<api_worker_pool>                      _api_workers;
       std::shared_ptr<graphene::net::node>                  _p2p_network;
       std::shared_ptr<fc::http::websocket_server>      _websocket_server;
       std::shared_ptr<fc::http::websocket_tls_server>  _websocket_tls_server;
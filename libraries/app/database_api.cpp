@@ -23,7 +23,9 @@
  */
 
 #include <graphene/app/database_api.hpp>
+#include <graphene/app/api_worker_pool.hpp>
 #include <graphene/app/util.hpp>
+#include "subscription_hub.hxx"
 #include <graphene/chain/get_config.hpp>
 #include <graphene/chain/hardfork.hpp>
 #include <graphene/protocol/address.hpp>
@@ -45,16 +47,15 @@
 
 #define GET_REQUIRED_FEES_MAX_RECURSION 4
 
-typedef std::map< std::pair<graphene::chain::asset_id_type, graphene::chain::asset_id_type>, std::vector<fc::variant> > market_queue_type;
-
 template class fc::api<graphene::app::database_api>;
 
 namespace graphene { namespace app {
 
-class database_api_impl : public std::enable_shared_from_this<database_api_impl>
+class database_api_impl : public std::enable_shared_from_this<database_api_impl>, public detail::subscription_hub::subscriber
 {
    public:
-      explicit database_api_impl( graphene::chain::database& db, const application_options* app_options );
+      explicit database_api_impl( graphene::chain::database& db, const application_options* app_options,
+                                  api_worker_pool* api_workers );
       ~database_api_impl();
 
 
@@ -204,19 +205,25 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       template<typename T>
       void subscribe_to_item( const T& item )const
       {
-         if( !_subscribe_callback )
-            return;
-
-         vector<char> key = get_subscription_key( item );
-         if( !_subscribe_filter.contains( key.data(), key.size() ) )
          {
-            _subscribe_filter.insert( key.data(), key.size() );
+            std::lock_guard<std::mutex> guard( _subscribe_mutex );
+            if( !_subscribe_callback )
+               return;
+
+            vector<char> key = get_subscription_key( item );
+            if( !_subscribe_filter.contains( key.data(), key.size() ) )
+            {
+               _subscribe_filter.insert( key.data(), key.size() );
+            }
          }
+         // the hub calls is_subscribed_to_item() under its own lock, so it is not called under ours
+         _subscription_hub->subscribe_to_object( *this, item );
       }
 
       template<typename T>
       bool is_subscribed_to_item( const T& item )const
       {
+         std::lock_guard<std::mutex> guard( _subscribe_mutex );
          if( !_subscribe_callback )
             return false;
 
@@ -224,25 +231,6 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
          return _subscribe_filter.contains( key.data(), key.size() );
       }
 
-      bool is_impacted_account( const flat_set<account_id_type>& accounts)
-      {
-         if( !_subscribed_accounts.size() || !accounts.size() )
-            return false;
-
-         return std::any_of(accounts.begin(), accounts.end(), [this](const account_id_type& account) {
-            return _subscribed_accounts.find(account) != _subscribed_accounts.end();
-         });
-      }
-
-      const std::pair<asset_id_type,asset_id_type> get_order_market( const force_settlement_object& order )
-      {
-         // TODO cache the result to avoid repeatly fetching from db
-         asset_id_type backing_id = order.balance.asset_id( _db ).bitasset_data( _db ).options.short_backing_asset;
-         auto tmp = std::make_pair( order.balance.asset_id, backing_id );
-         if( tmp.first > tmp.second ) std::swap( tmp.first, tmp.second );
-         return tmp;
-      }
-
       const account_object* get_account_from_string( const std::string& name_or_id, bool throw_if_not_found = true ) const
       {
          // TODO cache the result to avoid repeatly fetching from db
@@ -328,37 +316,17 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
          return result;
       }
 
-      template<typename T>
-      const std::pair<asset_id_type,asset_id_type> get_order_market( const T& order )
-      {
-         return order.get_market();
-      }
-
-      template<typename T>
-      void enqueue_if_subscribed_to_market(const object* obj, market_queue_type& queue, bool full_object=true)
-      {
-         const T* order = dynamic_cast<const T*>(obj);
-         FC_ASSERT( order != nullptr);
-
-         const auto& market = get_order_market( *order );
-
-         auto sub = _market_subscriptions.find( market );
-         if( sub != _market_subscriptions.end() ) {
-            queue[market].emplace_back( full_object ? obj->to_variant() : fc::variant(obj->id, 1) );
-         }
-      }
+      /** called by the subscription hub with the changes this session is subscribed to */
+      bool is_subscribed_to_object( object_id_type id )const override;
+      void notify_objects( const vector<variant>& updates )const override;
+      void notify_markets( const vector<pair<detail::market_type, variant>>& updates )const override;
 
-      void broadcast_updates( const vector<variant>& updates );
-      void broadcast_market_updates( const market_queue_type& queue);
-      void handle_object_changed(bool force_notify, bool full_object, const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts, std::function<const object*(object_id_type id)> find_object);
-
-      /** called every time a block is applied to report the objects that were changed */
-      void on_objects_new(const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts);
-      void on_objects_changed(const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts);
-      void on_objects_removed(const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_id_type>& impacted_accounts);
+      /** called every time a block is applied */
       void on_applied_block();
 
       bool _notify_remove_create = false;
+      /** guards the subscription callback, filter and accounts, which calls on API worker threads update */
+      mutable std::mutex _subscribe_mutex;
       mutable fc::bloom_filter _subscribe_filter;
       std::set<account_id_type> _subscribed_accounts;
       std::function<void(const fc::variant&)> _subscribe_callback;
@@ -366,14 +334,13 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       std::function<void(const fc::variant&)> _block_applied_callback;
       bool _enabled_auto_subscription = true;
 
-      boost::signals2::scoped_connection                                                                                           _new_connection;
-      boost::signals2::scoped_connection                                                                                           _change_connection;
-      boost::signals2::scoped_connection                                                                                           _removed_connection;
+      std::shared_ptr<detail::subscription_hub>                                                                                    _subscription_hub;
       boost::signals2::scoped_connection                                                                                           _applied_block_connection;
       boost::signals2::scoped_connection                                                                                           _pending_trx_connection;
       map< pair<asset_id_type,asset_id_type>, std::function<void(const variant&)> >      _market_subscriptions;
       graphene::chain::database&                                                                                                            _db;
       const application_options* _app_options = nullptr;
+      api_worker_pool* _api_workers = nullptr;
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -382,24 +349,17 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 //                                                                  //
 //////////////////////////////////////////////////////////////////////
 
-database_api::database_api( graphene::chain::database& db, const application_options* app_options )
-   : my( new database_api_impl( db, app_options ) ) {}
+database_api::database_api( graphene::chain::database& db, const application_options* app_options,
+                            api_worker_pool* api_workers )
+   : my( new database_api_impl( db, app_options, api_workers ) ) {}
 
 database_api::~database_api() {}
 
-database_api_impl::database_api_impl( graphene::chain::database& db, const application_options* app_options )
-:_db(db), _app_options(app_options)
+database_api_impl::database_api_impl( graphene::chain::database& db, const application_options* app_options,
+                                      api_worker_pool* api_workers )
+:_subscription_hub(detail::subscription_hub::get(db)), _db(db), _app_options(app_options), _api_workers(api_workers)
 {
    dlog("creating database api ${x}", ("x",int64_t(this)) );
-   _new_connection = _db.new_objects.connect([this](const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts) {
-                                on_objects_new(ids, impacted_accounts);
-                                });
-   _change_connection = _db.changed_objects.connect([this](const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts) {
-                                on_objects_changed(ids, impacted_accounts);
-                                });
-   _removed_connection = _db.removed_objects.connect([this](const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_id_type>& impacted_accounts) {
-                                on_objects_removed(ids, objs, impacted_accounts);
-                                });
    _applied_block_connection = _db.applied_block.connect([this](const signed_block&){ on_applied_block(); });
 
    _pending_trx_connection = _db.on_pending_transaction.connect([this](const signed_transaction& trx ){
@@ -409,6 +369,7 @@ database_api_impl::database_api_impl( graphene::chain::database& db, const appli
 
 database_api_impl::~database_api_impl()
 {
+   _subscription_hub->cancel_subscriptions( *this, true );
    dlog("freeing database api ${x}", ("x",int64_t(this)) );
 }
 
@@ -485,12 +446,14 @@ market_ticker::market_ticker(const fc::time_point_sec& now,
 
 fc::variants database_api::get_objects(const vector<object_id_type>& ids)const
 {
-   return my->get_objects( ids );
+   return run_api_read( my->_api_workers, "get_objects", [&]() {
+      return my->get_objects( ids );
+   } );
 }
 
 fc::variants database_api_impl::get_objects(const vector<object_id_type>& ids)const
 {
-   if( _subscribe_callback && _enabled_auto_subscription )
+   if( _enabled_auto_subscription )
    {
       for( auto id : ids )
       {
@@ -534,8 +497,10 @@ void database_api_impl::set_subscribe_callback( std::function<void(const variant
 
    cancel_all_subscriptions(false, false);
 
+   std::lock_guard<std::mutex> guard( _subscribe_mutex );
    _subscribe_callback = cb;
    _notify_remove_create = notify_remove_create;
+   _subscription_hub->set_notify_remove_create( *this, notify_remove_create );
 }
 
 void database_api::set_auto_subscription( bool enable )
@@ -575,15 +540,16 @@ void database_api::cancel_all_subscriptions()
 
 void database_api_impl::cancel_all_subscriptions( bool reset_callback, bool reset_market_subscriptions )
 {
-   if ( reset_callback )
-      _subscribe_callback = std::function<void(const fc::variant&)>();
-
    if ( reset_market_subscriptions )
       _market_subscriptions.clear();
 
    _notify_remove_create = false;
-   _subscribed_accounts.clear();
+   _subscription_hub->cancel_subscriptions( *this, reset_market_subscriptions );
    static fc::bloom_parameters param(10000, 1.0/100, 1024*8*8*2);
+   std::lock_guard<std::mutex> guard( _subscribe_mutex );
+   if ( reset_callback )
+      _subscribe_callback = std::function<void(const fc::variant&)>();
+   _subscribed_accounts.clear();
    _subscribe_filter = fc::bloom_filter(param);
 }
 
@@ -600,14 +566,16 @@ optional<block_header> database_api::get_block_header(uint32_t block_num)const
 
 optional<block_header> database_api_impl::get_block_header(uint32_t block_num) const
 {
-   auto result = _db.fetch_block_by_number(block_num);
+   auto result = _db.fetch_block_header_by_number(block_num);
    if(result)
       return *result;
    return {};
 }
 map<uint32_t, optional<block_header>> database_api::get_block_header_batch(const vector<uint32_t> block_nums)const
 {
-   return my->get_block_header_batch( block_nums );
+   return run_api_read( my->_api_workers, "get_block_header_batch", [&]() {
+      return my->get_block_header_batch( block_nums );
+   } );
 }
 
 map<uint32_t, optional<block_header>> database_api_impl::get_block_header_batch(const vector<uint32_t> block_nums) const
@@ -622,7 +590,9 @@ map<uint32_t, optional<block_header>> database_api_impl::get_block_header_batch(
 
 optional<signed_block> database_api::get_block(uint32_t block_num)const
 {
-   return my->get_block( block_num );
+   return run_api_read( my->_api_workers, "get_block", [&]() {
+      return my->get_block( block_num );
+   } );
 }
 
 optional<signed_block> database_api_impl::get_block(uint32_t block_num)const
@@ -632,7 +602,9 @@ optional<signed_block> database_api_impl::get_block(uint32_t block_num)const
 
 processed_transaction database_api::get_transaction( uint32_t block_num, uint32_t trx_in_block )const
 {
-   return my->get_transaction( block_num, trx_in_block );
+   return run_api_read( my->_api_workers, "get_transaction", [&]() {
+      return my->get_transaction( block_num, trx_in_block );
+   } );
 }
 
 optional<signed_transaction> database_api::get_recent_transaction_by_id( const transaction_id_type& id )const
@@ -644,12 +616,24 @@ optional<signed_transaction> database_api::get_recent_transaction_by_id( const t
    }
 }
 
+block_cache_stats database_api::get_block_cache_stats()const
+{
+   return my->_db.get_block_cache_stats();
+}
+
+pending_pool_stats database_api::get_pending_pool_stats()const
+{
+   return run_api_read( my->_api_workers, "get_pending_pool_stats", [&]() {
+      return my->_db.get_pending_pool_stats();
+   } );
+}
+
 processed_transaction database_api_impl::get_transaction(uint32_t block_num, uint32_t trx_num)const
 {
-   auto opt_block = _db.fetch_block_by_number(block_num);
-   FC_ASSERT( opt_block );
-   FC_ASSERT( opt_block->transactions.size() > trx_num );
-   return opt_block->transactions[trx_num];
+   auto block = _db.fetch_shared_block_by_number(block_num);
+   FC_ASSERT( block );
+   FC_ASSERT( block->transactions.size() > trx_num );
+   return block->transactions[trx_num];
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -716,7 +700,9 @@ dynamic_global_property_object database_api_impl::get_dynamic_global_properties(
 
 vector<flat_set<account_id_type>> database_api::get_key_references( vector<public_key_type> key )const
 {
-   return my->get_key_references( key );
+   return run_api_read( my->_api_workers, "get_key_references", [&]() {
+      return my->get_key_references( key );
+   } );
 }
 
 /**
@@ -810,7 +796,9 @@ account_id_type database_api::get_account_id_from_string(const std::string& name
 
 vector<optional<account_object>> database_api::get_accounts(const vector<std::string>& account_names_or_ids)const
 {
-   return my->get_accounts( account_names_or_ids );
+   return run_api_read( my->_api_workers, "get_accounts", [&]() {
+      return my->get_accounts( account_names_or_ids );
+   } );
 }
 
 vector<optional<account_object>> database_api_impl::get_accounts(const vector<std::string>& account_names_or_ids)const
@@ -832,7 +820,9 @@ vector<optional<account_object>> database_api_impl::get_accounts(const vector<st
 vector<limit_order_object> database_api::get_account_limit_orders( const string& account_name_or_id, const string &base,
         const string &quote, uint32_t limit, optional<limit_order_id_type> ostart_id, optional<price> ostart_price)
 {
-   return my->get_account_limit_orders( account_name_or_id, base, quote, limit, ostart_id, ostart_price );
+   return run_api_read( my->_api_workers, "get_account_limit_orders", [&]() {
+      return my->get_account_limit_orders( account_name_or_id, base, quote, limit, ostart_id, ostart_price );
+   } );
 }
 
 vector<limit_order_object> database_api_impl::get_account_limit_orders( const string& account_name_or_id, const string &base,
@@ -917,7 +907,9 @@ vector<limit_order_object> database_api_impl::get_account_limit_orders( const st
 
 std::map<string,full_account> database_api::get_full_accounts( const vector<string>& names_or_ids, bool subscribe )
 {
-   return my->get_full_accounts( names_or_ids, subscribe );
+   return run_api_read( my->_api_workers, "get_full_accounts", [&]() {
+      return my->get_full_accounts( names_or_ids, subscribe );
+   } );
 }
 
 std::map<std::string, full_account> database_api_impl::get_full_accounts( const vector<std::string>& names_or_ids, bool subscribe)
@@ -937,8 +929,17 @@ std::map<std::string, full_account> database_api_impl::get_full_accounts( const
 
       if( subscribe )
       {
-         if(_subscribed_accounts.size() < 100) {
-            _subscribed_accounts.insert( account->get_id() );
+         bool subscribing = false;
+         {
+            std::lock_guard<std::mutex> guard( _subscribe_mutex );
+            if( _subscribed_accounts.size() < 100 )
+            {
+               _subscribed_accounts.insert( account->get_id() );
+               subscribing = true;
+            }
+         }
+         if( subscribing ) {
+            _subscription_hub->subscribe_to_account( *this, account->get_id() );
             subscribe_to_item( account->id );
          }
       }
@@ -1138,7 +1139,9 @@ vector<optional<account_object>> database_api_impl::lookup_account_names(const v
 
 map<string,account_id_type> database_api::lookup_accounts(const string& lower_bound_name, uint32_t limit)const
 {
-   return my->lookup_accounts( lower_bound_name, limit );
+   return run_api_read( my->_api_workers, "lookup_accounts", [&]() {
+      return my->lookup_accounts( lower_bound_name, limit );
+   } );
 }
 
 map<string,account_id_type> database_api_impl::lookup_accounts(const string& lower_bound_name, uint32_t limit)const
@@ -1181,7 +1184,9 @@ uint64_t database_api_impl::get_account_count()const
 
 vector<asset> database_api::get_account_balances(const std::string& account_name_or_id, const flat_set<asset_id_type>& assets)const
 {
-   return my->get_account_balances( account_name_or_id, assets );
+   return run_api_read( my->_api_workers, "get_account_balances", [&]() {
+      return my->get_account_balances( account_name_or_id, assets );
+   } );
 }
 
 vector<asset> database_api_impl::get_account_balances(const std::string& account_name_or_id, const flat_set<asset_id_type>& assets)const
@@ -1210,12 +1215,16 @@ vector<asset> database_api_impl::get_account_balances(const std::string& account
 
 vector<asset> database_api::get_named_account_balances(const std::string& name, const flat_set<asset_id_type>& assets)const
 {
-   return my->get_account_balances( name, assets );
+   return run_api_read( my->_api_workers, "get_named_account_balances", [&]() {
+      return my->get_account_balances( name, assets );
+   } );
 }
 
 vector<balance_object> database_api::get_balance_objects( const vector<address>& addrs )const
 {
-   return my->get_balance_objects( addrs );
+   return run_api_read( my->_api_workers, "get_balance_objects", [&]() {
+      return my->get_balance_objects( addrs );
+   } );
 }
 
 vector<balance_object> database_api_impl::get_balance_objects( const vector<address>& addrs )const
@@ -1261,7 +1270,9 @@ vector<asset> database_api_impl::get_vested_balances( const vector<balance_id_ty
 
 vector<vesting_balance_object> database_api::get_vesting_balances( const std::string account_id_or_name )const
 {
-   return my->get_vesting_balances( account_id_or_name );
+   return run_api_read( my->_api_workers, "get_vesting_balances", [&]() {
+      return my->get_vesting_balances( account_id_or_name );
+   } );
 }
 
 vector<vesting_balance_object> database_api_impl::get_vesting_balances( const std::string account_id_or_name )const
@@ -1293,7 +1304,9 @@ asset_id_type database_api::get_asset_id_from_string(const std::string& symbol_o
 
 vector<optional<asset_object>> database_api::get_assets(const vector<std::string>& asset_symbols_or_ids)const
 {
-   return my->get_assets( asset_symbols_or_ids );
+   return run_api_read( my->_api_workers, "get_assets", [&]() {
+      return my->get_assets( asset_symbols_or_ids );
+   } );
 }
 
 vector<optional<asset_object>> database_api_impl::get_assets(const vector<std::string>& asset_symbols_or_ids)const
@@ -1314,7 +1327,9 @@ vector<optional<asset_object>> database_api_impl::get_assets(const vector<std::s
 
 vector<asset_object> database_api::list_assets(const string& lower_bound_symbol, uint32_t limit)const
 {
-   return my->list_assets( lower_bound_symbol, limit );
+   return run_api_read( my->_api_workers, "list_assets", [&]() {
+      return my->list_assets( lower_bound_symbol, limit );
+   } );
 }
 
 vector<asset_object> database_api_impl::list_assets(const string& lower_bound_symbol, uint32_t limit)const
@@ -1403,7 +1418,9 @@ vector<optional<asset_object>> database_api_impl::lookup_asset_symbols(const vec
 
 vector<limit_order_object> database_api::get_limit_orders(std::string a, std::string b, uint32_t limit)const
 {
-   return my->get_limit_orders( a, b, limit );
+   return run_api_read( my->_api_workers, "get_limit_orders", [&]() {
+      return my->get_limit_orders( a, b, limit );
+   } );
 }
 
 /**
@@ -1422,7 +1439,9 @@ vector<limit_order_object> database_api_impl::get_limit_orders(const std::string
 
 vector<call_order_object> database_api::get_call_orders(const std::string& a, uint32_t limit)const
 {
-   return my->get_call_orders( a, limit );
+   return run_api_read( my->_api_workers, "get_call_orders", [&]() {
+      return my->get_call_orders( a, limit );
+   } );
 }
 
 vector<call_order_object> database_api_impl::get_call_orders(const std::string& a, uint32_t limit)const
@@ -1448,7 +1467,9 @@ vector<call_order_object> database_api_impl::get_call_orders(const std::string&
 vector<call_order_object> database_api::get_call_orders_by_account(const std::string& account_name_or_id,
                                                                    asset_id_type start, uint32_t limit)const
 {
-   return my->get_call_orders_by_account( account_name_or_id, start, limit );
+   return run_api_read( my->_api_workers, "get_call_orders_by_account", [&]() {
+      return my->get_call_orders_by_account( account_name_or_id, start, limit );
+   } );
 }
 
 vector<call_order_object> database_api_impl::get_call_orders_by_account(const std::string& account_name_or_id,
@@ -1472,7 +1493,9 @@ vector<call_order_object> database_api_impl::get_call_orders_by_account(const st
 
 vector<force_settlement_object> database_api::get_settle_orders(const std::string& a, uint32_t limit)const
 {
-   return my->get_settle_orders( a, limit );
+   return run_api_read( my->_api_workers, "get_settle_orders", [&]() {
+      return my->get_settle_orders( a, limit );
+   } );
 }
 
 vector<force_settlement_object> database_api_impl::get_settle_orders(const std::string& a, uint32_t limit)const
@@ -1498,7 +1521,9 @@ vector<force_settlement_object> database_api_impl::get_settle_orders(const std::
 vector<force_settlement_object> database_api::get_settle_orders_by_account(const std::string& account_name_or_id,
                                                                            force_settlement_id_type start, uint32_t limit)const
 {
-   return my->get_settle_orders_by_account( account_name_or_id, start, limit);
+   return run_api_read( my->_api_workers, "get_settle_orders_by_account", [&]() {
+      return my->get_settle_orders_by_account( account_name_or_id, start, limit);
+   } );
 }
 
 vector<force_settlement_object> database_api_impl::get_settle_orders_by_account(const std::string& account_name_or_id,
@@ -1523,7 +1548,9 @@ vector<force_settlement_object> database_api_impl::get_settle_orders_by_account(
 
 vector<call_order_object> database_api::get_margin_positions( const std::string account_id_or_name )const
 {
-   return my->get_margin_positions( account_id_or_name );
+   return run_api_read( my->_api_workers, "get_margin_positions", [&]() {
+      return my->get_margin_positions( account_id_or_name );
+   } );
 }
 
 vector<call_order_object> database_api_impl::get_margin_positions( const std::string account_id_or_name )const
@@ -1547,7 +1574,9 @@ vector<call_order_object> database_api_impl::get_margin_positions( const std::st
 
 vector<collateral_bid_object> database_api::get_collateral_bids(const std::string& asset, uint32_t limit, uint32_t start)const
 {
-   return my->get_collateral_bids( asset, limit, start );
+   return run_api_read( my->_api_workers, "get_collateral_bids", [&]() {
+      return my->get_collateral_bids( asset, limit, start );
+   } );
 }
 
 vector<collateral_bid_object> database_api_impl::get_collateral_bids(const std::string& asset, uint32_t limit, uint32_t skip)const
@@ -1585,6 +1614,7 @@ void database_api_impl::subscribe_to_market(std::function<void(const variant&)>
    if(asset_a_id > asset_b_id) std::swap(asset_a_id,asset_b_id);
    FC_ASSERT(asset_a_id != asset_b_id);
    _market_subscriptions[ std::make_pair(asset_a_id,asset_b_id) ] = callback;
+   _subscription_hub->subscribe_to_market( *this, std::make_pair(asset_a_id,asset_b_id) );
 }
 
 void database_api::unsubscribe_from_market(const std::string& a, const std::string& b)
@@ -1600,6 +1630,7 @@ void database_api_impl::unsubscribe_from_market(const std::string& a, const std:
    if(a > b) std::swap(asset_a_id,asset_b_id);
    FC_ASSERT(asset_a_id != asset_b_id);
    _market_subscriptions.erase(std::make_pair(asset_a_id,asset_b_id));
+   _subscription_hub->unsubscribe_from_market( *this, std::make_pair(asset_a_id,asset_b_id) );
 }
 
 string database_api_impl::price_to_string( const price& _price, const asset_object& _base, const asset_object& _quote )
@@ -1667,7 +1698,9 @@ market_volume database_api_impl::get_24_volume( const string& base, const string
 
 order_book database_api::get_order_book( const string& base, const string& quote, unsigned limit )const
 {
-   return my->get_order_book( base, quote, limit);
+   return run_api_read( my->_api_workers, "get_order_book", [&]() {
+      return my->get_order_book( base, quote, limit);
+   } );
 }
 
 order_book database_api_impl::get_order_book( const string& base, const string& quote, unsigned limit )const
@@ -1713,7 +1746,9 @@ order_book database_api_impl::get_order_book( const string& base, const string&
 
 vector<market_ticker> database_api::get_top_markets(uint32_t limit)const
 {
-   return my->get_top_markets(limit);
+   return run_api_read( my->_api_workers, "get_top_markets", [&]() {
+      return my->get_top_markets(limit);
+   } );
 }
 
 vector<market_ticker> database_api_impl::get_top_markets(uint32_t limit)const
@@ -1747,7 +1782,9 @@ vector<market_trade> database_api::get_trade_history( const string& base,
                                                       fc::time_point_sec stop,
                                                       unsigned limit )const
 {
-   return my->get_trade_history( base, quote, start, stop, limit );
+   return run_api_read( my->_api_workers, "get_trade_history", [&]() {
+      return my->get_trade_history( base, quote, start, stop, limit );
+   } );
 }
 
 vector<market_trade> database_api_impl::get_trade_history( const string& base,
@@ -1837,7 +1874,9 @@ vector<market_trade> database_api::get_trade_history_by_sequence(
                                                       fc::time_point_sec stop,
                                                       unsigned limit )const
 {
-   return my->get_trade_history_by_sequence( base, quote, start, stop, limit );
+   return run_api_read( my->_api_workers, "get_trade_history_by_sequence", [&]() {
+      return my->get_trade_history_by_sequence( base, quote, start, stop, limit );
+   } );
 }
 
 vector<market_trade> database_api_impl::get_trade_history_by_sequence(
@@ -1943,7 +1982,9 @@ vector<market_trade> database_api_impl::get_trade_history_by_sequence(
 
 vector<optional<witness_object>> database_api::get_witnesses(const vector<witness_id_type>& witness_ids)const
 {
-   return my->get_witnesses( witness_ids );
+   return run_api_read( my->_api_workers, "get_witnesses", [&]() {
+      return my->get_witnesses( witness_ids );
+   } );
 }
 
 vector<optional<witness_object>> database_api_impl::get_witnesses(const vector<witness_id_type>& witness_ids)const
@@ -2019,7 +2060,9 @@ uint64_t database_api_impl::get_witness_count()const
 
 vector<optional<committee_member_object>> database_api::get_committee_members(const vector<committee_member_id_type>& committee_member_ids)const
 {
-   return my->get_committee_members( committee_member_ids );
+   return run_api_read( my->_api_workers, "get_committee_members", [&]() {
+      return my->get_committee_members( committee_member_ids );
+   } );
 }
 
 vector<optional<committee_member_object>> database_api_impl::get_committee_members(const vector<committee_member_id_type>& committee_member_ids)const
@@ -2480,7 +2523,9 @@ vector< fc::variant > database_api_impl::get_required_fees( const vector<operati
 
 vector<proposal_object> database_api::get_proposed_transactions( const std::string account_id_or_name )const
 {
-   return my->get_proposed_transactions( account_id_or_name );
+   return run_api_read( my->_api_workers, "get_proposed_transactions", [&]() {
+      return my->get_proposed_transactions( account_id_or_name );
+   } );
 }
 
 vector<proposal_object> database_api_impl::get_proposed_transactions( const std::string account_id_or_name )const
@@ -2652,7 +2697,12 @@ vector<htlc_object> database_api_impl::get_htlc_by_to(const std::string account_
 //                                                                  //
 //////////////////////////////////////////////////////////////////////
 
-void database_api_impl::broadcast_updates( const vector<variant>& updates )
+bool database_api_impl::is_subscribed_to_object( object_id_type id )const
+{
+   return is_subscribed_to_item( id );
+}
+
+void database_api_impl::notify_objects( const vector<variant>& updates )const
 {
    if( updates.size() && _subscribe_callback ) {
       auto capture_this = shared_from_this();
@@ -2663,108 +2713,24 @@ void database_api_impl::broadcast_updates( const vector<variant>& updates )
    }
 }
 
-void database_api_impl::broadcast_market_updates( const market_queue_type& queue)
+void database_api_impl::notify_markets( const vector<pair<detail::market_type, variant>>& updates )const
 {
-   if( queue.size() )
+   if( updates.size() )
    {
       auto capture_this = shared_from_this();
-      fc::async([capture_this, this, queue](){
-          for( const auto& item : queue )
+      fc::async([capture_this, this, updates](){
+          for( const auto& item : updates )
           {
             auto sub = _market_subscriptions.find(item.first);
             if( sub != _market_subscriptions.end() )
-                sub->second( fc::variant(item.second ) );
+                sub->second( item.second );
           }
       });
    }
 }
 
-void database_api_impl::on_objects_removed( const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_id_type>& impacted_accounts)
-{
-   handle_object_changed(_notify_remove_create, false, ids, impacted_accounts,
-      [objs](object_id_type id) -> const object* {
-         auto it = std::find_if(
-               objs.begin(), objs.end(),
-               [id](const object* o) {return o != nullptr && o->id == id;});
-
-         if (it != objs.end())
-            return *it;
-
-         return nullptr;
-      }
-   );
-}
-
-void database_api_impl::on_objects_new(const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts)
-{
-   handle_object_changed(_notify_remove_create, true, ids, impacted_accounts,
-      std::bind(&object_database::find_object, &_db, std::placeholders::_1)
-   );
-}
-
-void database_api_impl::on_objects_changed(const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts)
-{
-   handle_object_changed(false, true, ids, impacted_accounts,
-      std::bind(&object_database::find_object, &_db, std::placeholders::_1)
-   );
-}
-
-void database_api_impl::handle_object_changed(bool force_notify, bool full_object, const vector<object_id_type>& ids, const flat_set<account_id_type>& impacted_accounts, std::function<const object*(object_id_type id)> find_object)
-{
-   if( _subscribe_callback )
-   {
-      vector<variant> updates;
-
-      for(auto id : ids)
-      {
-         if( force_notify || is_subscribed_to_item(id) || is_impacted_account(impacted_accounts) )
-         {
-            if( full_object )
-            {
-               auto obj = find_object(id);
-               if( obj )
-               {
-                  updates.emplace_back( obj->to_variant() );
-               }
-            }
-            else
-            {
-               updates.emplace_back( fc::variant( id, 1 ) );
-            }
-         }
-      }
-
-      if( updates.size() )
-         broadcast_updates(updates);
-   }
-
-   if( _market_subscriptions.size() )
-   {
-      market_queue_type broadcast_queue;
-
-      for(auto id : ids)
-      {
-         if( id.is<call_order_object>() )
-         {
-            enqueue_if_subscribed_to_market<call_order_object>( find_object(id), broadcast_queue, full_object );
-         }
-         else if( id.is<limit_order_object>() )
-         {
-            enqueue_if_subscribed_to_market<limit_order_object>( find_object(id), broadcast_queue, full_object );
-         }
-         else if( id.is<force_settlement_object>() )
-         {
-            enqueue_if_subscribed_to_market<force_settlement_object>( find_object(id), broadcast_queue, full_object );
-         }
-      }
-
-      if( broadcast_queue.size() )
-         broadcast_market_updates(broadcast_queue);
-   }
-}
-
 /** note: this method cannot yield because it is called in the middle of
- * apply a block.
+ * apply a block. The fills of subscribed markets are sent by the subscription hub.
  */
 void database_api_impl::on_applied_block()
 {
@@ -2776,48 +2742,6 @@ void database_api_impl::on_applied_block()
          _block_applied_callback(fc::variant(block_id, 1));
       });
    }
-
-   if(_market_subscriptions.size() == 0)
-      return;
-
-   const auto& ops = _db.get_applied_operations();
-   map< std::pair<asset_id_type,asset_id_type>, vector<pair<operation, operation_result>> > subscribed_markets_ops;
-   for(const optional< operation_history_object >& o_op : ops)
-   {
-      if( !o_op.valid() )
-         continue;
-      const operation_history_object& op = *o_op;
-
-      optional< std::pair<asset_id_type,asset_id_type> > market;
-      switch(op.op.which())
-      {
-         /*  This is sent via the object_changed callback
-         case operation::tag<limit_order_create_operation>::value:
-            market = op.op.get<limit_order_create_operation>().get_market();
-            break;
-         */
-         case operation::tag<fill_order_operation>::value:
-            market = op.op.get<fill_order_operation>().get_market();
-            break;
-            /*
-         case operation::tag<limit_order_cancel_operation>::value:
-         */
-         default: break;
-      }
-      if( market.valid() && _market_subscriptions.count(*market) )
-         // FIXME this may cause fill_order_operation be pushed before order creation
-         subscribed_markets_ops[*market].emplace_back(std::make_pair(op.op, op.result));
-   }
-   /// we need to ensure the database_api is not deleted for the life of the async operation
-   auto capture_this = shared_from_this();
-   fc::async([this,capture_this,subscribed_markets_ops](){
-      for(auto item : subscribed_markets_ops)
-      {
-         auto itr = _market_subscriptions.find(item.first);
-         if(itr != _market_subscriptions.end())
-            itr->second(fc::variant(item.second, GRAPHENE_NET_MAX_NESTED_OBJECTS));
-      }
-   });
 }
 
 } } // graphene::app
@@ -246,7 +246,7 @@ namespace graphene { namespace app {
           * @param account_id_or_name An account identifier for which to get the summary for.
           * @param asset_id_or_name An asset identifier for which to get the summary for.
           * @param last Index of the last acceptable operation.
-          * @param count Number of operations to be included in the summary.
+          * @param count Number of operations to be included in the summary, not limited by QueryInspectLimit.
           * @return The requested account asset summary retrieved from the processed operations.
           */
          summary_result get_account_summary(const std::string account_id_or_name,
@@ -260,7 +260,7 @@ namespace graphene { namespace app {
           * @param inclusive_from Starting time of the query time window.
           * @param exclusive_until Ending time of the query time window.
           * @param skip_count Number of operations to skip before including them in the query.
-          * @return The requested account asset summary retrieved from the processed operations.
+          * @return The requested account asset summary of all operations inside the time window.
           */
          summary_result get_account_summary_by_time(const std::string account_id_or_name,
                                                     const std::string asset_id_or_name,
@@ -281,12 +281,6 @@ namespace graphene { namespace app {
                                                          time_point_sec exclusive_until,
                                                          uint64_t skip_count,
                                                          flat_set<int> operation_id_filter) const;
-
-         void update_summary(const database& db,
-                             account_id_type account_id,
-                             asset_id_type asset_id,
-                             const operation& op,
-                             account_archive::account_summary& sum) const;
    };
 
    /**
@@ -540,6 +534,12 @@ namespace graphene { namespace app {
           */
          std::vector<net::potential_peer_record> get_potential_peers() const;
 
+         /**
+          * @brief Return the number of read-only API calls run on the API worker threads, and their
+          *        queue and execution times, by method
+          */
+         fc::variant_object get_api_call_statistics() const;
+
       private:
          application& _app;
    };
@@ -832,6 +832,7 @@ FC_API(graphene::app::network_node_api,
        (add_node)
        (get_connected_peers)
        (get_potential_peers)
+       (get_api_call_statistics)
        (get_advanced_node_parameters)
        (set_advanced_node_parameters)
      )
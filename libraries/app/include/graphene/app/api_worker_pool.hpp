@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/database.hpp>
+
+#include <fc/thread/thread.hpp>
+#include <fc/variant_object.hpp>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace graphene { namespace app {
+
+   /**
+    * @class api_worker_pool
+    * @brief runs read-only API calls on worker threads, so that they do not delay block processing
+    *
+    * Each call holds the read lock of the database while it runs, blocks and transactions are
+    * pushed in between. The fiber making the call yields until the result is ready, so the thread
+    * serving the API connections keeps handling other requests and the p2p traffic meanwhile.
+    *
+    * The time calls wait for a worker and the database lock, and the time they run, are kept per
+    * method and reported by get_call_statistics().
+    */
+   class api_worker_pool
+   {
+      public:
+         api_worker_pool( const graphene::chain::database& db, uint16_t num_threads );
+         ~api_worker_pool();
+
+         /**
+          * Runs @p call on the least busy worker thread, under the read lock of the database.
+          * @p call must only read the database, and must not call the pool again.
+          * @return the result of @p call, whose exceptions are rethrown here
+          */
+         template<typename Call>
+         auto run( const char* method, Call&& call ) -> decltype( call() )
+         {
+            call_timer timer( *this, least_busy_worker(), method );
+            return timer.work.thread->async( [this,&call,&timer]() {
+               auto lock = _db.lock_for_reading();
+               call_timer::execution running( timer );
+               return call();
+            }, method ).wait();
+         }
+
+         uint16_t num_threads()const { return uint16_t( _workers.size() ); }
+
+         /** @return count, queue and execution times of the calls made so far, by method */
+         fc::variant_object get_call_statistics()const;
+
+      private:
+         struct worker
+         {
+            std::unique_ptr<fc::thread> thread;
+            std::atomic<uint32_t>       calls{0};
+         };
+
+         /** measures a call from the time it is queued, and records it when destroyed */
+         struct call_timer
+         {
+            /** marks the call as executing while it exists */
+            struct execution
+            {
+               explicit execution( call_timer& t ) : timer( t ) { timer.started = fc::time_point::now(); }
+               ~execution() { timer.finished = fc::time_point::now(); }
+               call_timer& timer;
+            };
+
+            call_timer( api_worker_pool& p, worker& w, const char* m );
+            ~call_timer();
+
+            api_worker_pool& pool;
+            worker&          work;
+            const char*      method;
+            fc::time_point   queued;
+            fc::time_point   started;
+            fc::time_point   finished;
+         };
+
+         struct method_statistics
+         {
+            uint64_t count              = 0;
+            uint64_t queue_time_sum     = 0;
+            uint64_t queue_time_max     = 0;
+            uint64_t execution_time_sum = 0;
+            uint64_t execution_time_max = 0;
+         };
+
+         worker& least_busy_worker();
+         void    record( const char* method, const fc::microseconds& queue_time,
+                         const fc::microseconds& execution_time );
+
+         const graphene::chain::database&           _db;
+         std::vector< std::unique_ptr<worker> >     _workers;
+         mutable std::mutex                         _statistics_mutex;
+         std::map< std::string, method_statistics > _statistics;
+   };
+
+   /**
+    * Runs @p call on @p workers if there are any, or right away on the calling thread otherwise.
+    */
+   template<typename Call>
+   auto run_api_read( api_worker_pool* workers, const char* method, Call&& call ) -> decltype( call() )
+   {
+      if( workers == nullptr )
+         return call();
+      return workers->run( method, std::forward<Call>( call ) );
+   }
+
+} } // graphene::app
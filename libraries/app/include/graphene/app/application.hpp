@@ -34,6 +34,7 @@ namespace graphene { namespace app {
    using std::string;
 
    class abstract_plugin;
+   class api_worker_pool;
 
    class application_options
    {
@@ -112,6 +113,8 @@ namespace graphene { namespace app {
 
          net::node_ptr                    p2p_node();
          std::shared_ptr<chain::database> chain_database()const;
+         /// @return the threads running read-only API calls, or nullptr if they run on the API thread
+         api_worker_pool*                 get_api_workers()const;
          void set_api_limit();
          void set_block_production(bool producing_blocks);
          fc::optional< api_access_info > get_api_access_info( const string& username )const;
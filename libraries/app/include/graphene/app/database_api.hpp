@@ -67,6 +67,7 @@ using std::vector;
 using std::map;
 
 class database_api_impl;
+class api_worker_pool;
 
 struct order
 {
@@ -136,7 +137,12 @@ struct market_trade
 class database_api
 {
    public:
-      database_api(graphene::chain::database& db, const application_options* app_options = nullptr );
+      /**
+       * @param api_workers if not null, the heavier read-only calls, like get_objects and get_full_accounts,
+       *                    run on these threads instead of the calling one
+       */
+      database_api( graphene::chain::database& db, const application_options* app_options = nullptr,
+                    api_worker_pool* api_workers = nullptr );
       ~database_api();
 
       /////////////
@@ -241,6 +247,17 @@ class database_api
        */
       optional<signed_transaction> get_recent_transaction_by_id( const transaction_id_type& id )const;
 
+      /**
+       * @brief Retrieve the hit/miss counters and the size of the node's decoded block cache
+       */
+      block_cache_stats get_block_cache_stats()const;
+
+      /**
+       * @brief Retrieve the size of the pending transaction pool, and how many pending transactions were kept
+       * or applied again after the blocks, with the time it took
+       */
+      pending_pool_stats get_pending_pool_stats()const;
+
       /////////////
       // Globals //
       /////////////
@@ -854,6 +871,8 @@ FC_API(graphene::app::database_api,
    (get_block)
    (get_transaction)
    (get_recent_transaction_by_id)
+   (get_block_cache_stats)
+   (get_pending_pool_stats)
 
    // Globals
    (get_chain_properties)
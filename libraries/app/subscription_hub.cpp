@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "subscription_hub.hxx"
+
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/market_object.hpp>
+#include <graphene/net/config.hpp>
+
+#include <algorithm>
+#include <numeric>
+
+namespace graphene { namespace app { namespace detail {
+
+namespace {
+   template<typename Index, typename Key>
+   void erase_subscriber( Index& index, const Key& key, const subscription_hub::subscriber* s )
+   {
+      auto itr = index.find( key );
+      if( itr == index.end() )
+         return;
+      itr->second.erase( s );
+      if( itr->second.empty() )
+         index.erase( itr );
+   }
+}
+
+std::shared_ptr<subscription_hub> subscription_hub::get( database& db )
+{
+   static std::mutex registry_mutex;
+   static std::map< const database*, std::weak_ptr<subscription_hub> > registry;
+
+   std::lock_guard<std::mutex> guard( registry_mutex );
+   for( auto itr = registry.begin(); itr != registry.end(); )
+      itr = itr->second.expired() ? registry.erase( itr ) : std::next( itr );
+
+   auto& entry = registry[&db];
+   auto hub = entry.lock();
+   if( !hub )
+   {
+      hub = std::make_shared<subscription_hub>( db );
+      entry = hub;
+   }
+   return hub;
+}
+
+subscription_hub::subscription_hub( database& db )
+: _db( db )
+{
+   _new_connection = _db.new_objects.connect( [this]( const vector<object_id_type>& ids,
+                                                      const flat_set<account_id_type>& impacted_accounts ) {
+      on_objects( true, true, ids, impacted_accounts, [this]( object_id_type id ) { return _db.find_object( id ); } );
+   });
+   _change_connection = _db.changed_objects.connect( [this]( const vector<object_id_type>& ids,
+                                                             const flat_set<account_id_type>& impacted_accounts ) {
+      on_objects( false, true, ids, impacted_accounts, [this]( object_id_type id ) { return _db.find_object( id ); } );
+   });
+   _removed_connection = _db.removed_objects.connect( [this]( const vector<object_id_type>& ids,
+                                                              const vector<const object*>& objs,
+                                                              const flat_set<account_id_type>& impacted_accounts ) {
+      on_objects( true, false, ids, impacted_accounts, [&objs]( object_id_type id ) -> const object* {
+         auto itr = std::find_if( objs.begin(), objs.end(),
+                                  [id]( const object* o ) { return o != nullptr && o->id == id; } );
+         return itr != objs.end() ? *itr : nullptr;
+      });
+   });
+   _applied_block_connection = _db.applied_block.connect( [this]( const signed_block& ) { on_applied_block(); } );
+}
+
+void subscription_hub::subscribe_to_object( const subscriber& s, object_id_type id )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   auto& subs = _subscribers[&s];
+   if( subs.scan_objects )
+      return;
+   if( subs.objects.size() >= max_indexed_objects )
+   {
+      // past the limit the subscriber is asked about every changed object
+      subs.scan_objects = true;
+      _scanned.insert( &s );
+      return;
+   }
+   if( _objects[id].insert( &s ).second )
+      subs.objects.push_back( id );
+}
+
+void subscription_hub::subscribe_to_account( const subscriber& s, account_id_type id )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   _subscribers[&s].accounts.insert( id );
+   _accounts[id].insert( &s );
+}
+
+void subscription_hub::subscribe_to_market( const subscriber& s, const market_type& market )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   _subscribers[&s].markets.insert( market );
+   _markets[market].insert( &s );
+}
+
+void subscription_hub::unsubscribe_from_market( const subscriber& s, const market_type& market )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   auto itr = _subscribers.find( &s );
+   if( itr == _subscribers.end() )
+      return;
+   itr->second.markets.erase( market );
+   erase_subscriber( _markets, market, &s );
+}
+
+void subscription_hub::set_notify_remove_create( const subscriber& s, bool notify )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   _subscribers[&s].notify_remove_create = notify;
+   if( notify )
+      _notify_remove_create.insert( &s );
+   else
+      _notify_remove_create.erase( &s );
+}
+
+void subscription_hub::cancel_subscriptions( const subscriber& s, bool markets )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   auto itr = _subscribers.find( &s );
+   if( itr == _subscribers.end() )
+      return;
+   auto& subs = itr->second;
+
+   for( const auto& id : subs.objects )
+      erase_subscriber( _objects, id, &s );
+   subs.objects.clear();
+   subs.scan_objects = false;
+   _scanned.erase( &s );
+
+   for( const auto& account : subs.accounts )
+      erase_subscriber( _accounts, account, &s );
+   subs.accounts.clear();
+
+   subs.notify_remove_create = false;
+   _notify_remove_create.erase( &s );
+
+   if( markets )
+   {
+      for( const auto& market : subs.markets )
+         erase_subscriber( _markets, market, &s );
+      subs.markets.clear();
+   }
+
+   if( subs.markets.empty() )
+      _subscribers.erase( itr );
+}
+
+void subscription_hub::on_objects( bool created_or_removed, bool full_object, const vector<object_id_type>& ids,
+                                   const flat_set<account_id_type>& impacted_accounts,
+                                   const std::function<const object*(object_id_type)>& find_object )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   if( _subscribers.empty() || ids.empty() )
+      return;
+
+   // each object is converted once, however many subscribers are notified of it
+   vector<fc::variant> variants( ids.size() );
+   vector<bool> converted( ids.size(), false );
+   const auto get_variant = [&]( uint32_t i ) -> const fc::variant& {
+      if( !converted[i] )
+      {
+         converted[i] = true;
+         if( !full_object )
+            variants[i] = fc::variant( ids[i], 1 );
+         else if( const object* obj = find_object( ids[i] ) )
+            variants[i] = obj->to_variant();
+      }
+      return variants[i];
+   };
+
+   // subscribers of all the objects, and the positions in ids of the objects the others are subscribed to
+   subscriber_set everything;
+   if( created_or_removed )
+      everything = _notify_remove_create;
+   for( const auto& account : impacted_accounts )
+   {
+      auto itr = _accounts.find( account );
+      if( itr != _accounts.end() )
+         everything.insert( itr->second.begin(), itr->second.end() );
+   }
+
+   std::unordered_map< const subscriber*, vector<uint32_t> > matches;
+   const auto add_match = [&matches,&everything]( const subscriber* s, uint32_t i ) {
+      if( everything.count( s ) )
+         return;
+      auto& positions = matches[s];
+      if( positions.empty() || positions.back() != i )
+         positions.push_back( i );
+   };
+   for( uint32_t i = 0; i < ids.size(); ++i )
+   {
+      auto itr = _objects.find( ids[i] );
+      if( itr != _objects.end() )
+         for( const subscriber* s : itr->second )
+            add_match( s, i );
+      for( const subscriber* s : _scanned )
+         if( s->is_subscribed_to_object( ids[i] ) )
+            add_match( s, i );
+   }
+
+   vector<fc::variant> updates;
+   const auto notify = [&]( const subscriber* s, const vector<uint32_t>& positions ) {
+      updates.clear();
+      for( uint32_t i : positions )
+      {
+         const fc::variant& v = get_variant( i );
+         if( !v.is_null() )
+            updates.push_back( v );
+      }
+      if( !updates.empty() )
+         s->notify_objects( updates );
+   };
+   if( !everything.empty() )
+   {
+      vector<uint32_t> all( ids.size() );
+      std::iota( all.begin(), all.end(), 0u );
+      for( const subscriber* s : everything )
+         notify( s, all );
+   }
+   for( const auto& item : matches )
+      notify( item.first, item.second );
+
+   if( _markets.empty() )
+      return;
+
+   std::map< market_type, vector<fc::variant> > market_objects;
+   for( uint32_t i = 0; i < ids.size(); ++i )
+   {
+      const auto& id = ids[i];
+      if( !id.is<call_order_object>() && !id.is<limit_order_object>() && !id.is<force_settlement_object>() )
+         continue;
+      const auto market = get_order_market( find_object( id ) );
+      if( !market.valid() || !_markets.count( *market ) )
+         continue;
+      const fc::variant& v = get_variant( i );
+      if( !v.is_null() )
+         market_objects[*market].push_back( v );
+   }
+
+   std::map< market_type, fc::variant > market_updates;
+   for( const auto& item : market_objects )
+      market_updates.emplace( item.first, fc::variant( item.second ) );
+   dispatch_market_updates( market_updates );
+}
+
+void subscription_hub::on_applied_block()
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   if( _markets.empty() )
+      return;
+
+   std::map< market_type, vector<pair<operation, operation_result>> > market_ops;
+   for( const optional< operation_history_object >& o_op : _db.get_applied_operations() )
+   {
+      if( !o_op.valid() || o_op->op.which() != operation::tag<fill_order_operation>::value )
+         continue;
+      const market_type market = o_op->op.get<fill_order_operation>().get_market();
+      if( _markets.count( market ) )
+         // FIXME this may cause fill_order_operation be pushed before order creation
+         market_ops[market].emplace_back( o_op->op, o_op->result );
+   }
+
+   std::map< market_type, fc::variant > market_updates;
+   for( const auto& item : market_ops )
+      market_updates.emplace( item.first, fc::variant( item.second, GRAPHENE_NET_MAX_NESTED_OBJECTS ) );
+   dispatch_market_updates( market_updates );
+}
+
+optional<market_type> subscription_hub::get_order_market( const object* obj )const
+{
+   if( const auto* order = dynamic_cast<const limit_order_object*>( obj ) )
+      return order->get_market();
+   if( const auto* order = dynamic_cast<const call_order_object*>( obj ) )
+      return order->get_market();
+   if( const auto* order = dynamic_cast<const force_settlement_object*>( obj ) )
+   {
+      const asset_id_type backing_id = order->balance.asset_id( _db ).bitasset_data( _db ).options.short_backing_asset;
+      auto market = std::make_pair( order->balance.asset_id, backing_id );
+      if( market.first > market.second )
+         std::swap( market.first, market.second );
+      return market;
+   }
+   return optional<market_type>();
+}
+
+void subscription_hub::dispatch_market_updates( const std::map<market_type, fc::variant>& updates )const
+{
+   std::unordered_map< const subscriber*, vector<pair<market_type, fc::variant>> > slices;
+   for( const auto& item : updates )
+   {
+      auto itr = _markets.find( item.first );
+      if( itr == _markets.end() )
+         continue;
+      for( const subscriber* s : itr->second )
+         slices[s].emplace_back( item.first, item.second );
+   }
+   for( const auto& slice : slices )
+      slice.first->notify_markets( slice.second );
+}
+
+} } } // graphene::app::detail
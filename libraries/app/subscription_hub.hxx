@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/database.hpp>
+
+#include <fc/variant.hpp>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace graphene { namespace app { namespace detail {
+
+using namespace graphene::chain;
+
+typedef std::pair<asset_id_type, asset_id_type> market_type;
+
+/**
+ * @brief Matches the objects changed in the database against the subscriptions of all API sessions
+ *
+ * One hub is shared by the sessions of a database. The subscribers of changed objects, accounts and
+ * markets are looked up in indices, every matched object is converted to a variant once, and each
+ * subscriber is handed only the updates it subscribed to. The work per change grows with the number
+ * of matching subscriptions rather than with the number of sessions.
+ *
+ * Subscribers are notified on the thread modifying the database and must unsubscribe before they
+ * are destroyed.
+ */
+class subscription_hub
+{
+   public:
+      class subscriber
+      {
+         public:
+            virtual ~subscriber() = default;
+            /** Asked for every changed object when the subscriber has more objects than the hub indexes. */
+            virtual bool is_subscribed_to_object( object_id_type id )const = 0;
+            /** Called with the changed objects the subscriber is subscribed to, in the order they were reported. */
+            virtual void notify_objects( const vector<fc::variant>& updates )const = 0;
+            /** Called with the updates of the markets the subscriber is subscribed to. */
+            virtual void notify_markets( const vector<pair<market_type, fc::variant>>& updates )const = 0;
+      };
+
+      /** The number of objects indexed per subscriber, like the capacity its bloom filter is sized for */
+      static const size_t max_indexed_objects = 10000;
+
+      /** @return the hub of @p db, created if no session holds one */
+      static std::shared_ptr<subscription_hub> get( database& db );
+
+      explicit subscription_hub( database& db );
+
+      void subscribe_to_object( const subscriber& s, object_id_type id );
+      void subscribe_to_account( const subscriber& s, account_id_type id );
+      void subscribe_to_market( const subscriber& s, const market_type& market );
+      void unsubscribe_from_market( const subscriber& s, const market_type& market );
+      /** Enables notifying @p s of the creation and removal of all objects */
+      void set_notify_remove_create( const subscriber& s, bool notify );
+      /**
+       * Drops the object and account subscriptions of @p s, and its market subscriptions if @p markets is set.
+       * A subscriber cancels all its subscriptions before it is destroyed.
+       */
+      void cancel_subscriptions( const subscriber& s, bool markets );
+
+   private:
+      struct subscriptions
+      {
+         bool                       notify_remove_create = false;
+         /** set when the subscriber subscribed to more objects than are indexed */
+         bool                       scan_objects = false;
+         vector<object_id_type>     objects;
+         flat_set<account_id_type>  accounts;
+         flat_set<market_type>      markets;
+      };
+      typedef flat_set<const subscriber*> subscriber_set;
+
+      void on_objects( bool created_or_removed, bool full_object, const vector<object_id_type>& ids,
+                       const flat_set<account_id_type>& impacted_accounts,
+                       const std::function<const object*(object_id_type)>& find_object );
+      void on_applied_block();
+
+      optional<market_type> get_order_market( const object* obj )const;
+      /** Hands each subscriber of the updated markets its updates, the hub must be locked */
+      void                  dispatch_market_updates( const std::map<market_type, fc::variant>& updates )const;
+
+      database&                                                   _db;
+      std::mutex                                                  _mutex;
+      std::unordered_map< const subscriber*, subscriptions >      _subscribers;
+      std::unordered_map< object_id_type, subscriber_set >        _objects;
+      std::map< account_id_type, subscriber_set >                 _accounts;
+      std::map< market_type, subscriber_set >                     _markets;
+      subscriber_set                                              _notify_remove_create;
+      subscriber_set                                              _scanned;
+
+      boost::signals2::scoped_connection                          _new_connection;
+      boost::signals2::scoped_connection                          _change_connection;
+      boost::signals2::scoped_connection                          _removed_connection;
+      boost::signals2::scoped_connection                          _applied_block_connection;
+};
+
+} } } // graphene::app::detail
@@ -326,6 +326,9 @@ void_result account_update_evaluator::do_apply( const account_update_operation&
        } );
    }
 
+   if( o.owner || o.active )
+      d.note_authority_change( acnt->id );
+
    // update account object
    d.modify( *acnt, [&o,&d,&eternalAccountIds](account_object& a){
       if( o.owner )
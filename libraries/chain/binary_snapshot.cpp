@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2017 Peter Conrad, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/binary_snapshot.hpp>
+
+#include <fc/crypto/city.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/interprocess/file_mapping.hpp>
+#include <fc/io/raw.hpp>
+
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <thread>
+
+namespace graphene { namespace chain {
+
+namespace {
+   size_t max_tasks()
+   {
+      return std::max( 1u, std::thread::hardware_concurrency() );
+   }
+
+   template<typename Filter>
+   void filter( Filter&& f, const char* data, size_t size, std::vector<char>& result )
+   {
+      boost::iostreams::filtering_ostream out;
+      out.push( std::forward<Filter>(f) );
+      out.push( boost::iostreams::back_inserter( result ) );
+      out.write( data, size );
+      out.reset(); // flushes the filter
+   }
+
+   struct compressed_index
+   {
+      binary_snapshot_index_header     header;
+      std::vector< std::vector<char> > chunks;
+      fc::sha256                       checksum;
+   };
+
+   struct index_section
+   {
+      binary_snapshot_index_header                header;
+      std::vector< std::pair<const char*,size_t> > chunks;
+      fc::sha256                                  checksum;
+   };
+
+   /**
+    *  @return the sum of the hashes of the objects packed by index::pack() into @p data, which is
+    *  what index::hash() returns once they are loaded
+    */
+   fc::uint128 hash_packed_index( const std::vector<char>& data, object_id_type& next_id )
+   {
+      fc::datastream<const char*> ds( data.data(), data.size() );
+      fc::sha256 version;
+      fc::raw::unpack( ds, next_id );
+      fc::raw::unpack( ds, version );
+      fc::uint128 result;
+      while( ds.remaining() > 0 )
+      {
+         fc::unsigned_int size;
+         fc::raw::unpack( ds, size );
+         FC_ASSERT( size.value <= ds.remaining(), "Truncated object" );
+         result += fc::city_hash_crc_128( data.data() + ds.tellp(), size.value );
+         ds.skip( size.value );
+      }
+      return result;
+   }
+
+   void hash_index( fc::sha256::encoder& enc, uint8_t space_id, uint8_t type_id, object_id_type next_id,
+                    const fc::uint128& hash )
+   {
+      fc::raw::pack( enc, space_id );
+      fc::raw::pack( enc, type_id );
+      fc::raw::pack( enc, next_id );
+      fc::raw::pack( enc, hash.hi );
+      fc::raw::pack( enc, hash.lo );
+   }
+
+   binary_snapshot_header unpack_header( fc::datastream<const char*>& ds )
+   {
+      uint64_t magic;
+      fc::raw::unpack( ds, magic );
+      FC_ASSERT( magic == binary_snapshot_magic, "Not a binary snapshot" );
+      binary_snapshot_header header;
+      fc::raw::unpack( ds, header );
+      FC_ASSERT( header.version == binary_snapshot_version, "Unsupported snapshot version ${v}", ("v", header.version) );
+      return header;
+   }
+
+   std::vector<char> decompress_index( const index_section& section )
+   {
+      std::vector<char> result;
+      result.reserve( section.header.size );
+      for( const auto& chunk : section.chunks )
+         filter( boost::iostreams::zlib_decompressor(), chunk.first, chunk.second, result );
+      FC_ASSERT( result.size() == section.header.size && fc::sha256::hash( result.data(), result.size() ) == section.checksum,
+                 "Corrupted index ${s}.${t} in snapshot", ("s",section.header.space_id)("t",section.header.type_id) );
+      return result;
+   }
+}
+
+binary_snapshot_writer::binary_snapshot_writer( const database& db )
+{ try {
+   // each undo state holds one block, the state the undo history can return to is the one packed
+   const uint32_t undo_blocks = std::min<uint32_t>( db._undo_db.size(), db.head_block_num() );
+   _header.chain_id  = db.get_chain_id();
+   _header.block_num = db.head_block_num() - undo_blocks;
+   if( undo_blocks == 0 )
+      _header.block_id = db.head_block_id();
+   else if( _header.block_num > 0 )
+      _header.block_id = db.get_block_id_for_num( _header.block_num );
+   if( _header.block_num > 0 )
+   {
+      _header.block = db.fetch_block_by_number( _header.block_num );
+      FC_ASSERT( _header.block.valid() && _header.block->id() == _header.block_id,
+                 "Block ${n} of the snapshot is not available", ("n", _header.block_num) );
+   }
+
+   // the indexes of plugins are left out, a node starting from the snapshot may run other plugins
+   std::vector<const graphene::db::index*> indexes;
+   db.inspect_all_indexes( [&db,&indexes]( const graphene::db::index& idx ) {
+      if( db.is_chain_index( idx.object_space_id(), idx.object_type_id() ) )
+         indexes.push_back( &idx );
+   } );
+   _header.index_count = indexes.size();
+   _indexes.resize( indexes.size() );
+
+   const auto state = db.get_oldest_state();
+   std::vector<fc::uint128> hashes( indexes.size() );
+   std::vector<object_id_type> next_ids( indexes.size() );
+   std::atomic<size_t> next_index( 0 );
+   const auto pack_indexes = [this,&state,&indexes,&hashes,&next_ids,&next_index]() {
+      for( size_t i = next_index++; i < indexes.size(); i = next_index++ )
+      {
+         _indexes[i] = { indexes[i]->object_space_id(), indexes[i]->object_type_id(), state.pack( *indexes[i] ) };
+         hashes[i] = hash_packed_index( _indexes[i].data, next_ids[i] );
+      }
+   };
+   std::vector< std::future<void> > tasks;
+   for( size_t i = 0; i < std::min( max_tasks(), indexes.size() ); ++i )
+      tasks.push_back( std::async( std::launch::async, pack_indexes ) );
+   for( auto& task : tasks )
+      task.get();
+
+   fc::sha256::encoder enc;
+   for( size_t i = 0; i < _indexes.size(); ++i )
+      hash_index( enc, _indexes[i].space_id, _indexes[i].type_id, next_ids[i], hashes[i] );
+   _header.state_hash = enc.result();
+} FC_CAPTURE_AND_RETHROW() }
+
+void binary_snapshot_writer::write( const fc::path& dest )const
+{ try {
+   const auto compress_index = []( const packed_index& packed ) {
+      compressed_index result;
+      result.header.space_id = packed.space_id;
+      result.header.type_id = packed.type_id;
+      result.header.size = packed.data.size();
+      for( size_t pos = 0; pos < packed.data.size(); pos += binary_snapshot_chunk_size )
+      {
+         result.chunks.emplace_back();
+         filter( boost::iostreams::zlib_compressor(), packed.data.data() + pos,
+                 std::min( binary_snapshot_chunk_size, packed.data.size() - pos ), result.chunks.back() );
+      }
+      result.header.chunk_count = result.chunks.size();
+      result.checksum = fc::sha256::hash( packed.data.data(), packed.data.size() );
+      return result;
+   };
+
+   const fc::path tmp = dest.generic_string() + ".tmp";
+   std::ofstream out( tmp.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+   FC_ASSERT( out, "Unable to create ${f}", ("f", tmp) );
+   fc::raw::pack( out, binary_snapshot_magic );
+   fc::raw::pack( out, _header );
+
+   // the sections are written in order as soon as they are compressed, while the following ones still are
+   std::deque< std::future<compressed_index> > tasks;
+   const auto write_next = [&out,&tasks]() {
+      const compressed_index section = tasks.front().get();
+      tasks.pop_front();
+      fc::raw::pack( out, section.header );
+      for( const auto& chunk : section.chunks )
+         fc::raw::pack( out, chunk );
+      fc::raw::pack( out, section.checksum );
+   };
+   for( const auto& packed : _indexes )
+   {
+      if( tasks.size() >= max_tasks() )
+         write_next();
+      tasks.push_back( std::async( std::launch::async, compress_index, std::cref( packed ) ) );
+   }
+   while( !tasks.empty() )
+      write_next();
+
+   out.close();
+   FC_ASSERT( out, "Unable to write ${f}", ("f", tmp) );
+   fc::rename( tmp, dest );
+} FC_CAPTURE_AND_RETHROW( (dest) ) }
+
+binary_snapshot_header read_binary_snapshot_header( const fc::path& source )
+{ try {
+   fc::file_mapping fm( source.generic_string().c_str(), fc::read_only );
+   fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size( source ) );
+   fc::datastream<const char*> ds( (const char*)mr.get_address(), mr.get_size() );
+   return unpack_header( ds );
+} FC_CAPTURE_AND_RETHROW( (source) ) }
+
+binary_snapshot_header load_binary_snapshot( database& db, const fc::path& source )
+{ try {
+   fc::file_mapping fm( source.generic_string().c_str(), fc::read_only );
+   fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size( source ) );
+   const char* const data = (const char*)mr.get_address();
+   fc::datastream<const char*> ds( data, mr.get_size() );
+   const binary_snapshot_header header = unpack_header( ds );
+
+   // locate the compressed chunks first, they are decompressed straight from the mapped file
+   std::vector<index_section> sections( header.index_count );
+   for( auto& section : sections )
+   {
+      fc::raw::unpack( ds, section.header );
+      FC_ASSERT( db.is_chain_index( section.header.space_id, section.header.type_id ),
+                 "Index ${s}.${t} in snapshot is not an index of the chain",
+                 ("s",section.header.space_id)("t",section.header.type_id) );
+      for( uint32_t i = 0; i < section.header.chunk_count; ++i )
+      {
+         fc::unsigned_int size;
+         fc::raw::unpack( ds, size );
+         FC_ASSERT( size.value <= ds.remaining(), "Truncated snapshot" );
+         section.chunks.emplace_back( data + ds.tellp(), size.value );
+         ds.skip( size.value );
+      }
+      fc::raw::unpack( ds, section.checksum );
+   }
+
+   // indexes are loaded one after the other in snapshot order, while the following ones are decompressed
+   std::deque< std::future< std::vector<char> > > tasks;
+   size_t loaded = 0;
+   const auto load_next = [&db,&sections,&tasks,&loaded]() {
+      const std::vector<char> index_data = tasks.front().get();
+      tasks.pop_front();
+      const auto& section = sections[loaded++];
+      db.unpack_index( section.header.space_id, section.header.type_id, index_data.data(), index_data.size() );
+   };
+   for( const auto& section : sections )
+   {
+      if( tasks.size() >= max_tasks() )
+         load_next();
+      tasks.push_back( std::async( std::launch::async, decompress_index, std::cref( section ) ) );
+   }
+   while( !tasks.empty() )
+      load_next();
+
+   fc::sha256::encoder enc;
+   for( const auto& section : sections )
+   {
+      const auto& idx = db.get_index( section.header.space_id, section.header.type_id );
+      hash_index( enc, section.header.space_id, section.header.type_id, idx.get_next_id(), idx.hash() );
+   }
+   FC_ASSERT( enc.result() == header.state_hash, "The loaded state does not match the state hash of the snapshot" );
+
+   return header;
+} FC_CAPTURE_AND_RETHROW( (source) ) }
+
+} } //graphene::chain
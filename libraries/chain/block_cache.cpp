@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2019 01 People, s.r.o. (01 CryptoHouse).
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/block_cache.hpp>
+
+namespace graphene { namespace chain {
+
+void block_cache::set_capacity( uint64_t capacity )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _capacity = capacity;
+   while( _size > _capacity )
+      erase( std::prev( _entries.end() ) );
+}
+
+std::shared_ptr<const signed_block> block_cache::get( uint32_t block_num, const block_id_type& id )const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto itr = _by_num.find( block_num );
+   if( itr == _by_num.end() || itr->second->id != id )
+   {
+      ++_misses;
+      return std::shared_ptr<const signed_block>();
+   }
+   ++_hits;
+   _entries.splice( _entries.begin(), _entries, itr->second );
+   return itr->second->block;
+}
+
+void block_cache::put( uint32_t block_num, const std::shared_ptr<const signed_block>& block, const block_id_type& id,
+                       uint64_t packed_size )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( packed_size > _capacity )
+      return;
+
+   auto itr = _by_num.find( block_num );
+   if( itr != _by_num.end() )
+      erase( itr->second );
+
+   _entries.push_front( entry{ block_num, id, block, packed_size } );
+   _by_num[block_num] = _entries.begin();
+   _size += packed_size;
+   while( _size > _capacity )
+      erase( std::prev( _entries.end() ) );
+}
+
+void block_cache::invalidate( uint32_t block_num )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto itr = _by_num.find( block_num );
+   if( itr != _by_num.end() )
+      erase( itr->second );
+}
+
+void block_cache::clear()
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _entries.clear();
+   _by_num.clear();
+   _size = 0;
+}
+
+block_cache_stats block_cache::get_stats()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   block_cache_stats stats;
+   stats.hits = _hits;
+   stats.misses = _misses;
+   stats.entries = _entries.size();
+   stats.size = _size;
+   stats.capacity = _capacity;
+   return stats;
+}
+
+void block_cache::erase( entry_list::iterator itr )
+{
+   _size -= itr->size;
+   _by_num.erase( itr->block_num );
+   _entries.erase( itr );
+}
+
+} }
@@ -25,6 +25,7 @@
 #include <graphene/protocol/fee_schedule.hpp>
 #include <graphene/protocol/operations_permissions.hpp>
 #include <fc/io/raw.hpp>
+#include <fc/io/datastream.hpp>
 #include <boost/endian/buffers.hpp>
 
 namespace graphene { namespace chain {
@@ -39,6 +40,115 @@ struct index_entry
    boost::endian::little_uint32_buf_t block_size;
    block_id_type                      block_id;
 };
+
+/**
+ * Fixed-size entry of the "headers" sidecar file, stored at the same position as the block's
+ * index_entry. Lets header and timestamp queries avoid unpacking the whole block.
+ */
+struct header_entry
+{
+   static const uint32_t max_header_size = 124;
+
+   header_entry() {
+      timestamp = 0;
+      header_size = 0;
+      offsets_pos = 0;
+      offsets_size = 0;
+   }
+   /** id of the block the entry was written for, it is only valid if this matches the index_entry */
+   block_id_type                      block_id;
+   boost::endian::little_uint32_buf_t timestamp;
+   /** size of the packed signed_block_header, or 0 if it did not fit into the entry */
+   boost::endian::little_uint32_buf_t header_size;
+   /** location of the block's operation offset table in the "op_offsets" file, size 0 if none */
+   boost::endian::little_uint64_buf_t offsets_pos;
+   boost::endian::little_uint32_buf_t offsets_size;
+   char                               header[max_header_size];
+};
+
+/**
+ * The operation offset table of a block is a sequence of little endian uint32 values:
+ *
+ *    num_trx, first_op[0] ... first_op[num_trx], { op_pos, op_size, result_pos, result_size } per operation
+ *
+ * where first_op[i] is the number of operations in the transactions before transaction i and the
+ * positions are relative to the start of the packed block.
+ */
+typedef boost::endian::little_uint32_buf_t offset_value;
+static const uint32_t values_per_operation = 4;
+
+static std::vector<offset_value> make_operation_offsets( const signed_block& b )
+{
+   size_t num_ops = 0;
+   for( const auto& trx : b.transactions )
+      num_ops += trx.operations.size();
+
+   std::vector<offset_value> table;
+   table.reserve( 2 + b.transactions.size() + values_per_operation * num_ops );
+   table.emplace_back( static_cast<uint32_t>( b.transactions.size() ) );
+   uint32_t first_op = 0;
+   for( const auto& trx : b.transactions )
+   {
+      table.emplace_back( first_op );
+      first_op += trx.operations.size();
+   }
+   table.emplace_back( first_op );
+
+   // walks the block the same way fc::raw::pack lays it out, see the FC_REFLECT of the types involved
+   const signed_block_header& header = b;
+   uint64_t pos = fc::raw::pack_size( header ) + fc::raw::pack_size( fc::unsigned_int( b.transactions.size() ) );
+   std::vector<uint64_t> op_pos, op_size, result_pos, result_size;
+   for( const auto& trx : b.transactions )
+   {
+      const uint64_t trx_end = pos + fc::raw::pack_size( trx );
+      pos += fc::raw::pack_size( trx.ref_block_num ) + fc::raw::pack_size( trx.ref_block_prefix )
+           + fc::raw::pack_size( trx.expiration ) + fc::raw::pack_size( fc::unsigned_int( trx.operations.size() ) );
+      op_pos.clear();
+      op_size.clear();
+      for( const auto& op : trx.operations )
+      {
+         op_pos.push_back( pos );
+         op_size.push_back( fc::raw::pack_size( op ) );
+         pos += op_size.back();
+      }
+      pos += fc::raw::pack_size( trx.extensions ) + fc::raw::pack_size( trx.signatures )
+           + fc::raw::pack_size( fc::unsigned_int( trx.operation_results.size() ) );
+      result_pos.clear();
+      result_size.clear();
+      for( const auto& result : trx.operation_results )
+      {
+         result_pos.push_back( pos );
+         result_size.push_back( fc::raw::pack_size( result ) );
+         pos += result_size.back();
+      }
+      FC_ASSERT( pos == trx_end, "Unexpected transaction layout" );
+
+      for( size_t i = 0; i < trx.operations.size(); ++i )
+      {
+         table.emplace_back( static_cast<uint32_t>( op_pos[i] ) );
+         table.emplace_back( static_cast<uint32_t>( op_size[i] ) );
+         table.emplace_back( static_cast<uint32_t>( i < result_pos.size() ? result_pos[i] : 0 ) );
+         table.emplace_back( static_cast<uint32_t>( i < result_size.size() ? result_size[i] : 0 ) );
+      }
+   }
+   return table;
+}
+
+static header_entry make_header_entry( const signed_block& b )
+{
+   header_entry h;
+   h.block_id = b.id();
+   h.timestamp = b.timestamp.sec_since_epoch();
+   const signed_block_header& header = b;
+   const auto size = fc::raw::pack_size( header );
+   if( size <= header_entry::max_header_size )
+   {
+      fc::datastream<char*> ds( h.header, header_entry::max_header_size );
+      fc::raw::pack( ds, header );
+      h.header_size = size;
+   }
+   return h;
+}
  }}
 FC_REFLECT( graphene::chain::index_entry, (block_pos)(block_size)(block_id) );
 
@@ -47,20 +157,48 @@ namespace graphene { namespace chain {
 void block_database::open( const fc::path& dbdir )
 { try {
    fc::create_directories(dbdir);
-   _block_num_to_pos.exceptions(std::ios_base::failbit | std::ios_base::badbit);
-   _blocks.exceptions(std::ios_base::failbit | std::ios_base::badbit);
 
-   _index_filename = dbdir / "index";
-   if( !fc::exists( _index_filename ) )
-   {
-     _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-   }
-   else
+   const auto index_filename = dbdir / "index";
+   const bool truncate = !fc::exists( index_filename );
+   _block_num_to_pos.open( index_filename, truncate );
+   _blocks.open( dbdir / "blocks", truncate );
+   _headers.open( dbdir / "headers", truncate );
+   _op_offsets.open( dbdir / "op_offsets", truncate );
+
+   // there are no readers yet, so the index entries written without their block before a crash can be dropped
+   truncate_invalid_tail();
+
+   // block databases created before the headers sidecar existed have to be caught up once
+   const uint64_t num_entries = _block_num_to_pos.size() / sizeof(index_entry);
+   uint64_t num_headers = _headers.size() / sizeof(header_entry);
+   if( num_headers < num_entries )
    {
-     _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+      ilog( "Building block headers for ${n} blocks", ("n", num_entries - num_headers) );
+      for( ; num_headers < num_entries; ++num_headers )
+      {
+         header_entry h;
+         index_entry e;
+         if( _block_num_to_pos.read( num_headers * sizeof(index_entry), e ) && e.block_size.value() > 0 )
+         {
+            try
+            {
+               auto block = read_block( e );
+               if( block )
+               {
+                  h = make_header_entry( *block );
+                  store_operation_offsets( *block, h );
+               }
+            }
+            catch (const fc::exception&)
+            {
+            }
+         }
+         _headers.write( num_headers * sizeof(header_entry), h );
+      }
+      _op_offsets.flush();
+      _headers.flush();
    }
+   _current_position = _blocks.size();
 } FC_CAPTURE_AND_RETHROW( (dbdir) ) }
 
 bool block_database::is_open()const
@@ -72,12 +210,17 @@ void block_database::close()
 {
   _blocks.close();
   _block_num_to_pos.close();
+  _headers.close();
+  _op_offsets.close();
+  _cache.clear();
 }
 
 void block_database::flush()
 {
   _blocks.flush();
   _block_num_to_pos.flush();
+  _op_offsets.flush();
+  _headers.flush();
 }
 
 void block_database::store( const block_id_type& _id, const signed_block& b )
@@ -88,33 +231,48 @@ void block_database::store( const block_id_type& _id, const signed_block& b )
       id = b.id();
       elog( "id argument of block_database::store() was not initialized for block ${id}", ("id", id) );
    }
-   _block_num_to_pos.seekp( sizeof( index_entry ) * int64_t(block_header::num_from_id(id)) );
    index_entry e;
-   _blocks.seekp( 0, _blocks.end );
    auto vec = fc::raw::pack( b );
-   e.block_pos  = _blocks.tellp();
+   e.block_pos  = _blocks.append( vec.data(), vec.size() );
    e.block_size = vec.size();
    e.block_id   = id;
-   _blocks.write( vec.data(), vec.size() );
-   _block_num_to_pos.write( (char*)&e, sizeof(e) );
+   // the block and its header have to be readable before the index entry pointing to them
+   _blocks.flush();
+   _cache.invalidate( block_header::num_from_id(id) );
+   header_entry h = make_header_entry( b );
+   store_operation_offsets( b, h );
+   _op_offsets.flush();
+   _headers.write( sizeof( header_entry ) * uint64_t(block_header::num_from_id(id)), h );
+   _headers.flush();
+   _block_num_to_pos.write( sizeof( index_entry ) * uint64_t(block_header::num_from_id(id)), e );
+   _block_num_to_pos.flush();
+   _current_position = e.block_pos.value() + e.block_size.value();
 }
 
 void block_database::remove( const block_id_type& id )
 { try {
    index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   if( !read_index_entry( block_header::num_from_id(id), e ) )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block ${id} not contained in block database", ("id", id));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
    if( e.block_id == id )
    {
+      const uint32_t num = block_header::num_from_id(id);
+      _cache.invalidate( num );
       e.block_size = 0;
-      _block_num_to_pos.seekp( sizeof(e) * int64_t(block_header::num_from_id(id)) );
-      _block_num_to_pos.write( (char*)&e, sizeof(e) );
+      _block_num_to_pos.write( sizeof(e) * uint64_t(num), e );
+      _block_num_to_pos.flush();
+
+      // the sidecars are dropped with the index entry, the operation offsets of the last block stored are
+      // overwritten by the next one
+      header_entry h;
+      if( _headers.read( sizeof(header_entry) * uint64_t(num), h ) && h.block_id == id )
+      {
+         _headers.write( sizeof(header_entry) * uint64_t(num), header_entry() );
+         _headers.flush();
+         if( h.offsets_size.value() > 0 && h.offsets_pos.value() + h.offsets_size.value() == _op_offsets.size() )
+            _op_offsets.truncate( h.offsets_pos.value() );
+      }
    }
 } FC_CAPTURE_AND_RETHROW( (id) ) }
 
@@ -124,12 +282,8 @@ bool block_database::contains( const block_id_type& id )const
       return false;
 
    index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() < int64_t(index_pos + sizeof(e)) )
+   if( !read_index_entry( block_header::num_from_id(id), e ) )
       return false;
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
 
    return e.block_id == id && e.block_size.value() > 0;
 }
@@ -138,39 +292,84 @@ block_id_type block_database::fetch_block_id( uint32_t block_num )const
 {
    assert( block_num != 0 );
    index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_num);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   if( !read_index_entry( block_num, e ) )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", block_num));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
    FC_ASSERT( e.block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
    return e.block_id;
 }
 
 optional<signed_block> block_database::fetch_optional( const block_id_type& id )const
+{
+   auto block = fetch_shared( id );
+   if( block )
+      return *block;
+   return optional<signed_block>();
+}
+
+optional<signed_block> block_database::fetch_by_number( uint32_t block_num )const
+{
+   auto block = fetch_shared_by_number( block_num );
+   if( block )
+      return *block;
+   return optional<signed_block>();
+}
+
+std::shared_ptr<const signed_block> block_database::fetch_shared( const block_id_type& id )const
+{
+   try
+   {
+      index_entry e;
+      if( !read_index_entry( block_header::num_from_id(id), e ) )
+         return {};
+
+      if( e.block_id != id ) return {};
+
+      return read_block( e );
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return {};
+}
+
+std::shared_ptr<const signed_block> block_database::fetch_shared_by_number( uint32_t block_num )const
 {
    try
    {
       index_entry e;
-      int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      if( !read_index_entry( block_num, e ) )
          return {};
 
-      _block_num_to_pos.seekg( index_pos );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
+      return read_block( e );
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return {};
+}
 
-      if( e.block_id != id ) return optional<signed_block>();
+optional<block_database::packed_block> block_database::fetch_packed_by_number( uint32_t block_num )const
+{
+   try
+   {
+      index_entry e;
+      if( !read_index_entry( block_num, e ) || e.block_size.value() == 0 )
+         return {};
 
-      vector<char> data( e.block_size.value() );
-      _blocks.seekg( e.block_pos.value() );
-      if (e.block_size.value())
-         _blocks.read( data.data(), e.block_size.value() );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
+      packed_block result;
+      result.data = _blocks.map( e.block_pos.value(), e.block_size.value() );
+      if( !result.data )
+         return {};
+      result.id = e.block_id;
+      result.size = e.block_size.value();
+      result.end_position = e.block_pos.value() + e.block_size.value();
       return result;
    }
    catch (const fc::exception&)
@@ -179,28 +378,32 @@ optional<signed_block> block_database::fetch_optional( const block_id_type& id )
    catch (const std::exception&)
    {
    }
-   return optional<signed_block>();
+   return {};
 }
 
-optional<signed_block> block_database::fetch_by_number( uint32_t block_num )const
+optional<signed_block_header> block_database::fetch_block_header( uint32_t block_num )const
 {
    try
    {
       index_entry e;
-      int64_t index_pos = sizeof(e) * int64_t(block_num);
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      if( !read_index_entry( block_num, e ) || e.block_size.value() == 0 )
          return {};
 
-      _block_num_to_pos.seekg( index_pos, _block_num_to_pos.beg );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
+      header_entry h;
+      if( _headers.read( sizeof(header_entry) * uint64_t(block_num), h ) && h.block_id == e.block_id
+            && h.header_size.value() > 0 && h.header_size.value() <= header_entry::max_header_size )
+      {
+         fc::datastream<const char*> ds( h.header, h.header_size.value() );
+         signed_block_header result;
+         fc::raw::unpack( ds, result );
+         if( result.id() == e.block_id )
+            return result;
+      }
 
-      vector<char> data( e.block_size.value() );
-      _blocks.seekg( e.block_pos.value() );
-      _blocks.read( data.data(), e.block_size.value() );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
-      return result;
+      // the header did not fit into the sidecar entry
+      auto block = read_block( e );
+      if( block )
+         return signed_block_header( *block );
    }
    catch (const fc::exception&)
    {
@@ -208,49 +411,215 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
    catch (const std::exception&)
    {
    }
-   return optional<signed_block>();
+   return optional<signed_block_header>();
 }
 
-optional<index_entry> block_database::last_index_entry()const {
+optional<time_point_sec> block_database::fetch_block_time( uint32_t block_num )const
+{
+   try
+   {
+      index_entry e;
+      if( !read_index_entry( block_num, e ) || e.block_size.value() == 0 )
+         return {};
+
+      header_entry h;
+      if( _headers.read( sizeof(header_entry) * uint64_t(block_num), h ) && h.block_id == e.block_id
+            && h.timestamp.value() > 0 )
+         return time_point_sec( h.timestamp.value() );
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   auto header = fetch_block_header( block_num );
+   if( header.valid() )
+      return header->timestamp;
+   return optional<time_point_sec>();
+}
+
+bool block_database::fetch_operation( uint32_t block_num, uint16_t trx_in_block, uint16_t op_in_trx,
+                                      operation& op, operation_result* result )const
+{
    try
    {
       index_entry e;
+      if( !read_index_entry( block_num, e ) || e.block_size.value() == 0 )
+         return false;
+
+      header_entry h;
+      if( _headers.read( sizeof(header_entry) * uint64_t(block_num), h ) && h.block_id == e.block_id
+            && h.offsets_size.value() > 0 )
+      {
+         const auto table_data = _op_offsets.map( h.offsets_pos.value(), h.offsets_size.value() );
+         if( table_data )
+         {
+            const offset_value* table = reinterpret_cast<const offset_value*>( table_data.get() );
+            const uint64_t table_size = h.offsets_size.value() / sizeof(offset_value);
+            const uint32_t num_trx = table[0].value();
+            if( trx_in_block >= num_trx )
+               return false;
+            const uint32_t first_op = table[1 + trx_in_block].value();
+            if( first_op + op_in_trx >= table[2 + trx_in_block].value() )
+               return false;
+            const uint64_t loc = 2 + num_trx + values_per_operation * uint64_t( first_op + op_in_trx );
+            FC_ASSERT( loc + values_per_operation <= table_size, "Corrupt operation offset table" );
+            const uint32_t op_pos = table[loc].value();
+            const uint32_t op_size = table[loc + 1].value();
+            const uint32_t result_pos = table[loc + 2].value();
+            const uint32_t result_size = table[loc + 3].value();
+            FC_ASSERT( uint64_t(op_pos) + op_size <= e.block_size.value()
+                       && uint64_t(result_pos) + result_size <= e.block_size.value(),
+                       "Corrupt operation offset table" );
+
+            const auto op_data = _blocks.map( e.block_pos.value() + op_pos, op_size );
+            if( !op_data )
+               return false;
+            fc::datastream<const char*> op_ds( op_data.get(), op_size );
+            fc::raw::unpack( op_ds, op );
+
+            if( result != nullptr && result_size > 0 )
+            {
+               const auto result_data = _blocks.map( e.block_pos.value() + result_pos, result_size );
+               if( !result_data )
+                  return false;
+               fc::datastream<const char*> result_ds( result_data.get(), result_size );
+               fc::raw::unpack( result_ds, *result );
+            }
+            return true;
+         }
+      }
+
+      // no offset table for this block
+      auto block = read_block( e );
+      if( !block || trx_in_block >= block->transactions.size() )
+         return false;
+      const auto& trx = block->transactions[trx_in_block];
+      if( op_in_trx >= trx.operations.size() )
+         return false;
+      op = trx.operations[op_in_trx];
+      if( result != nullptr && op_in_trx < trx.operation_results.size() )
+         *result = trx.operation_results[op_in_trx];
+      return true;
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return false;
+}
+
+void block_database::store_operation_offsets( const signed_block& b, header_entry& h )
+{
+   try
+   {
+      const auto table = make_operation_offsets( b );
+      h.offsets_size = table.size() * sizeof(offset_value);
+      h.offsets_pos = _op_offsets.append( reinterpret_cast<const char*>( table.data() ), h.offsets_size.value() );
+   }
+   catch (const fc::exception& e)
+   {
+      // fetch_operation() falls back to unpacking the whole block
+      wlog( "Unable to index the operations of block ${n}: ${e}", ("n", b.block_num())("e", e.to_detail_string()) );
+   }
+}
+
+bool block_database::read_index_entry( uint32_t block_num, index_entry& e )const
+{
+   return _block_num_to_pos.read( sizeof(index_entry) * uint64_t(block_num), e );
+}
+
+std::shared_ptr<const signed_block> block_database::read_block( const index_entry& e )const
+{
+   const uint32_t block_num = block_header::num_from_id( e.block_id );
+   auto cached = _cache.get( block_num, e.block_id );
+   if( cached )
+      return cached;
+
+   const auto data = _blocks.map( e.block_pos.value(), e.block_size.value() );
+   if( !data )
+      return std::shared_ptr<const signed_block>();
+
+   fc::datastream<const char*> ds( data.get(), e.block_size.value() );
+   auto result = std::make_shared<signed_block>();
+   fc::raw::unpack( ds, *result );
+   FC_ASSERT( result->id() == e.block_id );
+   if( _fill_cache.load() )
+      _cache.put( block_num, result, e.block_id, e.block_size.value() );
+   return result;
+}
 
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      std::streampos pos = _block_num_to_pos.tellg();
-      if( pos < long(sizeof(index_entry)) )
-         return optional<index_entry>();
+void block_database::set_cache_capacity( uint64_t capacity )
+{
+   _cache.set_capacity( capacity );
+}
 
+void block_database::set_cache_filling( bool enabled )
+{
+   _fill_cache.store( enabled );
+}
+
+void block_database::invalidate_cached_block( uint32_t block_num )
+{
+   _cache.invalidate( block_num );
+}
+
+block_cache_stats block_database::get_cache_stats()const
+{
+   return _cache.get_stats();
+}
+
+bool block_database::is_valid_entry( const index_entry& e )const
+{
+   if( e.block_size.value() == 0 || e.block_pos.value() + e.block_size.value() > _blocks.size() )
+      return false;
+   try
+   {
+      return read_block( e ) != nullptr;
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return false;
+}
+
+void block_database::truncate_invalid_tail()
+{
+   uint64_t pos = _block_num_to_pos.size();
+   pos -= pos % sizeof(index_entry);
+   index_entry e;
+   while( pos > 0 && !( _block_num_to_pos.read( pos - sizeof(index_entry), e ) && is_valid_entry( e ) ) )
+      pos -= sizeof(index_entry);
+
+   if( pos < _block_num_to_pos.size() )
+   {
+      wlog( "Dropping ${n} bytes of block index entries without a readable block",
+            ("n", _block_num_to_pos.size() - pos) );
+      _block_num_to_pos.resize( pos );
+   }
+   if( _headers.size() > pos / sizeof(index_entry) * sizeof(header_entry) )
+      _headers.resize( pos / sizeof(index_entry) * sizeof(header_entry) );
+}
+
+optional<index_entry> block_database::last_index_entry()const {
+   try
+   {
+      // the tail left by a crash is dropped by open(), only removed blocks are skipped here
+      uint64_t pos = _block_num_to_pos.size();
       pos -= pos % sizeof(index_entry);
 
-      _blocks.seekg( 0, _block_num_to_pos.end );
-      const std::streampos blocks_size = _blocks.tellg();
+      index_entry e;
       while( pos > 0 )
       {
          pos -= sizeof(index_entry);
-         _block_num_to_pos.seekg( pos );
-         _block_num_to_pos.read( (char*)&e, sizeof(e) );
-         if( _block_num_to_pos.gcount() == sizeof(e) && e.block_size.value() > 0
-                && int64_t(e.block_pos.value() + e.block_size.value()) <= blocks_size )
-            try
-            {
-               vector<char> data( e.block_size.value() );
-               _blocks.seekg( e.block_pos.value() );
-               _blocks.read( data.data(), e.block_size.value() );
-               if( _blocks.gcount() == long(e.block_size.value()) )
-               {
-                  const signed_block block = fc::raw::unpack<signed_block>(data);
-                  if( block.id() == e.block_id )
-                     return e;
-               }
-            }
-            catch (const fc::exception&)
-            {
-            }
-            catch (const std::exception&)
-            {
-            }
-         fc::resize_file( _index_filename, pos );
+         if( _block_num_to_pos.read( pos, e ) && is_valid_entry( e ) )
+            return e;
       }
    }
    catch (const fc::exception&)
@@ -276,15 +645,35 @@ optional<block_id_type> block_database::last_id()const
    return optional<block_id_type>();
 }
 
+uint32_t block_database::first_block_num()const
+{
+   optional<index_entry> last = last_index_entry();
+   if( !last.valid() )
+      return 0;
+
+   // the stored blocks are the ones from the first block on, so the first one is found by bisection
+   uint32_t first = 1;
+   uint32_t end = block_header::num_from_id( last->block_id );
+   while( first < end )
+   {
+      const uint32_t middle = first + ( end - first ) / 2;
+      index_entry e;
+      if( read_index_entry( middle, e ) && e.block_size.value() > 0 )
+         end = middle;
+      else
+         first = middle + 1;
+   }
+   return first;
+}
+
 size_t block_database::blocks_current_position()const
 {
-   return (size_t)_blocks.tellg();
+   return (size_t)_current_position.load();
 }
 
 size_t block_database::total_block_size()const
 {
-   _blocks.seekg( 0, _blocks.end );
-   return (size_t)_blocks.tellg();
+   return (size_t)_blocks.size();
 }
 
 } }
@@ -34,10 +34,19 @@ namespace graphene { namespace chain {
 
 asset database::get_balance(account_id_type owner, asset_id_type asset_id) const
 {
-   auto& index = get_index_type< primary_index< account_balance_index > >().get_secondary_index<balances_by_account_index>();
-   auto abo = index.get_account_balance( owner, asset_id );
+   const account_balance_object* abo;
+   {
+      // the caller only depends on the balance found, not on the whole index
+      read_tracking untracked( nullptr );
+      auto& index = get_index_type< primary_index< account_balance_index > >().get_secondary_index<balances_by_account_index>();
+      abo = index.get_account_balance( owner, asset_id );
+   }
    if( !abo )
+   {
+      note_index_read( account_balance_object::space_id, account_balance_object::type_id );
       return asset(0, asset_id);
+   }
+   note_read( abo->id );
    return abo->get_balance();
 }
 
@@ -56,8 +65,13 @@ void database::adjust_balance(account_id_type account, asset delta )
    if( delta.amount == 0 )
       return;
 
-   auto& index = get_index_type< primary_index< account_balance_index > >().get_secondary_index<balances_by_account_index>();
-   auto abo = index.get_account_balance( account, delta.asset_id );
+   const account_balance_object* abo;
+   {
+      // the balance found is changed, or the balance created changes the next id of the index
+      read_tracking untracked( nullptr );
+      auto& index = get_index_type< primary_index< account_balance_index > >().get_secondary_index<balances_by_account_index>();
+      abo = index.get_account_balance( account, delta.asset_id );
+   }
    if( !abo )
    {
       FC_ASSERT( delta.amount > 0, "Insufficient Balance: ${a}'s balance of ${b} is less than required ${r}", 
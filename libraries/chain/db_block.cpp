@@ -38,12 +38,35 @@
 
 #include <graphene/protocol/fee_schedule.hpp>
 #include <graphene/protocol/operations_permissions.hpp>
+#include <graphene/protocol/recovered_key_cache.hpp>
 
 #include <fc/io/raw.hpp>
 #include <fc/thread/parallel.hpp>
 
+#include <algorithm>
+#include <deque>
+#include <future>
+
 namespace graphene { namespace chain {
 
+namespace {
+   /** gets the fee of an operation and who pays it */
+   struct operation_fee_visitor
+   {
+      typedef void result_type;
+
+      asset           fee;
+      account_id_type fee_payer;
+
+      template<typename Operation>
+      void operator()( const Operation& op )
+      {
+         fee = op.fee;
+         fee_payer = op.fee_payer();
+      }
+   };
+}
+
 bool database::is_known_block( const block_id_type& id )const
 {
    return _fork_db.is_known_block(id) || _block_id_to_block.contains(id);
@@ -81,6 +104,100 @@ optional<signed_block> database::fetch_block_by_number( uint32_t num )const
       return _block_id_to_block.fetch_by_number(num);
 }
 
+std::shared_ptr<const signed_block> database::fetch_shared_block_by_id( const block_id_type& id )const
+{
+   auto b = _fork_db.fetch_block( id );
+   if( !b )
+      return _block_id_to_block.fetch_shared(id);
+   // shares the ownership of the fork item
+   return std::shared_ptr<const signed_block>( b, &b->data );
+}
+
+std::shared_ptr<const signed_block> database::fetch_shared_block_by_number( uint32_t num )const
+{
+   auto results = _fork_db.fetch_block_by_number(num);
+   if( results.size() == 1 )
+      return std::shared_ptr<const signed_block>( results[0], &results[0]->data );
+   else
+      return _block_id_to_block.fetch_shared_by_number(num);
+}
+
+optional<signed_block_header> database::fetch_block_header_by_number( uint32_t num )const
+{
+   auto results = _fork_db.fetch_block_by_number(num);
+   if( results.size() == 1 )
+      return signed_block_header( results[0]->data );
+   else
+      return _block_id_to_block.fetch_block_header(num);
+}
+
+optional<time_point_sec> database::fetch_block_time_by_number( uint32_t num )const
+{
+   auto results = _fork_db.fetch_block_by_number(num);
+   if( results.size() == 1 )
+      return results[0]->data.timestamp;
+   else
+      return _block_id_to_block.fetch_block_time(num);
+}
+
+uint32_t database::first_block_num()const
+{
+   // every block pushed is stored, the block database only is empty before the first one
+   const uint32_t first = _block_id_to_block.first_block_num();
+   return first ? first : head_block_num() + 1;
+}
+
+optional<operation_history_object> database::fetch_block_operation( uint32_t block_num, uint16_t trx_in_block, uint16_t op_in_trx )const
+{
+   operation_history_object oho;
+   oho.block_num = block_num;
+   oho.trx_in_block = trx_in_block;
+   oho.op_in_trx = op_in_trx;
+
+   auto results = _fork_db.fetch_block_by_number(block_num);
+   if( results.size() == 1 )
+   {
+      const auto& block = results[0]->data;
+      if( trx_in_block >= block.transactions.size() )
+         return {};
+      const auto& trx = block.transactions[trx_in_block];
+      if( op_in_trx >= trx.operations.size() )
+         return {};
+      oho.op = trx.operations[op_in_trx];
+      if( op_in_trx < trx.operation_results.size() )
+         oho.result = trx.operation_results[op_in_trx];
+      return oho;
+   }
+
+   if( !_block_id_to_block.fetch_operation( block_num, trx_in_block, op_in_trx, oho.op, &oho.result ) )
+      return {};
+   return oho;
+}
+
+void database::set_block_cache_capacity( uint64_t capacity )
+{
+   _block_id_to_block.set_cache_capacity( capacity );
+}
+
+block_cache_stats database::get_block_cache_stats()const
+{
+   return _block_id_to_block.get_cache_stats();
+}
+
+void database::set_pending_pool_limits( uint64_t max_size, uint32_t max_per_account )
+{
+   _pending_pool_max_size = max_size;
+   _pending_pool_max_per_account = max_per_account;
+}
+
+pending_pool_stats database::get_pending_pool_stats()const
+{
+   pending_pool_stats stats = _pending_pool_stats;
+   stats.pending = _pending_tx_by_fee_rate.size();
+   stats.size = _pending_tx_size;
+   return stats;
+}
+
 const signed_transaction& database::get_recent_transaction(const transaction_id_type& trx_id) const
 {
    auto& index = get_index_type<transaction_index>().indices().get<by_trx_id>();
@@ -107,6 +224,32 @@ std::vector<block_id_type> database::get_block_ids_on_fork(block_id_type head_of
   return result;
 }
 
+std::shared_lock<std::shared_timed_mutex> database::lock_for_reading()const
+{
+   std::lock_guard<std::mutex> gate( _state_gate );
+   return std::shared_lock<std::shared_timed_mutex>( _state_mutex );
+}
+
+database::write_scope::write_scope( database& db ) : _db( db )
+{
+   if( _db._writer_thread.load() != std::this_thread::get_id() )
+   {
+      std::lock_guard<std::mutex> gate( _db._state_gate );
+      _db._state_mutex.lock();
+      _db._writer_thread = std::this_thread::get_id();
+   }
+   ++_db._write_depth;
+}
+
+database::write_scope::~write_scope()
+{
+   if( --_db._write_depth == 0 )
+   {
+      _db._writer_thread = std::thread::id();
+      _db._state_mutex.unlock();
+   }
+}
+
 /**
  * Push block "may fail" in which case every partial change is unwound.  After
  * push block is successful the block is appended to the chain database on disk.
@@ -116,6 +259,7 @@ std::vector<block_id_type> database::get_block_ids_on_fork(block_id_type head_of
 bool database::push_block(const signed_block& new_block, uint32_t skip)
 {
 //   idump((new_block.block_num())(new_block.id())(new_block.timestamp)(new_block.previous));
+   write_scope writing( *this );
    bool result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -228,11 +372,22 @@ processed_transaction database::push_transaction( const precomputable_transactio
 { try {
    // see https://github.com/bitshares/bitshares-core/issues/1573
    FC_ASSERT( fc::raw::pack_size( trx ) < (1024 * 1024), "Transaction exceeds maximum transaction size." );
+   write_scope writing( *this );
+   // the transactions making room are only evicted once trx is applied, one which fails evicts nothing
+   const vector<size_t> evicted = pending_transactions_to_evict( trx );
    processed_transaction result;
    detail::with_skip_flags( *this, skip, [&]()
    {
       result = _push_transaction( trx );
    } );
+   if( !evicted.empty() )
+   {
+      for( size_t position : evicted )
+         evict_pending_transaction( position );
+      // the pending state is rebuilt without the evicted transactions: their changes are undone, and the
+      // transactions which read them are applied again while the others are kept
+      detail::pending_transactions_restorer restorer( *this, std::move( _pending_tx ) );
+   }
    return result;
 } FC_CAPTURE_AND_RETHROW( (trx) ) }
 
@@ -249,8 +404,15 @@ processed_transaction database::_push_transaction( const precomputable_transacti
    // apply the changes.
 
    auto temp_session = _undo_db.start_undo_session();
-   auto processed_trx = _apply_transaction( trx );
+   db::read_set reads;
+   processed_transaction processed_trx;
+   {
+      read_tracking tracking( &reads );
+      processed_trx = _apply_transaction( trx );
+   }
+   _pending_tx_footprints.push_back( record_pending_footprint( reads ) );
    _pending_tx.push_back(processed_trx);
+   note_pending_transaction( processed_trx );
 
    // notify_changed_objects();
    // The transaction applied successfully. Merge its changes into the pending block session.
@@ -287,6 +449,7 @@ private:
 
 processed_transaction database::push_proposal(const proposal_object& proposal)
 { try {
+   write_scope writing( *this );
    transaction_evaluation_state eval_state(this);
    eval_state._is_proposed_trx = true;
 
@@ -332,6 +495,7 @@ signed_block database::generate_block(
    uint32_t skip /* = 0 */
    )
 { try {
+   write_scope writing( *this );
    signed_block result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -388,12 +552,31 @@ signed_block database::_generate_block(
    size_t total_block_size = max_block_header_size;
 
    signed_block pending_block;
+   pending_block.previous = head_block_id();
+   pending_block.timestamp = when;
+   pending_block.witness = witness_id;
+
+   // The transactions are applied in the session of the new block, which is then finished and kept as the
+   // applied block instead of being applied again by push_block(). The pending transactions which are not
+   // included are pushed again by the restorer, on top of the new block.
+   detail::pending_transactions_restorer restorer( *this, std::move( _pending_tx ) );
 
-   _pending_tx_session = _undo_db.start_undo_session();
+   // the state of the new block can only be kept if the block becomes the head of the fork database, which
+   // is the case unless the fork database holds a longer fork which was not switched to
+   const auto fork_head = _fork_db.head();
+   const bool keep_state = !fork_head || fork_head->id == head_block_id();
 
+   auto block_session = _undo_db.start_undo_session();
+   const witness_object& signing_witness = validate_block_header( skip | skip_witness_signature, pending_block );
+   const bool maint_needed = ( get_dynamic_global_properties().next_maintenance_time <= when );
+   start_block( pending_block.block_num() );
+
+   // the transactions with the highest fee rates go first, so that the ones postponed when the block is full
+   // are the cheapest, see pending_block_order()
    uint64_t postponed_tx_count = 0;
-   for( const processed_transaction& tx : _pending_tx )
+   for( const size_t position : pending_block_order( restorer._pending_transactions, restorer._evicted ) )
    {
+      const processed_transaction& tx = restorer._pending_transactions[position];
       size_t new_total_size = total_block_size + fc::raw::pack_size( tx );
 
       // postpone transaction if it would make block too big
@@ -403,6 +586,13 @@ signed_block database::_generate_block(
          continue;
       }
 
+      // what a transaction which is left out records for the block is dropped with it
+      const size_t applied_op_count = _applied_ops.size();
+      const flat_set<asset_id_type> issue_453_affected_assets = _issue_453_affected_assets;
+      const auto drop_transaction_records = [&]() {
+         _applied_ops.resize( applied_op_count );
+         _issue_453_affected_assets = issue_453_affected_assets;
+      };
       try
       {
          auto temp_session = _undo_db.start_undo_session();
@@ -416,6 +606,7 @@ signed_block database::_generate_block(
          if( new_total_size > maximum_block_size )
          {
             postponed_tx_count++;
+            drop_transaction_records();
             continue;
          }
 
@@ -423,10 +614,12 @@ signed_block database::_generate_block(
 
          total_block_size = new_total_size;
          pending_block.transactions.push_back( ptx );
+         ++_current_trx_in_block;
       }
       catch ( const fc::exception& e )
       {
          // Do nothing, transaction will not be re-applied
+         drop_transaction_records();
          wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
          wlog( "The transaction was ${t}", ("t", tx) );
       }
@@ -436,23 +629,35 @@ signed_block database::_generate_block(
       wlog( "Postponed ${n} transactions due to block size limit", ("n", postponed_tx_count) );
    }
 
-   _pending_tx_session.reset();
-
-   // We have temporarily broken the invariant that
-   // _pending_tx_session is the result of applying _pending_tx, as
-   // _pending_tx now consists of the set of postponed transactions.
-   // However, the push_block() call below will re-create the
-   // _pending_tx_session.
-
-   pending_block.previous = head_block_id();
-   pending_block.timestamp = when;
    pending_block.transaction_merkle_root = pending_block.calculate_merkle_root();
-   pending_block.witness = witness_id;
 
    if( !(skip & skip_witness_signature) )
       pending_block.sign( block_signing_private_key );
 
-   push_block( pending_block, skip | skip_transaction_signatures ); // skip authority check when pushing self-generated blocks
+   // the block is finished like push_block() applies self-generated blocks, and the transactions left out
+   // are pushed again like push_block() does, without checking their authorities again
+   node_properties().skip_flags |= skip_transaction_signatures;
+
+   if( !keep_state )
+   {
+      block_session.undo();
+      push_block( pending_block, skip | skip_transaction_signatures ); // skip authority check when pushing self-generated blocks
+      return pending_block;
+   }
+
+   const block_id_type block_id = pending_block.id();
+   try {
+      FC_ASSERT( _fork_db.push_block( pending_block )->id == block_id, "Generated block is not the head of the fork database" );
+      finish_block( pending_block, signing_witness, maint_needed );
+      if( _db_checkpoint_interval > 0 && pending_block.block_num() % _db_checkpoint_interval == 0 )
+         write_db_checkpoint();
+      _block_id_to_block.store( block_id, pending_block );
+      block_session.commit();
+   } catch ( const fc::exception& e ) {
+      elog( "Failed to apply generated block:\n${e}", ("e", e.to_detail_string()) );
+      _fork_db.remove( block_id );
+      throw;
+   }
 
    return pending_block;
 } FC_CAPTURE_AND_RETHROW( (witness_id) ) }
@@ -463,6 +668,7 @@ signed_block database::_generate_block(
  */
 void database::pop_block()
 { try {
+   write_scope writing( *this );
    _pending_tx_session.reset();
    auto fork_db_head = _fork_db.head();
    FC_ASSERT( fork_db_head, "Trying to pop() from empty fork database!?" );
@@ -473,17 +679,414 @@ void database::pop_block()
       fork_db_head = _fork_db.fetch_block( head_block_id() );
       FC_ASSERT( fork_db_head, "Trying to pop() block that's not in fork database!?" );
    }
+   _block_id_to_block.invalidate_cached_block( fork_db_head->num );
    pop_undo();
    _popped_tx.insert( _popped_tx.begin(), fork_db_head->data.transactions.begin(), fork_db_head->data.transactions.end() );
+   popped_block( head_block_num() );
 } FC_CAPTURE_AND_RETHROW() }
 
 void database::clear_pending()
 { try {
+   write_scope writing( *this );
    assert( (_pending_tx.size() == 0) || _pending_tx_session.valid() );
    _pending_tx.clear();
+   _pending_tx_footprints.clear();
+   _pending_tx_ranks.clear();
+   _pending_tx_by_fee_rate.clear();
+   _pending_tx_per_account.clear();
+   _pending_tx_size = 0;
+   _evicted_tx.clear();
    _pending_tx_session.reset();
 } FC_CAPTURE_AND_RETHROW() }
 
+pending_transaction_rank database::rank_pending_transaction( const transaction& trx )const
+{
+   pending_transaction_rank rank;
+   rank.size = fc::raw::pack_size( trx );
+   uint64_t core_fees = 0;
+   for( size_t i = 0; i < trx.operations.size(); ++i )
+   {
+      operation_fee_visitor visitor;
+      trx.operations[i].visit( visitor );
+      if( i == 0 )
+         rank.fee_payer = visitor.fee_payer;
+      if( visitor.fee.amount <= 0 )
+         continue;
+      if( visitor.fee.asset_id == asset_id_type() )
+         core_fees += visitor.fee.amount.value;
+      else if( const asset_object* fee_asset = find( visitor.fee.asset_id ) )
+      {
+         try {
+            core_fees += ( visitor.fee * fee_asset->options.core_exchange_rate ).amount.value;
+         } catch( const fc::exception& ) { // a fee which cannot be converted does not rank the transaction
+         }
+      }
+   }
+   core_fees = std::min<uint64_t>( core_fees, GRAPHENE_MAX_SHARE_SUPPLY );
+   rank.fee_rate = core_fees * 1024 / std::max<uint64_t>( rank.size, 1 );
+   return rank;
+}
+
+void database::note_pending_transaction( const processed_transaction& trx )
+{
+   const pending_transaction_rank rank = rank_pending_transaction( trx );
+   _pending_tx_by_fee_rate.emplace( rank.fee_rate, _pending_tx_ranks.size() );
+   ++_pending_tx_per_account[rank.fee_payer];
+   _pending_tx_size += rank.size;
+   _pending_tx_ranks.push_back( rank );
+}
+
+vector<size_t> database::pending_transactions_to_evict( const transaction& trx )
+{
+   vector<size_t> result;
+   if( _pending_pool_max_size == 0 && _pending_pool_max_per_account == 0 )
+      return result;
+   const pending_transaction_rank rank = rank_pending_transaction( trx );
+   uint64_t freed = 0;
+   if( _pending_pool_max_per_account > 0 )
+   {
+      const auto itr = _pending_tx_per_account.find( rank.fee_payer );
+      if( itr != _pending_tx_per_account.end() && itr->second >= _pending_pool_max_per_account )
+      {
+         // a higher fee rate replaces the pending transaction of the fee payer with the lowest one
+         const auto replaced = std::find_if( _pending_tx_by_fee_rate.begin(), _pending_tx_by_fee_rate.end(),
+               [this,&rank]( const std::pair<const uint64_t,size_t>& pending ) {
+                  return _pending_tx_ranks[pending.second].fee_payer == rank.fee_payer;
+               } );
+         if( replaced == _pending_tx_by_fee_rate.end() || replaced->first >= rank.fee_rate )
+         {
+            ++_pending_pool_stats.total_rejected;
+            FC_THROW( "Account ${a} already has ${n} pending transactions", ("a", rank.fee_payer)("n", itr->second) );
+         }
+         result.push_back( replaced->second );
+         freed += _pending_tx_ranks[replaced->second].size;
+      }
+   }
+   if( _pending_pool_max_size == 0 || _pending_tx_size - freed + rank.size <= _pending_pool_max_size )
+      return result;
+
+   // the transactions with the lowest fee rates make room, if there are enough of them
+   for( auto itr = _pending_tx_by_fee_rate.begin();
+        _pending_tx_size - freed + rank.size > _pending_pool_max_size
+           && itr != _pending_tx_by_fee_rate.end() && itr->first < rank.fee_rate;
+        ++itr )
+   {
+      if( !result.empty() && itr->second == result.front() )
+         continue;
+      result.push_back( itr->second );
+      freed += _pending_tx_ranks[itr->second].size;
+   }
+   if( _pending_tx_size - freed + rank.size > _pending_pool_max_size )
+   {
+      ++_pending_pool_stats.total_rejected;
+      FC_THROW( "The pending transaction pool is full, the fee rate of ${r} per kilobyte is too low",
+                ("r", rank.fee_rate) );
+   }
+   return result;
+}
+
+void database::evict_pending_transaction( size_t position )
+{
+   const pending_transaction_rank& evicted = _pending_tx_ranks[position];
+   const auto range = _pending_tx_by_fee_rate.equal_range( evicted.fee_rate );
+   const auto itr = std::find_if( range.first, range.second,
+                                  [position]( const std::pair<const uint64_t,size_t>& pending ) {
+                                     return pending.second == position;
+                                  } );
+   FC_ASSERT( itr != range.second, "Pending transaction ${p} was evicted already", ("p", position) );
+   _pending_tx_by_fee_rate.erase( itr );
+   _evicted_tx.insert( _pending_tx[position].id() );
+   _pending_tx_size -= evicted.size;
+   if( --_pending_tx_per_account[evicted.fee_payer] == 0 )
+      _pending_tx_per_account.erase( evicted.fee_payer );
+   ++_pending_pool_stats.total_evicted;
+}
+
+vector<size_t> database::pending_block_order( const vector<processed_transaction>& transactions,
+                                              const std::set<transaction_id_type>& evicted )const
+{
+   // the transactions of each fee payer, in the order they were pushed
+   vector<pending_transaction_rank> ranks;
+   ranks.reserve( transactions.size() );
+   std::map< account_id_type, std::deque<size_t> > queues;
+   for( size_t i = 0; i < transactions.size(); ++i )
+   {
+      ranks.push_back( rank_pending_transaction( transactions[i] ) );
+      if( evicted.empty() || evicted.count( transactions[i].id() ) == 0 )
+         queues[ranks.back().fee_payer].push_back( i );
+   }
+
+   struct turn
+   {
+      uint64_t fee_rate;
+      uint32_t turns_taken;
+      size_t   position;
+
+      /** @return true if this turn comes first */
+      bool operator<( const turn& other )const
+      {
+         if( fee_rate != other.fee_rate )
+            return fee_rate > other.fee_rate;
+         if( turns_taken != other.turns_taken )
+            return turns_taken < other.turns_taken;
+         return position < other.position;
+      }
+   };
+   std::set<turn> next_turns;
+   for( const auto& queue : queues )
+      next_turns.insert( turn{ ranks[queue.second.front()].fee_rate, 0, queue.second.front() } );
+
+   vector<size_t> order;
+   order.reserve( transactions.size() );
+   while( !next_turns.empty() )
+   {
+      const turn current = *next_turns.begin();
+      next_turns.erase( next_turns.begin() );
+      order.push_back( current.position );
+      auto& queue = queues[ranks[current.position].fee_payer];
+      queue.pop_front();
+      if( !queue.empty() )
+         next_turns.insert( turn{ ranks[queue.front()].fee_rate, current.turns_taken + 1, queue.front() } );
+   }
+   return order;
+}
+
+pending_transaction_footprint database::record_pending_footprint( const db::read_set& reads )
+{
+   pending_transaction_footprint footprint;
+   if( !_undo_db.enabled() || _undo_db.size() == 0 )
+      return footprint;
+   const auto is_transaction_history = []( object_id_type id ) {
+      return id.space() == transaction_history_object::space_id && id.type() == transaction_history_object::type_id;
+   };
+
+   const undo_state& changes = _undo_db.head();
+   for( const object_id_type& id : reads.objects )
+      footprint.read_objects.push_back( id );
+   for( const object_id_type& id : reads.indexes )
+      footprint.read_indexes.push_back( id );
+   for( const auto& item : changes.old_values )
+      footprint.modified.push_back( get_object( item.first ).clone() );
+   for( const object_id_type& id : changes.new_ids )
+   {
+      if( is_transaction_history( id ) )
+         footprint.recorded_for_dupe_check = true;
+      else
+         footprint.created.push_back( get_object( id ).clone() );
+   }
+   std::sort( footprint.created.begin(), footprint.created.end(),
+              []( const unique_ptr<object>& a, const unique_ptr<object>& b ) { return a->id < b->id; } );
+   for( const auto& item : changes.removed )
+      footprint.removed.push_back( item.first );
+   for( const auto& item : changes.old_index_next_ids )
+   {
+      const object_id_type before = item.second;
+      if( is_transaction_history( before ) )
+         continue;
+      // the copies are inserted by increasing id, their undo only restores the next id of the index if the
+      // first object created in it was not removed again
+      if( changes.new_ids.count( before ) == 0 )
+         return pending_transaction_footprint();
+      footprint.next_ids.push_back( { before, get_index( before.space(), before.type() ).get_next_id() } );
+   }
+   footprint.valid = true;
+   return footprint;
+}
+
+void database::keep_pending_transaction( const processed_transaction& trx, pending_transaction_footprint& footprint )
+{
+   if( !_pending_tx_session.valid() )
+      _pending_tx_session = _undo_db.start_undo_session();
+
+   // like in _push_transaction(), the changes are discarded if they cannot all be made
+   auto temp_session = _undo_db.start_undo_session();
+   for( const object_id_type& id : footprint.removed )
+      remove( get_object( id ) );
+   for( const auto& obj : footprint.modified )
+      modify( get_object( obj->id ), [&obj]( object& o ) { o.move_from( *obj->clone() ); } );
+   for( const auto& obj : footprint.created )
+      insert( std::move( *obj->clone() ) );
+   for( const auto& change : footprint.next_ids )
+      get_mutable_index( change.before.space(), change.before.type() ).set_next_id( change.after );
+   if( footprint.recorded_for_dupe_check )
+   {
+      create<transaction_history_object>([&trx](transaction_history_object& transaction) {
+         transaction.trx_id = trx.id();
+         transaction.trx = trx;
+      });
+   }
+   _pending_tx.push_back( trx );
+   _pending_tx_footprints.push_back( std::move( footprint ) );
+   note_pending_transaction( trx );
+   temp_session.merge();
+
+   notify_on_pending_transaction( trx );
+}
+
+void database::restore_pending_transactions( vector<processed_transaction>&& transactions,
+                                             vector<pending_transaction_footprint>&& footprints,
+                                             const std::set<transaction_id_type>& evicted,
+                                             const block_id_type& previous_head )
+{
+   // the objects, and their indexes, changed since the pending transactions were applied
+   db::undo_id_set changed_objects;
+   db::undo_id_set changed_indexes;
+   const auto note_change = [&changed_objects,&changed_indexes]( object_id_type id ) {
+      changed_objects.insert( id );
+      changed_indexes.insert( object_id_type( id.space(), id.type(), 0 ) );
+   };
+   const auto note_footprint_changes = [&note_change]( const pending_transaction_footprint& footprint ) {
+      for( const auto& obj : footprint.modified )
+         note_change( obj->id );
+      for( const auto& obj : footprint.created )
+         note_change( obj->id );
+      for( const object_id_type& id : footprint.removed )
+         note_change( id );
+   };
+
+   // after a fork switch, or anything else than a single block applied on top of the previous head, all
+   // transactions are applied again
+   bool keep = ( footprints.size() == transactions.size() && _popped_tx.empty() );
+   if( keep && head_block_id() != previous_head )
+   {
+      const auto head = _fork_db.fetch_block( head_block_id() );
+      keep = head && head->data.previous == previous_head
+             && _undo_db.enabled() && _undo_db.active_sessions() == 0 && _undo_db.size() > 0;
+      if( keep )
+      {
+         const undo_state& block_changes = _undo_db.head();
+         for( const auto& item : block_changes.old_values )
+            note_change( item.first );
+         for( const object_id_type& id : block_changes.new_ids )
+            note_change( id );
+         for( const auto& item : block_changes.removed )
+            note_change( item.first );
+         keep = changed_objects.count( get_global_properties().id ) == 0
+                && changed_objects.count( get_core_asset().id ) == 0
+                && changed_objects.count( get_core_dynamic_data().id ) == 0;
+         // nor did the block cross a hardfork which _apply_transaction() checks with the untracked head block time
+         const auto old_dgpo = block_changes.old_values.find( get_dynamic_global_properties().id );
+         if( keep && old_dgpo != block_changes.old_values.end() )
+         {
+            const time_point_sec before = static_cast<const dynamic_global_property_object*>( old_dgpo->second )->time;
+            const time_point_sec after = head_block_time();
+            keep = ( before >= HARDFORK_CORE_584_TIME ) == ( after >= HARDFORK_CORE_584_TIME )
+                   && ( before <= HARDFORK_CORE_1573_TIME ) == ( after <= HARDFORK_CORE_1573_TIME );
+         }
+         else
+            keep = false;
+      }
+   }
+   // the expiration and TaPoS checks of _apply_transaction() are not tracked, they are made again
+   const bool check_tapos = !( get_node_properties().skip_flags & skip_tapos_check );
+   const auto head_checks_pass = [this,check_tapos]( const processed_transaction& tx, time_point_sec now ) {
+      if( now > tx.expiration )
+         return false;
+      if( !check_tapos )
+         return true;
+      const block_summary_object* summary = find( block_summary_id_type( tx.ref_block_num ) );
+      return summary != nullptr && tx.ref_block_prefix == summary->block_id._hash[1].value();
+   };
+   const auto affected = [&]( const pending_transaction_footprint& footprint ) {
+      for( const object_id_type& id : footprint.read_objects )
+         if( changed_objects.count( id ) )
+            return true;
+      for( const object_id_type& id : footprint.read_indexes )
+         if( changed_indexes.count( id ) )
+            return true;
+      for( const auto& obj : footprint.modified )
+         if( changed_objects.count( obj->id ) )
+            return true;
+      for( const object_id_type& id : footprint.removed )
+         if( changed_objects.count( id ) )
+            return true;
+      for( const auto& change : footprint.next_ids )
+         if( get_index( change.before.space(), change.before.type() ).get_next_id() != change.before )
+            return true;
+      return false;
+   };
+
+   for( const auto& tx : _popped_tx )
+   {
+      try {
+         if( !is_known_transaction( tx.id() ) ) {
+            _push_transaction( tx );
+         }
+      } catch ( const fc::exception& ) { // ignore invalid transactions
+      }
+   }
+   _popped_tx.clear();
+
+   uint64_t kept = 0;
+   uint64_t reapplied = 0;
+   uint64_t dropped = 0;
+   fc::microseconds keep_time;
+   fc::microseconds reapply_time;
+   const fc::time_point_sec now = head_block_time();
+   for( size_t i = 0; i < transactions.size(); ++i )
+   {
+      const processed_transaction& tx = transactions[i];
+      if( is_known_transaction( tx.id() ) )
+      {
+         ++dropped;
+         continue;
+      }
+      if( evicted.count( tx.id() ) )
+      {
+         // the following transactions may have read what it changed
+         if( keep )
+            note_footprint_changes( footprints[i] );
+         ++dropped;
+         continue;
+      }
+      const fc::time_point start = fc::time_point::now();
+      if( keep && footprints[i].valid && head_checks_pass( tx, now ) && !affected( footprints[i] ) )
+      {
+         try
+         {
+            keep_pending_transaction( tx, footprints[i] );
+            ++kept;
+            keep_time += fc::time_point::now() - start;
+            continue;
+         }
+         catch( const fc::exception& e )
+         {
+            dlog( "Pending transaction ${id} could not be kept, applying it again: ${e}",
+                  ("id", tx.id())("e", e.to_detail_string()) );
+         }
+      }
+      // what the transaction changed before, and changes now, may have been read by the following ones
+      if( keep )
+         note_footprint_changes( footprints[i] );
+      try
+      {
+         _push_transaction( tx );
+         ++reapplied;
+         if( keep )
+            note_footprint_changes( _pending_tx_footprints.back() );
+      }
+      catch( const fc::exception& )
+      { // ignore invalid transactions
+         ++dropped;
+      }
+      reapply_time += fc::time_point::now() - start;
+   }
+
+   _pending_pool_stats.last_kept = kept;
+   _pending_pool_stats.last_reapplied = reapplied;
+   _pending_pool_stats.last_dropped = dropped;
+   _pending_pool_stats.last_keep_time = keep_time.count();
+   _pending_pool_stats.last_reapply_time = reapply_time.count();
+   _pending_pool_stats.total_kept += kept;
+   _pending_pool_stats.total_reapplied += reapplied;
+   _pending_pool_stats.total_dropped += dropped;
+   _pending_pool_stats.total_keep_time += keep_time.count();
+   _pending_pool_stats.total_reapply_time += reapply_time.count();
+   if( !transactions.empty() )
+      dlog( "Kept ${k} pending transactions in ${kt} us, applied ${r} again in ${rt} us, dropped ${d}",
+            ("k", kept)("kt", keep_time.count())("r", reapplied)("rt", reapply_time.count())("d", dropped) );
+}
+
 uint32_t database::push_applied_operation( const operation& op )
 {
    _applied_ops.emplace_back(op);
@@ -529,7 +1132,26 @@ void database::apply_block( const signed_block& next_block, uint32_t skip )
    {
       _apply_block( next_block );
    } );
-   return;
+
+   if( _db_checkpoint_interval > 0 && block_num % _db_checkpoint_interval == 0 )
+      write_db_checkpoint();
+}
+
+void database::write_db_checkpoint()
+{
+   // each undo state holds one block, the oldest one the undo history can return to is checkpointed
+   if( _undo_db.size() >= head_block_num() )
+      return;
+   const uint32_t block_num = head_block_num() - _undo_db.size();
+   if( _undo_db.enabled() && block_num > get_dynamic_global_properties().last_irreversible_block_num )
+   {
+      wlog( "Skipping object database checkpoint, block ${n} is not irreversible yet", ("n",block_num) );
+      return;
+   }
+   const block_id_type block_id = ( block_num == head_block_num() ) ? head_block_id()
+                                                                    : _block_id_to_block.fetch_block_id( block_num );
+   ilog( "Writing object database checkpoint at block ${n}", ("n",block_num) );
+   object_database::checkpoint( fc::mutable_variant_object( "head_block_num", block_num )( "head_block_id", block_id ) );
 }
 
 void database::_apply_block( const signed_block& next_block )
@@ -551,20 +1173,22 @@ void database::_apply_block( const signed_block& next_block )
               ("id",next_block.id()) );
 
    const witness_object& signing_witness = validate_block_header(skip, next_block);
-   const auto& global_props = get_global_properties();
-   const auto& dynamic_global_props = get_dynamic_global_properties();
-   bool maint_needed = (dynamic_global_props.next_maintenance_time <= next_block.timestamp);
+   bool maint_needed = (get_dynamic_global_properties().next_maintenance_time <= next_block.timestamp);
 
-   // trx_in_block starts from 0.
-   // For real operations which are explicitly included in a transaction, op_in_trx starts from 0, virtual_op is 0.
-   // For virtual operations that are derived directly from a real operation,
-   //     use the real operation's (block_num,trx_in_block,op_in_trx), virtual_op starts from 1.
-   // For virtual operations created after processed all transactions,
-   //     trx_in_block = the_block.trsanctions.size(), op_in_trx is 0, virtual_op starts from 0.
-   _current_block_num    = next_block_num;
-   _current_trx_in_block = 0;
+   start_block( next_block_num );
 
-   _issue_453_affected_assets.clear();
+   // the results are only valid while this block is applied, whether it succeeds or not
+   struct block_authorities_scope
+   {
+      database& db;
+      ~block_authorities_scope()
+      {
+         db._block_authorities.clear();
+         db._block_authority_changes.clear();
+      }
+   } authorities_scope{ *this };
+   if( !(skip & skip_transaction_signatures) && next_block.transactions.size() > 1 )
+      verify_block_authorities( next_block );
 
    for( const auto& trx : next_block.transactions )
    {
@@ -578,6 +1202,27 @@ void database::_apply_block( const signed_block& next_block )
       ++_current_trx_in_block;
    }
 
+   finish_block( next_block, signing_witness, maint_needed );
+} FC_CAPTURE_AND_RETHROW( (next_block.block_num()) )  }
+
+void database::start_block( uint32_t next_block_num )
+{
+   _applied_ops.clear();
+
+   // trx_in_block starts from 0.
+   // For real operations which are explicitly included in a transaction, op_in_trx starts from 0, virtual_op is 0.
+   // For virtual operations that are derived directly from a real operation,
+   //     use the real operation's (block_num,trx_in_block,op_in_trx), virtual_op starts from 1.
+   // For virtual operations created after processed all transactions,
+   //     trx_in_block = the_block.trsanctions.size(), op_in_trx is 0, virtual_op starts from 0.
+   _current_block_num    = next_block_num;
+   _current_trx_in_block = 0;
+
+   _issue_453_affected_assets.clear();
+}
+
+void database::finish_block( const signed_block& next_block, const witness_object& signing_witness, bool maint_needed )
+{
    _current_op_in_trx    = 0;
    _current_virtual_op   = 0;
 
@@ -588,7 +1233,7 @@ void database::_apply_block( const signed_block& next_block )
 
    // Are we at the maintenance interval?
    if( maint_needed )
-      perform_chain_maintenance(next_block, global_props);
+      perform_chain_maintenance(next_block, get_global_properties());
 
    create_block_summary(next_block);
    clear_expired_transactions();
@@ -614,7 +1259,7 @@ void database::_apply_block( const signed_block& next_block )
    _applied_ops.clear();
 
    notify_changed_objects();
-} FC_CAPTURE_AND_RETHROW( (next_block.block_num()) )  }
+}
 
 
 
@@ -642,9 +1287,17 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    const chain_parameters& chain_parameters = get_global_properties().parameters;
    eval_state._trx = &trx;
 
-   if( !(skip & skip_transaction_signatures) )
+   // The head block changes with every block, so the checks depending on it are not recorded as reads of the
+   // transaction. restore_pending_transactions() makes them again when it keeps a pending transaction.
+   fc::time_point_sec now;
    {
-      bool allow_non_immediate_owner = ( head_block_time() >= HARDFORK_CORE_584_TIME );
+      read_tracking untracked( nullptr );
+      now = head_block_time();
+   }
+
+   if( !(skip & skip_transaction_signatures) && !authorities_verified_before_block( trx ) )
+   {
+      bool allow_non_immediate_owner = ( now >= HARDFORK_CORE_584_TIME );
       auto get_active = [&]( account_id_type id ) { return &id(*this).active; };
       auto get_owner  = [&]( account_id_type id ) { return &id(*this).owner;  };
       trx.verify_authority( chain_id,
@@ -656,25 +1309,26 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
 
    //Skip all manner of expiration and TaPoS checking if we're on block 1; It's impossible that the transaction is
    //expired, and TaPoS makes no sense as no blocks exist.
-   if( BOOST_LIKELY(head_block_num() > 0) )
    {
-      if( !(skip & skip_tapos_check) )
+      read_tracking untracked( nullptr );
+      if( BOOST_LIKELY(head_block_num() > 0) )
       {
-         const auto& tapos_block_summary = block_summary_id_type( trx.ref_block_num )(*this);
-
-         //Verify TaPoS block summary has correct ID prefix, and that this block's time is not past the expiration
-         FC_ASSERT( trx.ref_block_prefix == tapos_block_summary.block_id._hash[1].value() );
-      }
+         if( !(skip & skip_tapos_check) )
+         {
+            const auto& tapos_block_summary = block_summary_id_type( trx.ref_block_num )(*this);
 
-      fc::time_point_sec now = head_block_time();
+            //Verify TaPoS block summary has correct ID prefix, and that this block's time is not past the expiration
+            FC_ASSERT( trx.ref_block_prefix == tapos_block_summary.block_id._hash[1].value() );
+         }
 
-      FC_ASSERT( trx.expiration <= now + chain_parameters.maximum_time_until_expiration, "",
-                 ("trx.expiration",trx.expiration)("now",now)("max_til_exp",chain_parameters.maximum_time_until_expiration));
-      FC_ASSERT( now <= trx.expiration, "", ("now",now)("trx.exp",trx.expiration) );
-      if ( !(skip & skip_block_size_check ) ) // don't waste time on replay
-         FC_ASSERT( head_block_time() <= HARDFORK_CORE_1573_TIME
-               || trx.get_packed_size() <= chain_parameters.maximum_transaction_size,
-               "Transaction exceeds maximum transaction size." );
+         FC_ASSERT( trx.expiration <= now + chain_parameters.maximum_time_until_expiration, "",
+                    ("trx.expiration",trx.expiration)("now",now)("max_til_exp",chain_parameters.maximum_time_until_expiration));
+         FC_ASSERT( now <= trx.expiration, "", ("now",now)("trx.exp",trx.expiration) );
+         if ( !(skip & skip_block_size_check ) ) // don't waste time on replay
+            FC_ASSERT( now <= HARDFORK_CORE_1573_TIME
+                  || trx.get_packed_size() <= chain_parameters.maximum_transaction_size,
+                  "Transaction exceeds maximum transaction size." );
+      }
    }
 
    //Insert transaction into unique transactions database.
@@ -702,6 +1356,76 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    return ptrx;
 } FC_CAPTURE_AND_RETHROW( (trx) ) }
 
+void database::verify_block_authorities( const signed_block& block )
+{ try {
+   _block_authorities.resize( block.transactions.size() );
+   const chain_id_type& chain_id = get_chain_id();
+   const bool allow_non_immediate_owner = ( head_block_time() >= HARDFORK_CORE_584_TIME );
+   const uint32_t max_authority_depth = get_global_properties().parameters.max_authority_depth;
+
+   // nothing modifies the state before all workers are done, so they can read it concurrently
+   const auto verify = [this,&block,&chain_id,allow_non_immediate_owner,max_authority_depth]
+                       ( size_t begin, size_t end ) {
+      for( size_t i = begin; i < end; ++i )
+      {
+         verified_authorities& verified = _block_authorities[i];
+         auto get_active = [this,&verified]( account_id_type id ) {
+            verified.accounts.insert( id );
+            return &id(*this).active;
+         };
+         auto get_owner  = [this,&verified]( account_id_type id ) {
+            verified.accounts.insert( id );
+            return &id(*this).owner;
+         };
+         try
+         {
+            block.transactions[i].verify_authority( chain_id, get_active, get_owner, allow_non_immediate_owner,
+                                                    max_authority_depth );
+            verified.trx = &block.transactions[i];
+         }
+         catch( const fc::exception& )
+         {
+         }
+         catch( const std::exception& )
+         {
+         }
+      }
+   };
+
+   // waiting for fc futures would let other tasks of this thread modify the state in the meantime,
+   // so the workers are plain threads and the first chunk is verified here
+   const uint32_t chunks = fc::asio::default_io_service_scope::get_num_threads();
+   const size_t chunk_size = ( block.transactions.size() + chunks - 1 ) / chunks;
+   std::vector<std::future<void>> workers;
+   workers.reserve( chunks );
+   for( size_t base = chunk_size; base < block.transactions.size(); base += chunk_size )
+      workers.push_back( std::async( std::launch::async, [&verify,&block,base,chunk_size] () {
+         verify( base, std::min( base + chunk_size, block.transactions.size() ) );
+      }) );
+   verify( 0, std::min( chunk_size, block.transactions.size() ) );
+   for( auto& worker : workers )
+      worker.get();
+} FC_CAPTURE_AND_RETHROW( (block.block_num()) ) }
+
+bool database::authorities_verified_before_block( const signed_transaction& trx )const
+{
+   if( _current_trx_in_block >= _block_authorities.size() )
+      return false;
+   const verified_authorities& verified = _block_authorities[_current_trx_in_block];
+   if( verified.trx != &trx )
+      return false;
+   for( const auto& account : verified.accounts )
+      if( _block_authority_changes.find( account ) != _block_authority_changes.end() )
+         return false;
+   return true;
+}
+
+void database::note_authority_change( account_id_type account )
+{
+   if( !_block_authorities.empty() )
+      _block_authority_changes.insert( account );
+}
+
 operation_result database::apply_operation(transaction_evaluation_state& eval_state, const operation& op)
 { try {
    int i_which = op.which();
@@ -786,14 +1510,21 @@ fc::future<void> database::precompute_parallel( const signed_block& block, const
          _precompute_parallel( &block.transactions[0], block.transactions.size(), skip );
       else
       {
+         // the signatures of all transactions are recovered in one batch in the returned future instead,
+         // the transactions find their keys in the cache when they are verified
+         const bool batch_signatures = !(skip&skip_transaction_signatures)
+                                       && recovered_key_cache::instance().capacity() > 0;
+         const uint32_t trx_skip = batch_signatures ? skip | skip_transaction_signatures : skip;
          uint32_t chunks = fc::asio::default_io_service_scope::get_num_threads();
          uint32_t chunk_size = ( block.transactions.size() + chunks - 1 ) / chunks;
-         workers.reserve( chunks + 1 );
+         workers.reserve( chunks + 2 );
+         if( batch_signatures )
+            workers.push_back( fc::do_parallel( [this,&block] () { precompute_signature_keys( block ); } ) );
          for( size_t base = 0; base < block.transactions.size(); base += chunk_size )
-            workers.push_back( fc::do_parallel( [this,&block,base,chunk_size,skip] () {
+            workers.push_back( fc::do_parallel( [this,&block,base,chunk_size,trx_skip] () {
                _precompute_parallel( &block.transactions[base],
                                      base + chunk_size < block.transactions.size() ? chunk_size : block.transactions.size() - base,
-                                     skip );
+                                     trx_skip );
             }) );
       }
    }
@@ -814,6 +1545,37 @@ fc::future<void> database::precompute_parallel( const signed_block& block, const
    return *first;
 } FC_LOG_AND_RETHROW() }
 
+void database::precompute_signature_keys( const signed_block& block )const
+{
+   try
+   {
+      const chain_id_type& chain_id = get_chain_id();
+      vector< std::pair<digest_type, signature_type> > signatures;
+      for( const auto& trx : block.transactions )
+      {
+         const digest_type digest = trx.sig_digest( chain_id );
+         for( const auto& sig : trx.signatures )
+            signatures.emplace_back( digest, sig );
+      }
+      recovered_key_cache::instance().recover( signatures, fc::asio::default_io_service_scope::get_num_threads() );
+   }
+   catch( const fc::exception& )
+   {
+      // invalid signatures are reported when the transaction is verified
+   }
+}
+
+void database::precompute_block( const signed_block& block, const uint32_t skip )const
+{
+   if( !block.transactions.empty() )
+      _precompute_parallel( &block.transactions[0], block.transactions.size(), skip );
+   if( !(skip&skip_witness_signature) )
+      block.signee();
+   if( !(skip&skip_merkle_check) )
+      block.calculate_merkle_root();
+   block.id();
+}
+
 fc::future<void> database::precompute_parallel( const precomputable_transaction& trx )const
 {
    return fc::do_parallel([this,&trx] () {
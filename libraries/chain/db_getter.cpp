@@ -52,6 +52,8 @@ const chain_property_object& database::get_chain_properties()const
 
 const dynamic_global_property_object& database::get_dynamic_global_properties() const
 {
+   // read through the cached pointer, get() would have recorded it for the pending transactions
+   note_read( _p_dyn_global_prop_obj->id );
    return *_p_dyn_global_prop_obj;
 }
 
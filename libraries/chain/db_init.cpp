@@ -232,6 +232,17 @@ void database::initialize_indexes()
    add_index< primary_index< buyback_index                                > >();
    add_index< primary_index<collateral_bid_index                          > >();
    add_index< primary_index< simple_index< fba_accumulator_object       > > >();
+
+   // the indexes added after this point are the ones of plugins
+   _chain_indexes.clear();
+   inspect_all_indexes( [this]( const graphene::db::index& idx ) {
+      _chain_indexes.emplace( idx.object_space_id(), idx.object_type_id() );
+   } );
+}
+
+bool database::is_chain_index( uint8_t space_id, uint8_t type_id )const
+{
+   return _chain_indexes.find( std::make_pair( space_id, type_id ) ) != _chain_indexes.end();
 }
 
 void database::create_initial_assets(const genesis_state_type &genesis_state,
@@ -24,6 +24,7 @@
 
 #include <graphene/chain/database.hpp>
 
+#include <graphene/chain/binary_snapshot.hpp>
 #include <graphene/chain/chain_property_object.hpp>
 #include <graphene/chain/witness_schedule_object.hpp>
 #include <graphene/chain/special_authority_object.hpp>
@@ -33,15 +34,114 @@
 #include <graphene/protocol/operations_permissions.hpp>
 
 #include <fc/io/fstream.hpp>
+#include <fc/io/raw.hpp>
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <functional>
+#include <future>
 #include <iostream>
-#include <queue>
-#include <tuple>
+#include <mutex>
+#include <thread>
 
 namespace graphene { namespace chain {
 
+namespace {
+   /**
+    * Holds at most a fixed number of items between two stages of the replay pipeline. push() waits
+    * while the queue is full, pop() while it is empty.
+    */
+   template<typename T>
+   class bounded_queue
+   {
+      public:
+         explicit bounded_queue( size_t capacity ) : _capacity( std::max<size_t>( capacity, 1 ) ) {}
+
+         /** @return false if the queue has been cancelled */
+         bool push( T&& item )
+         {
+            std::unique_lock<std::mutex> lock( _mutex );
+            _not_full.wait( lock, [this] { return _cancelled || _items.size() < _capacity; } );
+            if( _cancelled )
+               return false;
+            _items.push_back( std::move(item) );
+            _not_empty.notify_one();
+            return true;
+         }
+
+         /** @return false if the queue has been cancelled, or closed and all items have been popped */
+         bool pop( T& item )
+         {
+            std::unique_lock<std::mutex> lock( _mutex );
+            _not_empty.wait( lock, [this] { return _cancelled || _closed || !_items.empty(); } );
+            if( _cancelled || _items.empty() )
+               return false;
+            item = std::move( _items.front() );
+            _items.pop_front();
+            _not_full.notify_one();
+            return true;
+         }
+
+         /** no more items will be pushed */
+         void close()
+         {
+            std::unique_lock<std::mutex> lock( _mutex );
+            _closed = true;
+            _not_empty.notify_all();
+         }
+
+         /** drops the remaining items and releases all waiting threads */
+         void cancel()
+         {
+            std::unique_lock<std::mutex> lock( _mutex );
+            _cancelled = true;
+            _items.clear();
+            _not_empty.notify_all();
+            _not_full.notify_all();
+         }
+
+      private:
+         const size_t            _capacity;
+         std::deque<T>           _items;
+         bool                    _closed = false;
+         bool                    _cancelled = false;
+         std::mutex              _mutex;
+         std::condition_variable _not_empty;
+         std::condition_variable _not_full;
+   };
+
+   /** a block read by the replay, waiting to be decoded */
+   struct replay_decode_task
+   {
+      block_database::packed_block                        packed;
+      std::promise< std::shared_ptr<const signed_block> > decoded;
+   };
+
+   /** a block read by the replay, waiting to be applied once decoded */
+   struct replay_item
+   {
+      uint32_t                                           block_num = 0;
+      uint64_t                                           end_position = 0;
+      /** the block, nullptr if it is missing or can't be unpacked */
+      std::future< std::shared_ptr<const signed_block> > block;
+   };
+
+   /** time spent by the replay stages in microseconds, the decoding time is summed over all threads */
+   struct replay_stage_times
+   {
+      std::atomic<int64_t>  read{0};
+      std::atomic<int64_t>  decode{0};
+      int64_t               apply = 0;
+      int64_t               wait = 0;
+      std::atomic<uint64_t> blocks_read{0};
+      std::atomic<uint64_t> blocks_decoded{0};
+      /** keeps the page reads of the reader from being optimized away */
+      std::atomic<uint32_t> touched{0};
+   };
+}
+
 database::database()
 {
    initialize_indexes();
@@ -79,28 +179,119 @@ void database::reindex( fc::path data_dir )
       _undo_db.disable();
 
    uint32_t skip = node_properties().skip_flags;
+   // transaction ids are needed near the end anyway, see below
+   const uint32_t precompute_skip = skip & ~skip_transaction_dupe_check;
 
    size_t total_block_size = _block_id_to_block.total_block_size();
    const auto& gpo = get_global_properties();
-   std::queue< std::tuple< size_t, signed_block, fc::future< void > > > blocks;
-   uint32_t next_block_num = head_block_num() + 1;
-   uint32_t i = next_block_num;
-   while( next_block_num <= last_block_num || !blocks.empty() )
-   {
-      if( next_block_num <= last_block_num && blocks.size() < 20 )
+
+   // The replay is a pipeline: the reader thread maps the stored blocks in order, the decoding threads
+   // unpack and precompute them, and this thread applies them in order.
+   const uint32_t num_threads = _replay_threads > 0 ? _replay_threads
+                                                    : std::max( 1u, std::thread::hardware_concurrency() );
+   bounded_queue< replay_decode_task > decode_queue( _replay_queue_depth );
+   bounded_queue< replay_item >        apply_queue( _replay_queue_depth );
+   replay_stage_times                  times;
+   std::vector< std::thread >          threads;
+   const auto stop_pipeline = [&decode_queue,&apply_queue,&threads] () {
+      decode_queue.cancel();
+      apply_queue.cancel();
+      for( auto& thread : threads )
+         if( thread.joinable() )
+            thread.join();
+   };
+
+   const uint32_t first_block_num = head_block_num() + 1;
+   threads.emplace_back( [this,&decode_queue,&apply_queue,&times,first_block_num,last_block_num] () {
+      for( uint32_t num = first_block_num; num <= last_block_num; ++num )
       {
-         const size_t processed_block_size = _block_id_to_block.blocks_current_position();
-         fc::optional< signed_block > block = _block_id_to_block.fetch_by_number( next_block_num++ );
-         if( block.valid() )
+         const auto read_start = fc::time_point::now();
+         replay_item item;
+         item.block_num = num;
+         auto packed = _block_id_to_block.fetch_packed_by_number( num );
+         if( !packed.valid() )
          {
-            if( block->timestamp >= last_block->timestamp - gpo.parameters.maximum_time_until_expiration )
-               skip &= ~skip_transaction_dupe_check;
-            blocks.emplace( processed_block_size, std::move(*block), fc::future<void>() );
-            std::get<2>(blocks.back()) = precompute_parallel( std::get<1>(blocks.back()), skip );
+            std::promise< std::shared_ptr<const signed_block> > missing;
+            missing.set_value( nullptr );
+            item.block = missing.get_future();
+            apply_queue.push( std::move(item) );
+            break;
          }
-         else
+         // fault the pages in here, so that the decoding threads don't wait for the disk
+         uint32_t touched = 0;
+         for( uint32_t pos = 0; pos < packed->size; pos += 4096 )
+            touched += packed->data.get()[pos];
+         times.touched += touched;
+
+         item.end_position = packed->end_position;
+         replay_decode_task task;
+         task.packed = std::move( *packed );
+         item.block = task.decoded.get_future();
+         times.read += ( fc::time_point::now() - read_start ).count();
+         ++times.blocks_read;
+         if( !decode_queue.push( std::move(task) ) || !apply_queue.push( std::move(item) ) )
+            return;
+      }
+      decode_queue.close();
+      apply_queue.close();
+   } );
+
+   for( uint32_t t = 0; t < num_threads; ++t )
+      threads.emplace_back( [this,&decode_queue,&times,precompute_skip] () {
+         replay_decode_task task;
+         while( decode_queue.pop( task ) )
+         {
+            const auto decode_start = fc::time_point::now();
+            std::shared_ptr<signed_block> block;
+            try
+            {
+               // a block which can't be unpacked is treated like a missing one, as fetch_by_number() does
+               block = std::make_shared<signed_block>();
+               fc::datastream<const char*> ds( task.packed.data.get(), task.packed.size );
+               fc::raw::unpack( ds, *block );
+               if( block->id() != task.packed.id )
+                  block.reset();
+            }
+            catch( const fc::exception& )
+            {
+               block.reset();
+            }
+            catch( const std::exception& )
+            {
+               block.reset();
+            }
+            try
+            {
+               if( block )
+                  precompute_block( *block, precompute_skip );
+               task.decoded.set_value( block );
+            }
+            catch( ... )
+            {
+               task.decoded.set_exception( std::current_exception() );
+            }
+            times.decode += ( fc::time_point::now() - decode_start ).count();
+            ++times.blocks_decoded;
+         }
+      } );
+
+   // the replayed blocks are not read again, they would only push the blocks readers need out of the cache
+   _block_id_to_block.set_cache_filling( false );
+   try
+   {
+      uint64_t blocks_applied = 0;
+      replay_item item;
+      while( apply_queue.pop( item ) )
+      {
+         const uint32_t i = item.block_num;
+         const auto wait_start = fc::time_point::now();
+         const auto block = item.block.get();
+         const auto apply_start = fc::time_point::now();
+         times.wait += ( apply_start - wait_start ).count();
+         if( !block )
          {
             wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", i) );
+            stop_pipeline();
             uint32_t dropped_count = 0;
             while( true )
             {
@@ -115,29 +306,37 @@ void database::reindex( fc::path data_dir )
                dropped_count++;
             }
             wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
-            next_block_num = last_block_num + 1; // don't load more blocks
+            break;
          }
-      }
-      else
-      {
-         std::get<2>(blocks.front()).wait();
-         const signed_block& block = std::get<1>(blocks.front());
 
          if( i % 10000 == 0 )
          {
             std::stringstream bysize;
             std::stringstream bynum;
-            bysize << std::fixed << std::setprecision(5) << double(std::get<0>(blocks.front())) / total_block_size * 100;
+            bysize << std::fixed << std::setprecision(5) << double(item.end_position) / total_block_size * 100;
             bynum << std::fixed << std::setprecision(5) << double(i*100)/last_block_num;
             ilog(
                "   [by size: ${size}%   ${processed} of ${total}]   [by num: ${num}%   ${i} of ${last}]",
                ("size", bysize.str())
-               ("processed", std::get<0>(blocks.front()))
+               ("processed", item.end_position)
                ("total", total_block_size)
                ("num", bynum.str())
                ("i", i)
                ("last", last_block_num)
             );
+            const auto per_second = []( uint64_t blocks, int64_t microseconds ) {
+               return blocks * 1000000 / std::max<int64_t>( microseconds, 1 );
+            };
+            const int64_t elapsed = ( apply_start - start ).count();
+            ilog(
+               "   [blocks/s read: ${read}   decode: ${decode} on ${threads} threads   apply: ${apply}]   "
+               "[apply waited for blocks ${wait}% of the time]",
+               ("read", per_second( times.blocks_read, times.read ))
+               ("decode", per_second( times.blocks_decoded, times.decode ) * num_threads)
+               ("threads", num_threads)
+               ("apply", per_second( blocks_applied, times.apply ))
+               ("wait", times.wait * 100 / std::max<int64_t>( elapsed, 1 ))
+            );
          }
          if( i == flush_point )
          {
@@ -145,17 +344,27 @@ void database::reindex( fc::path data_dir )
             flush();
             ilog( "Done" );
          }
+         if( block->timestamp >= last_block->timestamp - gpo.parameters.maximum_time_until_expiration )
+            skip &= ~skip_transaction_dupe_check;
          if( i < undo_point )
-            apply_block( block, skip );
+            apply_block( *block, skip );
          else
          {
             _undo_db.enable();
-            push_block( block, skip );
+            push_block( *block, skip );
          }
-         blocks.pop();
-         i++;
+         times.apply += ( fc::time_point::now() - apply_start ).count();
+         ++blocks_applied;
       }
    }
+   catch( ... )
+   {
+      stop_pipeline();
+      _block_id_to_block.set_cache_filling( true );
+      throw;
+   }
+   stop_pipeline();
+   _block_id_to_block.set_cache_filling( true );
    _undo_db.enable();
    auto end = fc::time_point::now();
    ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
@@ -201,10 +410,12 @@ void database::open(
 
       _block_id_to_block.open(data_dir / "database" / "block_num_to_block");
 
-      if( !find(global_property_id_type()) )
+      if( !find(global_property_id_type()) && !_bootstrap_snapshot.valid() )
          init_genesis(genesis_loader());
       else
       {
+         if( !find(global_property_id_type()) )
+            load_bootstrap_snapshot( genesis_loader().compute_chain_id() );
          _p_core_asset_obj = &get( asset_id_type() );
          _p_core_dynamic_data_obj = &get( asset_dynamic_data_id_type() );
          _p_global_prop_obj = &get( global_property_id_type() );
@@ -226,6 +437,26 @@ void database::open(
    FC_CAPTURE_LOG_AND_RETHROW( (data_dir) )
 }
 
+void database::load_bootstrap_snapshot( const chain_id_type& chain_id )
+{ try {
+   const auto header = read_binary_snapshot_header( *_bootstrap_snapshot );
+   FC_ASSERT( header.chain_id == chain_id, "The snapshot is of chain ${s}, not of chain ${c}",
+              ("s", header.chain_id)("c", chain_id) );
+   FC_ASSERT( !_bootstrap_state_hash.valid() || header.state_hash == *_bootstrap_state_hash,
+              "The state hash of the snapshot is ${h}, expected ${e}",
+              ("h", header.state_hash)("e", _bootstrap_state_hash) );
+
+   ilog( "Loading the state at block ${n} from snapshot", ("n", header.block_num) );
+   load_binary_snapshot( *this, *_bootstrap_snapshot );
+   const auto& dgpo = get( dynamic_global_property_id_type() );
+   FC_ASSERT( dgpo.head_block_number == header.block_num && dgpo.head_block_id == header.block_id,
+              "The state in the snapshot is not at block ${n}", ("n", header.block_num) );
+
+   // the blocks after the snapshot are replayed or synced on top of block header.block_num
+   if( header.block.valid() && !_block_id_to_block.contains( header.block_id ) )
+      _block_id_to_block.store( header.block_id, *header.block );
+} FC_CAPTURE_AND_RETHROW( (_bootstrap_snapshot) ) }
+
 void database::close(bool rewind)
 {
    if (!_opened)
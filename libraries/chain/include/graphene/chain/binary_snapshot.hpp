@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2017 Peter Conrad, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/database.hpp>
+
+#include <fc/crypto/sha256.hpp>
+
+namespace graphene { namespace chain {
+
+/**
+ *  A binary snapshot starts with binary_snapshot_magic and a binary_snapshot_header, followed by
+ *  one section per index:
+ *  - a binary_snapshot_index_header,
+ *  - the index as packed by index::pack(), split into chunks of binary_snapshot_chunk_size bytes
+ *    which are zlib compressed and each stored as a packed vector<char>,
+ *  - the sha256 of the uncompressed index.
+ */
+const uint64_t binary_snapshot_magic      = 0x50414e5348504752ULL; // "RGPHSNAP"
+const uint32_t binary_snapshot_version    = 2;
+const size_t   binary_snapshot_chunk_size = 1024 * 1024;
+
+struct binary_snapshot_header
+{
+   uint32_t                version = binary_snapshot_version;
+   chain_id_type           chain_id;
+   /** the last block applied to the state in the snapshot */
+   uint32_t                block_num = 0;
+   block_id_type           block_id;
+   /**
+    *  sha256 of the space id, type id, next id and index::hash() of each chain index in snapshot order,
+    *  which can be compared with the state hash published by a trusted node
+    */
+   fc::sha256              state_hash;
+   /** block block_num, a node starting from the snapshot needs it to link the following blocks */
+   optional<signed_block>  block;
+   uint32_t                index_count = 0;
+};
+
+struct binary_snapshot_index_header
+{
+   uint8_t  space_id = 0;
+   uint8_t  type_id = 0;
+   uint64_t size = 0;
+   uint32_t chunk_count = 0;
+};
+
+/**
+ *  Takes a binary snapshot in two steps: the constructor packs the indexes, the database must not
+ *  change meanwhile. write() compresses and writes them, without accessing the database anymore.
+ */
+class binary_snapshot_writer
+{
+   public:
+      /**
+       *  Packs the chain indexes in parallel, as they were at the oldest block the undo history of @p db
+       *  can return to, i.e. at an irreversible block. The indexes of plugins are not in the snapshot,
+       *  plugins of a node starting from it begin at the snapshot block.
+       */
+      explicit binary_snapshot_writer( const database& db );
+
+      /** Compresses the indexes in parallel and writes them to @p dest in index order */
+      void write( const fc::path& dest )const;
+
+      const binary_snapshot_header& header()const { return _header; }
+
+   private:
+      struct packed_index
+      {
+         uint8_t           space_id;
+         uint8_t           type_id;
+         std::vector<char> data;
+      };
+
+      binary_snapshot_header    _header;
+      std::vector<packed_index> _indexes;
+};
+
+/** @return the header of the binary snapshot @p source, without reading the indexes */
+binary_snapshot_header read_binary_snapshot_header( const fc::path& source );
+
+/**
+ *  Loads the objects of a binary snapshot into the empty chain indexes of @p db, without undo history.
+ *  The loaded indexes must match the state hash of the snapshot.
+ *  @return the header of the snapshot
+ */
+binary_snapshot_header load_binary_snapshot( database& db, const fc::path& source );
+
+} } //graphene::chain
+
+FC_REFLECT( graphene::chain::binary_snapshot_header,
+            (version)(chain_id)(block_num)(block_id)(state_hash)(block)(index_count) )
+FC_REFLECT( graphene::chain::binary_snapshot_index_header, (space_id)(type_id)(size)(chunk_count) )
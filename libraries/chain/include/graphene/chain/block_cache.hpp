@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2019 01 People, s.r.o. (01 CryptoHouse).
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/protocol/block.hpp>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace graphene { namespace chain {
+   using namespace graphene::protocol;
+
+   struct block_cache_stats
+   {
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t entries = 0;
+      /** packed size of the cached blocks */
+      uint64_t size = 0;
+      uint64_t capacity = 0;
+   };
+
+   /**
+    * @brief A thread-safe LRU cache of decoded blocks, keyed by block number.
+    *
+    * The cache is bounded by the packed size of the blocks it holds. Entries are handed out as
+    * shared pointers, so a block evicted or invalidated while a reader still uses it stays alive.
+    */
+   class block_cache
+   {
+      public:
+         static const uint64_t default_capacity = 64 * 1024 * 1024;
+
+         /** Sets the maximum packed size of the cached blocks, 0 disables the cache. */
+         void set_capacity( uint64_t capacity );
+
+         /** @return the cached block @p block_num if it has the id @p id, or an empty pointer */
+         std::shared_ptr<const signed_block> get( uint32_t block_num, const block_id_type& id )const;
+         void put( uint32_t block_num, const std::shared_ptr<const signed_block>& block, const block_id_type& id,
+                   uint64_t packed_size );
+         void invalidate( uint32_t block_num );
+         void clear();
+
+         block_cache_stats get_stats()const;
+
+      private:
+         struct entry
+         {
+            uint32_t                            block_num;
+            block_id_type                       id;
+            std::shared_ptr<const signed_block> block;
+            uint64_t                            size;
+         };
+         typedef std::list<entry> entry_list;
+
+         void erase( entry_list::iterator itr );
+
+         mutable std::mutex                                        _mutex;
+         /** most recently used first, mutable because lookups reorder it */
+         mutable entry_list                                        _entries;
+         std::unordered_map<uint32_t, entry_list::iterator>        _by_num;
+         uint64_t                                                  _size = 0;
+         uint64_t                                                  _capacity = default_capacity;
+         mutable uint64_t                                          _hits = 0;
+         mutable uint64_t                                          _misses = 0;
+   };
+
+} }
+
+FC_REFLECT( graphene::chain::block_cache_stats, (hits)(misses)(entries)(size)(capacity) )
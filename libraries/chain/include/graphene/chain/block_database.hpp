@@ -22,18 +22,43 @@
  * THE SOFTWARE.
  */
 #pragma once
-#include <fstream>
 #include <graphene/protocol/block.hpp>
+#include <graphene/chain/block_cache.hpp>
+#include <graphene/chain/mapped_file.hpp>
 
 #include <fc/filesystem.hpp>
 
 namespace graphene { namespace chain {
    struct index_entry;
+   struct header_entry;
    using namespace graphene::protocol;
 
+   /**
+    * Stores the irreversible blocks in an append-only "blocks" file, indexed by block number through
+    * the fixed-size entries of the "index" file. Both files are read through memory mappings, so
+    * concurrent readers (API threads, p2p) don't serialize on shared stream state.
+    *
+    * The "headers" sidecar keeps a fixed-size entry with the timestamp and the packed header of
+    * every block, so header and timestamp lookups read a few dozen bytes instead of a whole block.
+    * It also points into the "op_offsets" file, which holds the position of every operation and
+    * operation result inside the packed block, so a single operation can be unpacked on its own.
+    *
+    * Decoded blocks are kept in a block_cache shared by all readers, so hot blocks are unpacked once.
+    */
    class block_database 
    {
       public:
+         /** a stored block as it is in the blocks file */
+         struct packed_block
+         {
+            block_id_type               id;
+            /** the packed block, mapped from the file */
+            std::shared_ptr<const char> data;
+            uint32_t                    size = 0;
+            /** end of the block in the blocks file */
+            uint64_t                    end_position = 0;
+         };
+
          void open( const fc::path& dbdir );
          bool is_open()const;
          void flush();
@@ -46,14 +71,59 @@ namespace graphene { namespace chain {
          block_id_type          fetch_block_id( uint32_t block_num )const;
          optional<signed_block> fetch_optional( const block_id_type& id )const;
          optional<signed_block> fetch_by_number( uint32_t block_num )const;
+         /** Like fetch_optional() and fetch_by_number(), but share the decoded block instead of copying it. */
+         std::shared_ptr<const signed_block> fetch_shared( const block_id_type& id )const;
+         std::shared_ptr<const signed_block> fetch_shared_by_number( uint32_t block_num )const;
+         /**
+          * Maps a stored block without decoding it or going through the block cache, for sequential readers
+          * which decode on other threads, like replay.
+          */
+         optional<packed_block> fetch_packed_by_number( uint32_t block_num )const;
+         optional<signed_block_header> fetch_block_header( uint32_t block_num )const;
+         optional<time_point_sec>      fetch_block_time( uint32_t block_num )const;
+         /**
+          * Unpacks a single operation, and optionally its result, of a stored block.
+          * @return false if the block or the operation does not exist
+          */
+         bool fetch_operation( uint32_t block_num, uint16_t trx_in_block, uint16_t op_in_trx,
+                               operation& op, operation_result* result = nullptr )const;
          optional<signed_block> last()const;
          optional<block_id_type> last_id()const;
+         /**
+          * @return the number of the first block stored, 0 if there is none. The blocks are stored without gaps
+          * up to the last one, but a node started from a snapshot has none before the snapshot block.
+          */
+         uint32_t               first_block_num()const;
+         /** @return the end of the last block stored */
          size_t                 blocks_current_position()const;
          size_t                 total_block_size()const;
+
+         /** Sets the maximum packed size of the blocks kept in the decoded block cache, 0 disables it. */
+         void                   set_cache_capacity( uint64_t capacity );
+         /** Stops adding decoded blocks to the cache, e.g. while replaying blocks which are not read again. */
+         void                   set_cache_filling( bool enabled );
+         void                   invalidate_cached_block( uint32_t block_num );
+         block_cache_stats      get_cache_stats()const;
       private:
-         optional<index_entry> last_index_entry()const;
-         fc::path _index_filename;
-         mutable std::fstream _blocks;
-         mutable std::fstream _block_num_to_pos;
+         optional<index_entry>  last_index_entry()const;
+         /** @return true if @p e refers to a block which is stored and can be read */
+         bool                   is_valid_entry( const index_entry& e )const;
+         /** Drops the index entries (and their headers) after the last one with a readable block, only while opening. */
+         void                   truncate_invalid_tail();
+         bool                   read_index_entry( uint32_t block_num, index_entry& e )const;
+         std::shared_ptr<const signed_block> read_block( const index_entry& e )const;
+         void                   store_operation_offsets( const signed_block& b, header_entry& h );
+
+         mapped_file _blocks;
+         mapped_file _headers;
+         mapped_file _op_offsets;
+         mutable block_cache _cache;
+         std::atomic<bool>   _fill_cache{true};
+         mapped_file _block_num_to_pos;
+         /**
+          * end of the last block stored, only written by the writer; readers report their own progress
+          * through packed_block::end_position instead of sharing this
+          */
+         std::atomic<uint64_t> _current_position{0};
    };
 } }
@@ -33,6 +33,7 @@
 #include <graphene/chain/block_database.hpp>
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/chain/evaluator.hpp>
+#include <graphene/chain/pending_transaction_pool.hpp>
 #include <graphene/protocol/operations_permissions.hpp>
 
 #include <graphene/db/object_database.hpp>
@@ -42,7 +43,12 @@
 
 #include <fc/log/logger.hpp>
 
+#include <atomic>
 #include <map>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <thread>
 
 namespace graphene { namespace chain {
    using graphene::db::abstract_object;
@@ -62,6 +68,8 @@ namespace graphene { namespace chain {
    struct budget_record;
    enum class vesting_balance_type;
 
+   namespace detail { struct pending_transactions_restorer; }
+
    /**
     *   @class database
     *   @brief tracks the blockchain state in an extensible manner
@@ -123,6 +131,34 @@ namespace graphene { namespace chain {
          void wipe(const fc::path& data_dir, bool include_blocks);
          void close(bool rewind = true);
 
+         /**
+          * Every @p blocks blocks, the objects changed since the last checkpoint are written to disk in the
+          * background, as of the last state which cannot be undone any more. After a crash, open() replays
+          * only the blocks after that. 0 disables checkpoints.
+          */
+         void set_db_checkpoint_interval( uint32_t blocks ) { _db_checkpoint_interval = blocks; }
+         uint32_t get_db_checkpoint_interval()const { return _db_checkpoint_interval; }
+
+         /**
+          * When open() finds no object database, the state is loaded from the binary snapshot @p snapshot
+          * instead of the genesis state, and only the blocks after the snapshot are replayed or synced.
+          * The snapshot must be of the chain given by the genesis state and, if @p expected_state_hash is
+          * set, must have that state hash.
+          */
+         void set_bootstrap_snapshot( const fc::path& snapshot, const optional<fc::sha256>& expected_state_hash )
+         {
+            _bootstrap_snapshot = snapshot;
+            _bootstrap_state_hash = expected_state_hash;
+         }
+
+         /**
+          * reindex() is a pipeline: blocks are read in order, decoded and precomputed by several threads,
+          * then applied in order. These set the maximum number of blocks waiting between two stages, and
+          * the number of decoding threads (0 for one per core).
+          */
+         void set_replay_queue_depth( uint32_t blocks ) { _replay_queue_depth = blocks; }
+         void set_replay_threads( uint32_t threads ) { _replay_threads = threads; }
+
          //////////////////// db_block.cpp ////////////////////
 
          /**
@@ -134,6 +170,29 @@ namespace graphene { namespace chain {
          block_id_type              get_block_id_for_num( uint32_t block_num )const;
          optional<signed_block>     fetch_block_by_id( const block_id_type& id )const;
          optional<signed_block>     fetch_block_by_number( uint32_t num )const;
+         /** Like fetch_block_by_id() and fetch_block_by_number(), but share the block instead of copying it. */
+         std::shared_ptr<const signed_block> fetch_shared_block_by_id( const block_id_type& id )const;
+         std::shared_ptr<const signed_block> fetch_shared_block_by_number( uint32_t num )const;
+         optional<signed_block_header> fetch_block_header_by_number( uint32_t num )const;
+         optional<time_point_sec>   fetch_block_time_by_number( uint32_t num )const;
+         /**
+          * @return the number of the first block which can be fetched, a node started from a snapshot has
+          * no block before the snapshot block
+          */
+         uint32_t                   first_block_num()const;
+         /** @return a single operation of a block with its result, without unpacking the whole block */
+         optional<operation_history_object> fetch_block_operation( uint32_t block_num, uint16_t trx_in_block, uint16_t op_in_trx )const;
+         /** Sets the maximum packed size of the irreversible blocks kept decoded in memory, 0 disables the cache. */
+         void                       set_block_cache_capacity( uint64_t capacity );
+         /**
+          * Bounds the pending transactions to @p max_size bytes packed, and to @p max_per_account transactions
+          * of a fee payer, 0 for no limit. A pushed transaction which does not fit evicts the pending transactions
+          * with a lower fee rate once it is applied, or is refused. At the limit of its fee payer, it replaces the
+          * payer's pending transaction with the lowest fee rate, if that is lower than its own.
+          */
+         void                       set_pending_pool_limits( uint64_t max_size, uint32_t max_per_account );
+         block_cache_stats          get_block_cache_stats()const;
+         pending_pool_stats         get_pending_pool_stats()const;
          const signed_transaction&  get_recent_transaction( const transaction_id_type& trx_id )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
@@ -147,6 +206,13 @@ namespace graphene { namespace chain {
          const flat_map<uint32_t,block_id_type> get_checkpoints()const { return _checkpoints; }
          bool before_last_checkpoint()const;
 
+         /**
+          * Locks the database against push_block(), push_transaction(), pop_block() and the other methods
+          * changing it, for API calls reading it from other threads. Writers are given priority: a
+          * waiting writer only waits for the readers already holding the lock.
+          */
+         std::shared_lock<std::shared_timed_mutex> lock_for_reading()const;
+
          bool push_block( const signed_block& b, uint32_t skip = skip_nothing );
          processed_transaction push_transaction( const precomputable_transaction& trx, uint32_t skip = skip_nothing );
          bool _push_block( const signed_block& b );
@@ -195,6 +261,13 @@ namespace graphene { namespace chain {
           */
          fc::signal<void(const signed_block&)>           applied_block;
 
+         /**
+          *  This signal is emitted after the head block has been popped and its changes
+          *  undone, with the number of the new head block. Like applied_block, it is emitted
+          *  while holding the write lock and the callback may not yield.
+          */
+         fc::signal<void(uint32_t)>                      popped_block;
+
          /**
           * This signal is emitted any time a new transaction is added to the pending
           * block state.
@@ -288,6 +361,8 @@ namespace graphene { namespace chain {
          void initialize_evaluators();
          /// Reset the object graph in-memory
          void initialize_indexes();
+         /** @return true if the index is one of the chain, i.e. added by initialize_indexes() and not by a plugin */
+         bool is_chain_index( uint8_t space_id, uint8_t type_id )const;
          void init_genesis(const genesis_state_type& genesis_state = genesis_state_type());
 
          asset_id_type get_asset_id(const string& symbol) const;
@@ -491,6 +566,10 @@ namespace graphene { namespace chain {
    private:
          template<typename Trx>
          void _precompute_parallel( const Trx* trx, const size_t count, const uint32_t skip )const;
+         /** Does the precomputations of precompute_parallel() for a whole block on the calling thread */
+         void precompute_block( const signed_block& block, const uint32_t skip )const;
+         /** Recovers the signature keys of all transactions of @p block in one batch, into the recovered_key_cache */
+         void precompute_signature_keys( const signed_block& block )const;
 
    protected:
          //Mark pop_undo() as protected -- we do not want outside calling pop_undo(); it should call pop_block() instead
@@ -500,12 +579,41 @@ namespace graphene { namespace chain {
          void notify_changed_objects();
 
       private:
+         friend struct detail::pending_transactions_restorer;
+
+         /**
+          * Holds the write lock of the database while it exists. Scopes nested on the thread holding
+          * the lock, like push_block() calling clear_pending(), only count their depth.
+          *
+          * Nothing may yield to other fc tasks while the scope is held: they run on the same thread,
+          * and would be taken for a nested scope.
+          */
+         class write_scope
+         {
+            public:
+               explicit write_scope( database& db );
+               ~write_scope();
+            private:
+               database& _db;
+         };
+
+         mutable std::shared_timed_mutex        _state_mutex;
+         /** held by a writer until it owns _state_mutex, so that new readers queue up behind it */
+         mutable std::mutex                     _state_gate;
+         std::atomic<std::thread::id>           _writer_thread{ std::thread::id() };
+         uint32_t                               _write_depth = 0;
+
          optional<undo_database::session>       _pending_tx_session;
          vector< unique_ptr<op_evaluator> >     _operation_evaluators;
+         /// space and type ids of the indexes added by initialize_indexes()
+         flat_set< std::pair<uint8_t,uint8_t> > _chain_indexes;
 
          template<class Index>
          vector<std::reference_wrapper<const typename Index::object_type>> sort_votable_objects(size_t count)const;
 
+         /// Loads the state from the bootstrap snapshot into the empty object database
+         void load_bootstrap_snapshot( const chain_id_type& chain_id );
+
          //////////////////// db_block.cpp ////////////////////
 
        public:
@@ -514,9 +622,25 @@ namespace graphene { namespace chain {
          processed_transaction apply_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
          operation_result      apply_operation( transaction_evaluation_state& eval_state, const operation& op );
 
+         /**
+          * Must be called by evaluators changing the owner or active authority of @p account, so that the
+          * following transactions of the block being applied have their authorities verified again.
+          */
+         void                  note_authority_change( account_id_type account );
+
       private:
          void                  _apply_block( const signed_block& next_block );
          processed_transaction _apply_transaction( const signed_transaction& trx );
+         /**
+          * Verifies the authorities of the transactions of @p block in parallel, against the state before the
+          * block. The transactions it fails for are verified again, and report the error, when applied.
+          */
+         void                  verify_block_authorities( const signed_block& block );
+         /**
+          * @return true if the authorities of @p trx, the transaction of the block being applied at
+          * _current_trx_in_block, were verified by verify_block_authorities() and have not changed since
+          */
+         bool                  authorities_verified_before_block( const signed_transaction& trx )const;
          void                  _cancel_bids_and_revive_mpa( const asset_object& bitasset, const asset_bitasset_data_object& bad );
 
          ///Steps involved in applying a new block
@@ -524,7 +648,50 @@ namespace graphene { namespace chain {
 
          const witness_object& validate_block_header( uint32_t skip, const signed_block& next_block )const;
          const witness_object& _validate_block_header( const signed_block& next_block )const;
+         /** Prepares applying the transactions of block @p next_block_num on top of the head block */
+         void start_block( uint32_t next_block_num );
+         /**
+          * Applies the block-level changes which follow the transactions of @p next_block, like the maintenance
+          * and the expirations, then notifies the observers of the block
+          */
+         void finish_block( const signed_block& next_block, const witness_object& signing_witness, bool maint_needed );
+
+         /**
+          * Pushes the popped transactions and then @p transactions, the pending transactions from before the
+          * head block changed from @p previous_head. A pending transaction is kept as it was applied before,
+          * by copying back the changes in its footprint, unless the block or the transactions applied again
+          * before it changed anything it read or changed, or it expired. The block-wide parameters and core
+          * asset are not read by id, so every transaction is applied again when they change.
+          */
+         void restore_pending_transactions( vector<processed_transaction>&& transactions,
+                                            vector<pending_transaction_footprint>&& footprints,
+                                            const std::set<transaction_id_type>& evicted,
+                                            const block_id_type& previous_head );
+         /** @return the footprint of the transaction just applied in the undo session on top */
+         pending_transaction_footprint record_pending_footprint( const db::read_set& reads );
+         /** Adds @p trx to the pending state by copying back the changes in @p footprint, which is moved from */
+         void keep_pending_transaction( const processed_transaction& trx, pending_transaction_footprint& footprint );
+         /** @return the rank of @p trx in the pending pool, at the current core exchange rates */
+         pending_transaction_rank rank_pending_transaction( const transaction& trx )const;
+         /** Adds the rank of @p trx, just appended to _pending_tx, to the pool */
+         void note_pending_transaction( const processed_transaction& trx );
+         /**
+          * @return the positions of the pending transactions to evict so that @p trx fits in the pool: the one of
+          * its fee payer with the lowest fee rate if the payer is at its limit, then the ones with the lowest fee
+          * rates. Each has a lower fee rate than @p trx, throws if there are not enough of them.
+          */
+         vector<size_t> pending_transactions_to_evict( const transaction& trx );
+         /** Removes the pending transaction at @p position from the pool, its changes stay until the state is rebuilt */
+         void evict_pending_transaction( size_t position );
+         /**
+          * @return the positions of @p transactions, but the @p evicted ones, in the order to put them in a block:
+          * the fee payers take turns by the fee rate of their next transaction, and on equal fee rates the ones
+          * which had fewer turns go first. The transactions of a fee payer stay in the order they were pushed.
+          */
+         vector<size_t> pending_block_order( const vector<processed_transaction>& transactions,
+                                             const std::set<transaction_id_type>& evicted )const;
          void create_block_summary(const signed_block& next_block);
+         void write_db_checkpoint();
 
          //////////////////// db_witness_schedule.cpp ////////////////////
 
@@ -566,6 +733,21 @@ namespace graphene { namespace chain {
          ///@}
 
          vector< processed_transaction >        _pending_tx;
+         /** what each transaction of _pending_tx read and changed, at the same position */
+         vector< pending_transaction_footprint > _pending_tx_footprints;
+         /** the rank of each transaction of _pending_tx, at the same position */
+         vector< pending_transaction_rank >     _pending_tx_ranks;
+         /** the positions in _pending_tx of the transactions not evicted, by increasing fee rate */
+         std::multimap< uint64_t, size_t >      _pending_tx_by_fee_rate;
+         /** the number of transactions not evicted of each fee payer */
+         std::map< account_id_type, uint32_t >  _pending_tx_per_account;
+         /** packed size of the transactions not evicted */
+         uint64_t                               _pending_tx_size = 0;
+         /** transactions evicted from the pool, dropped with their changes when the pending state is rebuilt */
+         std::set< transaction_id_type >        _evicted_tx;
+         uint64_t                               _pending_pool_max_size = 0;
+         uint32_t                               _pending_pool_max_per_account = 0;
+         pending_pool_stats                     _pending_pool_stats;
          fork_database                          _fork_db;
 
          /**
@@ -592,6 +774,18 @@ namespace graphene { namespace chain {
          uint16_t                          _current_op_in_trx    = 0;
          uint32_t                          _current_virtual_op   = 0;
 
+         struct verified_authorities
+         {
+            /// the transaction whose authorities were verified, nullptr if they were not
+            const signed_transaction*      trx = nullptr;
+            /// the accounts whose owner or active authorities were used
+            flat_set<account_id_type>      accounts;
+         };
+         /// Result of verify_block_authorities() for each transaction of the block being applied
+         vector<verified_authorities>      _block_authorities;
+         /// Accounts whose authorities were changed by the transactions of the block applied so far
+         flat_set<account_id_type>         _block_authority_changes;
+
          vector<uint64_t>                  _vote_tally_buffer;
          vector<uint64_t>                  _witness_count_histogram_buffer;
          vector<uint64_t>                  _committee_count_histogram_buffer;
@@ -605,6 +799,18 @@ namespace graphene { namespace chain {
          /// Set it to true to provide accurate data to API clients, set to false to have better performance.
          bool                              _track_standby_votes = true;
 
+         /// Number of blocks between object database checkpoints, 0 if disabled
+         uint32_t                          _db_checkpoint_interval = 0;
+
+         /// Binary snapshot to start from instead of the genesis state, and the state hash it must have
+         optional<fc::path>                _bootstrap_snapshot;
+         optional<fc::sha256>              _bootstrap_state_hash;
+
+         /// Maximum number of blocks between two stages of the replay pipeline
+         uint32_t                          _replay_queue_depth = 256;
+         /// Number of threads decoding blocks during replay, 0 for one per core
+         uint32_t                          _replay_threads = 0;
+
          /**
           * Whether database is successfully opened or not.
           *
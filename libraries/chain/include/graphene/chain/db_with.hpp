@@ -69,39 +69,26 @@ struct skip_flags_restorer
 struct pending_transactions_restorer
 {
    pending_transactions_restorer( database& db, std::vector<processed_transaction>&& pending_transactions )
-      : _db(db), _pending_transactions( std::move(pending_transactions) )
+      : _db(db), _pending_transactions( std::move(pending_transactions) ),
+        _footprints( std::move(db._pending_tx_footprints) ), _evicted( std::move(db._evicted_tx) ),
+        _previous_head( db.head_block_id() )
    {
       _db.clear_pending();
    }
 
    ~pending_transactions_restorer()
    {
-      for( const auto& tx : _db._popped_tx )
-      {
-         try {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               _db._push_transaction( tx );
-            }
-         } catch ( const fc::exception& ) { // ignore invalid transactions
-         }
-      }
-      _db._popped_tx.clear();
-      for( const processed_transaction& tx : _pending_transactions )
-      {
-         try
-         {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               _db._push_transaction( tx );
-            }
-         }
-         catch( const fc::exception& )
-         { // ignore invalid transactions
-         }
-      }
+      _db.restore_pending_transactions( std::move(_pending_transactions), std::move(_footprints), _evicted,
+                                        _previous_head );
    }
 
    database& _db;
    std::vector< processed_transaction > _pending_transactions;
+   /** what the pending transactions read and changed, to keep the ones the new head block does not affect */
+   std::vector< pending_transaction_footprint > _footprints;
+   /** the pending transactions evicted from the pool, which are dropped */
+   std::set< transaction_id_type > _evicted;
+   block_id_type _previous_head;
 };
 
 /**
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2019 01 People, s.r.o. (01 CryptoHouse).
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/filesystem.hpp>
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace graphene { namespace chain {
+
+   /**
+    * @brief A binary file written by a single writer and read through a shared memory mapping.
+    *
+    * Writes go through a file stream and become visible to readers on flush(). Readers never
+    * touch the stream: they access a reference-counted snapshot of the mapping, so concurrent
+    * readers neither share a stream position nor issue syscalls. Only a read past the end of
+    * the current snapshot remaps the file, which is the one place a lock is taken.
+    *
+    * The visible file size is tracked in memory, so bounds checks cost no seek/tell.
+    */
+   class mapped_file
+   {
+      public:
+         void open( const fc::path& p, bool truncate = false );
+         bool is_open()const;
+         void close();
+         /** Publishes all pending writes to readers. */
+         void flush();
+
+         const fc::path& path()const { return _path; }
+         /** @return the number of bytes visible to readers */
+         uint64_t size()const { return _size.load(); }
+
+         /** Writes @p size bytes at the end of the file. @return the offset they were written at */
+         uint64_t append( const char* data, size_t size );
+         /** Writes @p size bytes at @p pos, overwriting or extending the file. */
+         void     write( uint64_t pos, const char* data, size_t size );
+         template<typename T>
+         void     write( uint64_t pos, const T& v ) { write( pos, (const char*)&v, sizeof(v) ); }
+         /**
+          * Truncates (or extends) the file to @p new_size bytes.
+          * @note Must not be called while other threads are reading from the file.
+          */
+         void     resize( uint64_t new_size );
+         /**
+          * Drops the bytes past @p new_size, the following writes overwrite them. Readers may still access
+          * the dropped bytes through their mappings, so the file itself is only shrunk on close().
+          */
+         void     truncate( uint64_t new_size );
+
+         /**
+          * @return a pointer to @p size bytes at offset @p pos which stays valid for as long as
+          * the returned pointer is kept, or an empty pointer if the range is not in the file
+          */
+         std::shared_ptr<const char> map( uint64_t pos, uint64_t size )const;
+         /** Copies @p size bytes at @p pos to @p dst. @return false if the range is not in the file */
+         bool read( uint64_t pos, char* dst, uint64_t size )const;
+         template<typename T>
+         bool read( uint64_t pos, T& v )const { return read( pos, (char*)&v, sizeof(v) ); }
+
+      private:
+         struct snapshot;
+
+         fc::path                                 _path;
+         std::fstream                             _stream;
+         /** the position of the stream, seeking flushes its buffer so sequential writes do not seek */
+         uint64_t                                 _stream_pos = 0;
+         uint64_t                                 _write_size = 0;
+         std::atomic<uint64_t>                    _size{0};
+         mutable std::shared_ptr<const snapshot>  _snapshot;
+         mutable std::mutex                       _remap_mutex;
+   };
+
+} }
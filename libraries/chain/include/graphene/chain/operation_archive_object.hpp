@@ -25,10 +25,15 @@
 
 #include <graphene/protocol/operations.hpp>
 #include <graphene/db/object.hpp> 
-#include <graphene/db/simple_index.hpp>
+#include <graphene/db/generic_index.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
 
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 namespace graphene { namespace chain {
 
 /**
@@ -67,22 +72,87 @@ class operation_archive_object : public abstract_object<operation_archive_object
             uint16_t operation_id = 0;
 };
 
-typedef simple_index<operation_archive_object> operation_archive_index;
+/**
+ * @brief An append-only index storing @ref operation_archive_object s as packed records.
+ *
+ *  There is one operation_archive_object per operation on chain, so instead of keeping
+ *  every one of them as a heap allocated polymorphic object (like the simple_index does),
+ *  only their 12 bytes of payload are kept, in a deque at the position of their instance.
+ *  Object ids are implied by the record positions.
+ *
+ *  Objects are materialized on access:
+ *  - find(), get() and create() return a view, which keeps its address and is updated by modify()
+ *    until its object is removed or release_views() is called,
+ *  - at() returns the object by value and materializes no view.
+ *
+ *  Removing objects from the end of the index (which is what undo does with the objects
+ *  created in an undo session) truncates the records.
+ */
+class operation_archive_index : public graphene::db::index
+{
+   public:
+      typedef operation_archive_object object_type;
+
+      virtual const object&  create( const std::function<void(object&)>& constructor ) override;
+      virtual const object&  insert( object&& obj ) override;
+      virtual void           modify( const object& obj, const std::function<void(object&)>& modify_callback ) override;
+      virtual void           remove( const object& obj ) override;
+      virtual const object*  find( object_id_type id )const override;
+      virtual void           inspect_all_objects( std::function<void(const object&)> inspector )const override;
+      virtual fc::uint128    hash()const override;
+
+      /** @return the object with the given instance by value */
+      operation_archive_object at( uint64_t instance )const;
+      /** @return true if there is an object with the given instance */
+      bool                     contains( uint64_t instance )const;
+      size_t                   size()const { return _records.size(); }
+
+      /**
+       * Drops the views materialized so far. No reference returned by find(), get() or create()
+       * may be held over this call.
+       */
+      void                     release_views()const;
+
+   private:
+      struct record
+      {
+         uint32_t block_num;
+         int32_t  db_index;
+         uint16_t virtual_op;
+         uint16_t operation_id;
+      };
+      static_assert( sizeof(record) == 12, "Unexpected padding of the packed records." );
+      /** operation_id of a removed record which could not be truncated yet */
+      static const uint16_t removed_operation_id = 0xffff;
+
+      static record to_record( const operation_archive_object& obj );
+      static void   from_record( uint64_t instance, const record& r, operation_archive_object& obj );
+      /** stores @p obj at @p instance, growing the records with removed ones up to it */
+      void          store( uint64_t instance, const operation_archive_object& obj );
+      const object& view( uint64_t instance )const;
+
+      std::deque<record> _records;
+      /** views materialized by lookups, guarded by _views_mutex as find() is called by concurrent readers */
+      mutable std::unordered_map<uint64_t, std::unique_ptr<operation_archive_object>> _views;
+      mutable std::mutex _views_mutex;
+};
 
 /**
  * @brief An index relative to a particular account referencing respective @operation_archive_object.
  *
  *  These indices are stored per account in order to speed up inspection of archived operation by account.
+ *  The referenced operation ids themselves are kept on disk by the account_archive plugin, in chunks
+ *  of its account_operation_database. This object only tracks their number and the chunk positions.
  *
  * !!!! NOTE !!!!
  *  Instances of this class shall never be erased from the database.
  *  In order to save memory due to the undo database storing whole
  *  objects in the remembered states, this object stores only the number
  *  of operations indexed at the moment of being stored by the undo db.
- *  Furthermore, the indices present in the @operations vector shall
- *  never be modified and/or removed. Otherwise the undo db could not work.
- *  In particular, the undo db would not restore a removed instance of
- *  this class. The merge function could fail similarly.
+ *  Furthermore, the stored operations shall never be modified and/or
+ *  removed, and the @chunks shall only be expanded. Otherwise the undo db
+ *  could not work. In particular, the undo db would not restore a removed
+ *  instance of this class. The merge function could fail similarly.
  */
 class account_archive_object : public abstract_object<account_archive_object>
 {
@@ -90,23 +160,72 @@ class account_archive_object : public abstract_object<account_archive_object>
       static const uint8_t space_id = implementation_ids;
       static const uint8_t type_id = impl_account_archive_object_type;
 
-      vector<operation_archive_id_type> operations;
+      /** a list of running totals of an asset, kept by the account_archive plugin's account_summary_database */
+      struct summary_list
+      {
+         /** number of running totals stored */
+         uint32_t         num_entries = 0;
+         /** positions of the chunks holding the running totals */
+         vector<uint32_t> chunks;
+         /** the last running totals stored, so the next ones are appended without reading them back */
+         uint64_t         credits = 0;
+         uint64_t         debits = 0;
+         uint64_t         fees = 0;
+
+         /** copies everything but the chunks, which are only expanded */
+         void copy_totals_from(const summary_list& other)
+         {
+            num_entries = other.num_entries;
+            credits = other.credits;
+            debits = other.debits;
+            fees = other.fees;
+         }
+      };
+
+      /** number of operations archived for the account */
+      uint32_t         num_operations = 0;
+      /** positions of the chunks holding the operations in the account_operation_database */
+      vector<uint32_t> chunks;
+      /** running totals of the balance changes per asset, in the same way expanded only */
+      flat_map<asset_id_type, summary_list> summaries;
 
       account_id_type get_owner_account() const;
 
       unique_ptr<object> clone() const
       {
          auto aao = new account_archive_object();
-         aao->id = this->id;
-         aao->operations.emplace_back(operation_archive_id_type(this->operations.size()));
+         copy_counts_to(*aao);
          return unique_ptr<object>(aao);
       }
 
+      object* clone_to(void* memory) const
+      {
+         auto aao = new (memory) account_archive_object();
+         copy_counts_to(*aao);
+         return aao;
+      }
+
       void move_from(object& obj)
       {
-         auto aao = static_cast<account_archive_object&>(obj);
-         auto num = static_cast<object_id_type>(aao.operations[0]);
-         this->operations.erase(this->operations.begin() + num.instance(), this->operations.end());
+         // the chunks are kept to be reused by the operations appended later
+         auto& aao = static_cast<account_archive_object&>(obj);
+         this->num_operations = aao.num_operations;
+         for (auto& s : this->summaries) {
+            const auto& finder = aao.summaries.find(s.first);
+            if (finder != aao.summaries.end())
+               s.second.copy_totals_from(finder->second);
+            else
+               s.second.copy_totals_from(summary_list());
+         }
+      }
+
+   private:
+      void copy_counts_to(account_archive_object& aao) const
+      {
+         aao.id = this->id;
+         aao.num_operations = this->num_operations;
+         for (const auto& s : this->summaries)
+            aao.summaries[s.first].copy_totals_from(s.second);
       }
 };
 
@@ -132,5 +251,7 @@ MAP_OBJECT_ID_TO_TYPE(graphene::chain::account_archive_object)
 FC_REFLECT_TYPENAME( graphene::chain::operation_archive_object )
 FC_REFLECT_TYPENAME( graphene::chain::account_archive_object )
 
+FC_REFLECT( graphene::chain::account_archive_object::summary_list, (num_entries)(chunks)(credits)(debits)(fees) )
+
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::chain::operation_archive_object )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::chain::account_archive_object )
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2019 01 People, s.r.o. (01 CryptoHouse).
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/types.hpp>
+#include <graphene/db/object.hpp>
+
+#include <fc/reflect/reflect.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace graphene { namespace chain {
+   using graphene::db::object;
+   using graphene::db::object_id_type;
+
+   /**
+    * @brief What applying a pending transaction read and changed in the object database
+    *
+    * After a block which changed nothing the transaction depends on, the pending transaction is kept by copying
+    * its changes back instead of applying it again, see database::restore_pending_transactions().
+    */
+   struct pending_transaction_footprint
+   {
+      /** next id of an index before and after the transaction created objects in it */
+      struct next_id_change
+      {
+         object_id_type before;
+         object_id_type after;
+      };
+
+      /** false if the changes could not be recorded, then the transaction is always applied again */
+      bool                                  valid = false;
+      /** the objects looked up by id */
+      std::vector<object_id_type>           read_objects;
+      /** the indexes searched in other ways, as the ids of their instance 0 */
+      std::vector<object_id_type>           read_indexes;
+      /** the objects which existed before and were changed, as they are after the transaction */
+      std::vector< std::unique_ptr<object> > modified;
+      /** the objects created, by increasing id, as they are after the transaction */
+      std::vector< std::unique_ptr<object> > created;
+      std::vector<object_id_type>           removed;
+      std::vector<next_id_change>           next_ids;
+      /** whether the transaction was recorded for the duplicate check, which is done again when it is kept */
+      bool                                  recorded_for_dupe_check = false;
+   };
+
+   /**
+    * @brief What ranks a pending transaction in the pool
+    *
+    * Blocks take the pending transactions by decreasing fee rate, and a full pool evicts the lowest fee rates first.
+    * The transactions of a fee payer are kept in the order they were pushed, see database::pending_block_order().
+    */
+   struct pending_transaction_rank
+   {
+      /** the payer of the fee of the first operation */
+      account_id_type fee_payer;
+      /** the fees of the operations in core asset, at the core exchange rates, per kilobyte of the transaction */
+      uint64_t        fee_rate = 0;
+      /** packed size of the transaction */
+      uint64_t        size = 0;
+   };
+
+   /**
+    * Size of the pending transaction pool and the cost of keeping it over the blocks. After each block, the
+    * transactions which were pending before it are kept as they were, applied again or dropped.
+    */
+   struct pending_pool_stats
+   {
+      /** transactions in the pool, and their packed size */
+      uint64_t pending = 0;
+      uint64_t size = 0;
+
+      /** after the last block */
+      uint64_t last_kept = 0;
+      uint64_t last_reapplied = 0;
+      uint64_t last_dropped = 0;
+      /** microseconds spent on the transactions kept and on the transactions applied again after the last block */
+      uint64_t last_keep_time = 0;
+      uint64_t last_reapply_time = 0;
+
+      /** summed over the blocks since the node started */
+      uint64_t total_kept = 0;
+      uint64_t total_reapplied = 0;
+      uint64_t total_dropped = 0;
+      uint64_t total_keep_time = 0;
+      uint64_t total_reapply_time = 0;
+      /** transactions evicted to make room for transactions with a higher fee rate */
+      uint64_t total_evicted = 0;
+      /** transactions refused because the pool was full or their fee payer had too many pending transactions */
+      uint64_t total_rejected = 0;
+   };
+
+} }
+
+FC_REFLECT( graphene::chain::pending_pool_stats,
+            (pending)(size)
+            (last_kept)(last_reapplied)(last_dropped)(last_keep_time)(last_reapply_time)
+            (total_kept)(total_reapplied)(total_dropped)(total_keep_time)(total_reapply_time)
+            (total_evicted)(total_rejected) )
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2019 01 People, s.r.o. (01 CryptoHouse).
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/mapped_file.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/interprocess/file_mapping.hpp>
+
+#include <cstring>
+
+namespace graphene { namespace chain {
+
+struct mapped_file::snapshot
+{
+   snapshot( const fc::path& p, uint64_t size )
+   : mapping( p.generic_string().c_str(), fc::read_only ),
+     region( mapping, fc::read_only, 0, size ) {}
+
+   const char* data()const { return (const char*)region.get_address(); }
+   uint64_t    size()const { return region.get_size(); }
+
+   fc::file_mapping  mapping;
+   fc::mapped_region region;
+};
+
+void mapped_file::open( const fc::path& p, bool truncate )
+{ try {
+   _path = p;
+   _stream.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+   auto mode = std::fstream::binary | std::fstream::in | std::fstream::out;
+   if( truncate || !fc::exists( p ) )
+      mode |= std::fstream::trunc;
+   _stream.open( p.generic_string().c_str(), mode );
+   _stream_pos = 0;
+
+   _write_size = fc::file_size( p );
+   _size.store( _write_size );
+   std::atomic_store( &_snapshot, std::shared_ptr<const snapshot>() );
+} FC_CAPTURE_AND_RETHROW( (p) ) }
+
+bool mapped_file::is_open()const
+{
+   return _stream.is_open();
+}
+
+void mapped_file::close()
+{
+   std::atomic_store( &_snapshot, std::shared_ptr<const snapshot>() );
+   if( _stream.is_open() )
+   {
+      _stream.close();
+      if( fc::file_size( _path ) > _write_size )
+         fc::resize_file( _path, _write_size );
+   }
+   _write_size = 0;
+   _size.store( 0 );
+}
+
+void mapped_file::flush()
+{
+   _stream.flush();
+   _size.store( _write_size );
+}
+
+uint64_t mapped_file::append( const char* data, size_t size )
+{
+   const uint64_t pos = _write_size;
+   write( pos, data, size );
+   return pos;
+}
+
+void mapped_file::write( uint64_t pos, const char* data, size_t size )
+{
+   if( pos != _stream_pos )
+      _stream.seekp( pos );
+   _stream.write( data, size );
+   _stream_pos = pos + size;
+   _write_size = std::max( _write_size, pos + size );
+}
+
+void mapped_file::resize( uint64_t new_size )
+{
+   _stream.flush();
+   _write_size = new_size;
+   _size.store( new_size );
+   std::atomic_store( &_snapshot, std::shared_ptr<const snapshot>() );
+   fc::resize_file( _path, new_size );
+   // the stream position may be past the end now
+   _stream_pos = uint64_t(-1);
+}
+
+void mapped_file::truncate( uint64_t new_size )
+{
+   FC_ASSERT( new_size <= _write_size, "Cannot truncate ${p} to ${n} bytes, it holds ${s}",
+              ("p", _path)("n", new_size)("s", _write_size) );
+   _write_size = new_size;
+   if( _size.load() > new_size )
+      _size.store( new_size );
+}
+
+std::shared_ptr<const char> mapped_file::map( uint64_t pos, uint64_t size )const
+{
+   if( size == 0 || pos + size > _size.load() )
+      return std::shared_ptr<const char>();
+
+   auto snap = std::atomic_load( &_snapshot );
+   if( !snap || snap->size() < pos + size )
+   {
+      std::lock_guard<std::mutex> guard( _remap_mutex );
+      snap = std::atomic_load( &_snapshot );
+      if( !snap || snap->size() < pos + size )
+      {
+         snap = std::make_shared<const snapshot>( _path, _size.load() );
+         std::atomic_store( &_snapshot, snap );
+      }
+   }
+   // aliasing constructor: the returned pointer keeps the whole snapshot mapped
+   return std::shared_ptr<const char>( snap, snap->data() + pos );
+}
+
+bool mapped_file::read( uint64_t pos, char* dst, uint64_t size )const
+{
+   const auto src = map( pos, size );
+   if( !src )
+      return false;
+   std::memcpy( dst, src.get(), size );
+   return true;
+}
+
+} }
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2019 01 People, s.r.o. (01 CryptoHouse).
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/operation_archive_object.hpp>
+
+namespace graphene { namespace chain {
+
+operation_archive_index::record operation_archive_index::to_record( const operation_archive_object& obj )
+{
+   record r;
+   r.block_num = obj.block_num;
+   r.db_index = obj.db_index; // aliases trx_in_block and op_in_trx
+   r.virtual_op = obj.virtual_op;
+   r.operation_id = obj.operation_id;
+   return r;
+}
+
+void operation_archive_index::from_record( uint64_t instance, const record& r, operation_archive_object& obj )
+{
+   obj.id = object_id_type( operation_archive_object::space_id, operation_archive_object::type_id, instance );
+   obj.block_num = r.block_num;
+   obj.db_index = r.db_index;
+   obj.virtual_op = r.virtual_op;
+   obj.operation_id = r.operation_id;
+}
+
+void operation_archive_index::store( uint64_t instance, const operation_archive_object& obj )
+{
+   record removed = {};
+   removed.operation_id = removed_operation_id;
+   if( instance >= _records.size() ) _records.resize( instance + 1, removed );
+   _records[instance] = to_record( obj );
+}
+
+const object& operation_archive_index::view( uint64_t instance )const
+{
+   std::lock_guard<std::mutex> guard( _views_mutex );
+   auto& materialized = _views[instance];
+   if( !materialized )
+   {
+      materialized.reset( new operation_archive_object() );
+      from_record( instance, _records[instance], *materialized );
+   }
+   return *materialized;
+}
+
+const object& operation_archive_index::create( const std::function<void(object&)>& constructor )
+{
+   const auto id = get_next_id();
+   operation_archive_object obj;
+   obj.id = id;
+   constructor( obj );
+   FC_ASSERT( obj.operation_id != removed_operation_id );
+
+   store( id.instance(), obj );
+   use_next_id();
+   return view( id.instance() );
+}
+
+const object& operation_archive_index::insert( object&& obj )
+{
+   assert( nullptr != dynamic_cast<operation_archive_object*>(&obj) );
+   const auto& o = static_cast<const operation_archive_object&>( obj );
+   const auto instance = o.id.instance();
+   FC_ASSERT( !contains( instance ), "Overwriting insert at ${id}!", ("id",o.id) );
+   FC_ASSERT( o.operation_id != removed_operation_id );
+
+   store( instance, o );
+   return view( instance );
+}
+
+void operation_archive_index::modify( const object& obj, const std::function<void(object&)>& modify_callback )
+{
+   const auto instance = obj.id.instance();
+   FC_ASSERT( contains( instance ) );
+   // modified on a copy, so a throwing callback leaves the record untouched
+   operation_archive_object o;
+   from_record( instance, _records[instance], o );
+   modify_callback( o );
+   FC_ASSERT( o.id == obj.id, "Modification of ID is not supported!" );
+   FC_ASSERT( o.operation_id != removed_operation_id );
+   _records[instance] = to_record( o );
+
+   // a view handed out earlier keeps its address and shows the modification
+   std::lock_guard<std::mutex> guard( _views_mutex );
+   const auto itr = _views.find( instance );
+   if( itr != _views.end() )
+      from_record( instance, _records[instance], *itr->second );
+}
+
+void operation_archive_index::remove( const object& obj )
+{
+   const auto instance = obj.id.instance();
+   FC_ASSERT( contains( instance ) );
+   {
+      std::lock_guard<std::mutex> guard( _views_mutex );
+      _views.erase( instance );
+   }
+   _records[instance].operation_id = removed_operation_id;
+   while( !_records.empty() && _records.back().operation_id == removed_operation_id )
+      _records.pop_back();
+}
+
+void operation_archive_index::release_views()const
+{
+   std::lock_guard<std::mutex> guard( _views_mutex );
+   _views.clear();
+}
+
+bool operation_archive_index::contains( uint64_t instance )const
+{
+   return instance < _records.size() && _records[instance].operation_id != removed_operation_id;
+}
+
+const object* operation_archive_index::find( object_id_type id )const
+{
+   assert( id.space() == operation_archive_object::space_id );
+   assert( id.type() == operation_archive_object::type_id );
+
+   const auto instance = id.instance();
+   if( !contains( instance ) ) return nullptr;
+   return &view( instance );
+}
+
+operation_archive_object operation_archive_index::at( uint64_t instance )const
+{
+   FC_ASSERT( contains( instance ), "Unable to find archived operation ${i}", ("i",instance) );
+   operation_archive_object obj;
+   from_record( instance, _records[instance], obj );
+   return obj;
+}
+
+void operation_archive_index::inspect_all_objects( std::function<void(const object&)> inspector )const
+{
+   try {
+      operation_archive_object obj;
+      for( uint64_t instance = 0; instance < _records.size(); ++instance )
+      {
+         if( _records[instance].operation_id == removed_operation_id )
+            continue;
+         from_record( instance, _records[instance], obj );
+         inspector( obj );
+      }
+   } FC_CAPTURE_AND_RETHROW()
+}
+
+fc::uint128 operation_archive_index::hash()const
+{
+   fc::uint128 result;
+   inspect_all_objects( [&result]( const object& obj ) { result += obj.hash(); } );
+   return result;
+}
+
+} } // graphene::chain
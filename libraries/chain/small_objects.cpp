@@ -150,7 +150,7 @@ FC_REFLECT_DERIVED_NO_TYPENAME(graphene::chain::operation_archive_object, (graph
                    (block_num)(trx_in_block)(op_in_trx)(virtual_op)(operation_id))
 
 FC_REFLECT_DERIVED_NO_TYPENAME(graphene::chain::account_archive_object, (graphene::db::object),
-                   (operations))
+                   (num_operations)(chunks)(summaries))
 
 FC_REFLECT_DERIVED_NO_TYPENAME(
    graphene::chain::special_authority_object,
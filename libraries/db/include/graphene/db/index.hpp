@@ -30,7 +30,10 @@
 #include <fc/crypto/sha256.hpp>
 
 #include <fstream>
+#include <future>
 #include <stack>
+#include <thread>
+#include <unordered_map>
 
 namespace graphene { namespace db {
    class object_database;
@@ -98,6 +101,17 @@ namespace graphene { namespace db {
           */
          virtual void open( const fc::path& db ) = 0;
          virtual void save( const fc::path& db ) = 0;
+         /**
+          *  Loads objects from @p data, in the format written by save() and pack()
+          */
+         virtual void unpack( const char* data, size_t size ) = 0;
+         /**
+          *  Packs the index in the format read by open(), as it was before the changes recorded by
+          *  @p previous, which maps the ids of the changed objects to their previous values
+          *  (nullptr for the objects which did not exist).
+          */
+         virtual std::vector<char> pack( object_id_type next_id,
+                                         const std::unordered_map<object_id_type, const object*>& previous )const = 0;
 
 
 
@@ -343,22 +357,77 @@ namespace graphene { namespace db {
             return fc::sha256::hash(desc);
          }
 
+         /** minimum number of objects decoded by each thread when opening a large index */
+         static const size_t objects_per_load_task = 16384;
+
+         /**
+          * Objects are unpacked straight from the mapped file.
+          */
          virtual void open( const path& db )override
          { 
             if( !fc::exists( db ) ) return;
             fc::file_mapping fm( db.generic_string().c_str(), fc::read_only );
             fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size(db) );
-            fc::datastream<const char*> ds( (const char*)mr.get_address(), mr.get_size() );
+            try {
+               unpack( (const char*)mr.get_address(), mr.get_size() );
+            } FC_CAPTURE_AND_RETHROW( (db) )
+         }
+
+         /**
+          * Large indexes are split into chunks decoded on multiple threads, then inserted into the
+          * index in their packed order.
+          */
+         virtual void unpack( const char* data, size_t data_size )override
+         {
+            fc::datastream<const char*> ds( data, data_size );
             fc::sha256 open_ver;
 
             fc::raw::unpack(ds, _next_id);
             fc::raw::unpack(ds, open_ver);
             FC_ASSERT( open_ver == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
-            vector<char> tmp;
+
+            // locate the packed objects first, each of them is stored as a packed vector<char>
+            vector< std::pair<size_t, uint32_t> > records;
             while( ds.remaining() > 0 )
             {
-               fc::raw::unpack( ds, tmp );
-               load( tmp );
+               fc::unsigned_int size;
+               fc::raw::unpack( ds, size );
+               FC_ASSERT( size.value <= ds.remaining(), "Truncated object" );
+               records.emplace_back( ds.tellp(), size.value );
+               ds.skip( size.value );
+            }
+            if( records.empty() ) return;
+
+            const auto decode = [data,&records]( size_t begin, size_t end ) {
+               vector<object_type> objects( end - begin );
+               for( size_t i = begin; i < end; ++i )
+               {
+                  fc::datastream<const char*> rds( data + records[i].first, records[i].second );
+                  fc::raw::unpack( rds, objects[i - begin] );
+               }
+               return objects;
+            };
+
+            const size_t num_tasks = std::max<size_t>( 1, std::min<size_t>( std::thread::hardware_concurrency(),
+                                                                             records.size() / objects_per_load_task ) );
+            const size_t chunk = ( records.size() + num_tasks - 1 ) / num_tasks;
+            vector< std::future< vector<object_type> > > chunks;
+            chunks.reserve( num_tasks );
+            for( size_t begin = 0; begin < records.size(); begin += chunk )
+               chunks.push_back( std::async( num_tasks > 1 ? std::launch::async : std::launch::deferred,
+                                             decode, begin, std::min( begin + chunk, records.size() ) ) );
+
+            // only the decoding runs in parallel, the objects are inserted and the secondary indexes fed
+            // one after another on this thread, as secondary indexes may depend on each other
+            for( auto& c : chunks )
+            {
+               auto objects = c.get();
+               for( auto& obj : objects )
+               {
+                  const auto& result = DerivedIndex::insert( std::move( obj ) );
+                  for( const auto& item : _sindex )
+                     item->object_inserted( result );
+               }
             }
          }
 
@@ -377,6 +446,49 @@ namespace graphene { namespace db {
             });
          }
 
+         /**
+          * The previous values are applied with move_from() like undo does, because some objects
+          * keep part of their content only in the live instance. Objects removed since are merged
+          * in by id, which is the order the indexes iterate in.
+          */
+         virtual std::vector<char> pack( object_id_type next_id,
+                                         const std::unordered_map<object_id_type, const object*>& previous )const override
+         {
+            vector<const object*> removed;
+            for( const auto& item : previous )
+               if( item.second != nullptr && DerivedIndex::find( item.first ) == nullptr )
+                  removed.push_back( item.second );
+            std::sort( removed.begin(), removed.end(),
+                       []( const object* a, const object* b ) { return a->id < b->id; } );
+
+            vector<char> result = fc::raw::pack( next_id );
+            const auto ver = fc::raw::pack( get_object_version() );
+            result.insert( result.end(), ver.begin(), ver.end() );
+            const auto append = [&result]( const object_type& o ) {
+               const auto packed_vec = fc::raw::pack( fc::raw::pack( o ) );
+               result.insert( result.end(), packed_vec.begin(), packed_vec.end() );
+            };
+
+            auto next_removed = removed.begin();
+            this->inspect_all_objects( [&]( const object& o ) {
+               for( ; next_removed != removed.end() && (*next_removed)->id < o.id; ++next_removed )
+                  append( static_cast<const object_type&>( **next_removed ) );
+               const auto itr = previous.find( o.id );
+               if( itr == previous.end() )
+                  append( static_cast<const object_type&>( o ) );
+               else if( itr->second != nullptr )
+               {
+                  object_type value( static_cast<const object_type&>( o ) );
+                  object_type old( static_cast<const object_type&>( *itr->second ) );
+                  value.move_from( old );
+                  append( value );
+               }
+            });
+            for( ; next_removed != removed.end(); ++next_removed )
+               append( static_cast<const object_type&>( **next_removed ) );
+            return result;
+         }
+
          virtual const object&  load( const std::vector<char>& data )override
          {
             const auto& result = DerivedIndex::insert( fc::raw::unpack<object_type>( data ) );
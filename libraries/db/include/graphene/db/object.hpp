@@ -74,6 +74,9 @@ namespace graphene { namespace db {
 
          /// these methods are implemented for derived classes by inheriting abstract_object<DerivedClass>
          virtual unique_ptr<object> clone()const = 0;
+         /** copy constructs the object into @p memory, which holds object_size() bytes aligned for any type */
+         virtual object*            clone_to( void* memory )const = 0;
+         virtual size_t             object_size()const = 0;
          virtual void               move_from( object& obj ) = 0;
          virtual variant            to_variant()const  = 0;
          virtual vector<char>       pack()const = 0;
@@ -95,6 +98,11 @@ namespace graphene { namespace db {
          {
             return unique_ptr<object>(new DerivedClass( *static_cast<const DerivedClass*>(this) ));
          }
+         virtual object* clone_to( void* memory )const
+         {
+            return new (memory) DerivedClass( *static_cast<const DerivedClass*>(this) );
+         }
+         virtual size_t  object_size()const { return sizeof(DerivedClass); }
 
          virtual void    move_from( object& obj )
          {
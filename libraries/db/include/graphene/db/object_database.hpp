@@ -27,11 +27,26 @@
 #include <graphene/db/undo_database.hpp>
 
 #include <fc/log/logger.hpp>
+#include <fc/thread/future.hpp>
+#include <fc/variant_object.hpp>
 
+#include <future>
 #include <map>
 
 namespace graphene { namespace db {
 
+   /**
+    * @class read_set
+    * @brief what was read from the object databases of a thread while an object_database::read_tracking existed
+    */
+   struct read_set
+   {
+      /** the objects looked up by id */
+      undo_id_set objects;
+      /** the indexes accessed in any other way, as the ids of their instance 0 */
+      undo_id_set indexes;
+   };
+
    /**
     *   @class object_database
     *   @brief maintains a set of indexed objects that can be modified with multi-level rollback support
@@ -53,6 +68,38 @@ namespace graphene { namespace db {
          void wipe(const fc::path& data_dir); // remove from disk
          void close();
 
+         /**
+          * Writes the indexes changed since they were last written, as they were in the oldest state
+          * the undo history can return to. The objects are packed right away, the files are written in
+          * the background and then moved in place together, along with @p info in a manifest. A
+          * checkpoint interrupted after its manifest was written is completed by open(), an earlier
+          * one is discarded.
+          */
+         void checkpoint( const fc::variant_object& info );
+         /** Waits until the last checkpoint is on disk */
+         void wait_for_checkpoint();
+
+         /**
+          * The state the undo history can return to, as far as it differs from the current one
+          */
+         struct oldest_state
+         {
+            /** by index id, the previous values of the changed objects (nullptr for the ones created since) */
+            std::unordered_map< object_id_type, std::unordered_map<object_id_type, const object*> > previous;
+            /** by index id, the next ids of the indexes which created objects since */
+            std::unordered_map< object_id_type, object_id_type >                                     next_ids;
+
+            /** @return @p idx packed as it was in this state, see index::pack() */
+            vector<char> pack( const index& idx )const;
+         };
+         /** Valid until the object_database is changed */
+         oldest_state get_oldest_state()const;
+
+         /** Calls @p inspector with every index */
+         void inspect_all_indexes( const std::function<void(const index&)>& inspector )const;
+         /** Loads objects packed by index::pack() into their index, without undo history or notifications */
+         void unpack_index( uint8_t space_id, uint8_t type_id, const char* data, size_t size );
+
          template<typename T, typename F>
          const T& create( F&& constructor )
          {
@@ -80,6 +127,34 @@ namespace graphene { namespace db {
          const object& get_object( object_id_type id )const;
          const object* find_object( object_id_type id )const;
 
+         /**
+          * Records the objects and indexes read on the current thread into a read_set while it exists. The
+          * previous recording is resumed when it is destroyed, so a nested read_tracking with nullptr stops
+          * the recording, e.g. around a search which the caller records more precisely with note_read().
+          */
+         class read_tracking
+         {
+            public:
+               explicit read_tracking( read_set* reads ) : _previous( _tracked_reads ) { _tracked_reads = reads; }
+               ~read_tracking() { _tracked_reads = _previous; }
+               read_tracking( const read_tracking& ) = delete;
+               read_tracking& operator=( const read_tracking& ) = delete;
+            private:
+               read_set* _previous;
+         };
+         /** Records a read of @p id, if reads are tracked on the current thread */
+         static void note_read( object_id_type id )
+         {
+            if( _tracked_reads != nullptr )
+               _tracked_reads->objects.insert( id );
+         }
+         /** Records a read of the index of objects of type @p space_id, @p type_id, if reads are tracked */
+         static void note_index_read( uint8_t space_id, uint8_t type_id )
+         {
+            if( _tracked_reads != nullptr )
+               _tracked_reads->indexes.insert( object_id_type( space_id, type_id, 0 ) );
+         }
+
          /// These methods are mutators of the object_database. You must use these methods to make changes to the object_database,
          /// in order to maintain proper undo history.
          ///@{
@@ -174,8 +249,19 @@ namespace graphene { namespace db {
          void save_undo_add( const object& obj );
          void save_undo_remove( const object& obj );
 
+         static size_t dirty_slot( object_id_type id ) { return ( size_t(id.space()) << 8 ) | id.type(); }
+         static object_id_type index_id_of( object_id_type id ) { return object_id_type( id.space(), id.type(), 0 ); }
+         void reset_dirty_indexes();
+         /** get_index() without recording a read */
+         const index& lookup_index( uint8_t space_id, uint8_t type_id )const;
+
+         static thread_local read_set*                             _tracked_reads;
+
          fc::path                                                  _data_dir;
          vector< vector< unique_ptr<index> > >                     _index;
+         /** indexes changed since they were last loaded or written, by dirty_slot() */
+         vector<bool>                                              _dirty_indexes = vector<bool>( 1 << 16 );
+         std::future<void>                                         _checkpoint_done;
    };
 
 } } // graphene::db
@@ -23,6 +23,7 @@
  */
 #pragma once
 #include <graphene/db/object.hpp>
+#include <graphene/db/undo_state.hpp>
 #include <deque>
 #include <fc/exception/exception.hpp>
 
@@ -32,15 +33,6 @@ namespace graphene { namespace db {
    using fc::flat_set;
    class object_database;
 
-   struct undo_state
-   {
-      unordered_map<object_id_type, unique_ptr<object> > old_values;
-      unordered_map<object_id_type, object_id_type>      old_index_next_ids;
-      std::unordered_set<object_id_type>                 new_ids;
-      unordered_map<object_id_type, unique_ptr<object> > removed;
-   };
-
-
    /**
     * @class undo_database
     * @brief tracks changes to the state and allows changes to be undone
@@ -49,7 +41,7 @@ namespace graphene { namespace db {
    class undo_database
    {
       public:
-         undo_database( object_database& db ):_db(db){}
+         undo_database( object_database& db ):_db(db){ _spare_states.reserve( max_spare_states ); }
 
          class session
          {
@@ -122,15 +114,27 @@ namespace graphene { namespace db {
          uint32_t active_sessions()const { return _active_sessions; }
 
          const undo_state& head()const;
+         /** @return the undo states, oldest first */
+         const std::deque<undo_state>& states()const { return _stack; }
 
       private:
          void undo();
          void merge();
          void commit();
 
+         /** @return a new state on top of the stack, recycled if possible */
+         undo_state& push_state();
+         void        pop_back_state();
+         void        pop_front_state();
+         void        recycle( undo_state&& state );
+
+         /** number of emptied states kept for reuse, enough for the nesting of block, transaction and proposal sessions */
+         static const size_t max_spare_states = 8;
+
          uint32_t                _active_sessions = 0;
          bool                    _disabled = true;
          std::deque<undo_state>  _stack;
+         std::vector<undo_state> _spare_states;
          object_database&        _db;
          size_t                  _max_size = 256;
    };
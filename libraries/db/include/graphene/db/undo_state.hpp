@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/db/object.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   /**
+    * @class undo_arena
+    * @brief memory for the objects saved by an undo_state
+    *
+    * Memory is handed out in sequence from chunks and only released all at once. reset() keeps the
+    * first chunk, so a recycled undo_state saves its first objects without allocating.
+    */
+   class undo_arena
+   {
+      public:
+         static const size_t chunk_size = 16 * 1024;
+
+         /** @return @p size bytes aligned for any type */
+         void* allocate( size_t size );
+         /** takes over the chunks of @p other, the memory handed out from them stays valid */
+         void  take( undo_arena& other );
+         /** releases all memory but the first chunk */
+         void  reset();
+
+      private:
+         struct chunk
+         {
+            std::unique_ptr<char[]> data;
+            size_t                  size;
+         };
+         std::vector<chunk> _chunks;
+         /** bytes handed out from the last chunk */
+         size_t             _used = 0;
+   };
+
+   /**
+    * @class undo_id_map
+    * @brief a hash map from object ids, for the entries of an undo_state
+    *
+    * The entries are kept in a single table with open addressing and linear probing, so inserting
+    * only allocates when the table grows. clear() keeps the table unless it grew large.
+    * Iterators are invalidated by inserting and erasing.
+    */
+   template<typename Value>
+   class undo_id_map
+   {
+      public:
+         struct value_type
+         {
+            object_id_type first;
+            Value          second;
+         };
+
+         template<typename Entry>
+         class basic_iterator
+         {
+            public:
+               basic_iterator( Entry* pos, Entry* end ) : _pos(pos), _end(end) { skip_empty(); }
+
+               Entry& operator*()const  { return *_pos; }
+               Entry* operator->()const { return _pos; }
+               basic_iterator& operator++() { ++_pos; skip_empty(); return *this; }
+               bool operator==( const basic_iterator& other )const { return _pos == other._pos; }
+               bool operator!=( const basic_iterator& other )const { return _pos != other._pos; }
+
+            private:
+               void skip_empty() { while( _pos != _end && is_empty( *_pos ) ) ++_pos; }
+
+               Entry* _pos;
+               Entry* _end;
+         };
+         typedef basic_iterator<value_type>       iterator;
+         typedef basic_iterator<const value_type> const_iterator;
+
+         undo_id_map() = default;
+         undo_id_map( undo_id_map&& other ) : _table( std::move(other._table) ), _size( other._size )
+         {
+            other._table.clear();
+            other._size = 0;
+         }
+         undo_id_map( const undo_id_map& ) = delete;
+         undo_id_map& operator=( const undo_id_map& ) = delete;
+
+         size_t size()const  { return _size; }
+         bool   empty()const { return _size == 0; }
+
+         iterator       begin()       { return iterator( _table.data(), _table.data() + _table.size() ); }
+         iterator       end()         { return iterator( _table.data() + _table.size(), _table.data() + _table.size() ); }
+         const_iterator begin()const  { return const_iterator( _table.data(), _table.data() + _table.size() ); }
+         const_iterator end()const    { return const_iterator( _table.data() + _table.size(), _table.data() + _table.size() ); }
+
+         iterator find( object_id_type id )
+         {
+            const size_t slot = find_slot( id );
+            return slot == npos ? end() : iterator( _table.data() + slot, _table.data() + _table.size() );
+         }
+         const_iterator find( object_id_type id )const
+         {
+            const size_t slot = find_slot( id );
+            return slot == npos ? end() : const_iterator( _table.data() + slot, _table.data() + _table.size() );
+         }
+         size_t count( object_id_type id )const { return find_slot( id ) == npos ? 0 : 1; }
+
+         /** @return the value of @p id, inserting a value-initialized one if there was none */
+         Value& operator[]( object_id_type id )
+         {
+            FC_ASSERT( id.number != empty_key, "Invalid object id" );
+            if( ( _size + 1 ) * 4 > _table.size() * 3 )
+               rehash( _table.empty() ? min_table_size : _table.size() * 2 );
+            value_type& entry = _table[insert_slot( id )];
+            if( is_empty( entry ) )
+            {
+               entry.first = id;
+               entry.second = Value();
+               ++_size;
+            }
+            return entry.second;
+         }
+
+         /** @return the number of entries erased */
+         size_t erase( object_id_type id )
+         {
+            size_t hole = find_slot( id );
+            if( hole == npos )
+               return 0;
+            // backward shift deletion, moves up the following entries which would not be found past the hole
+            const size_t mask = _table.size() - 1;
+            for( size_t next = ( hole + 1 ) & mask; !is_empty( _table[next] ); next = ( next + 1 ) & mask )
+            {
+               const size_t home = slot_of( _table[next].first );
+               const bool reachable = hole <= next ? ( hole < home && home <= next ) : ( hole < home || home <= next );
+               if( reachable )
+                  continue;
+               _table[hole] = _table[next];
+               hole = next;
+            }
+            _table[hole].first.number = empty_key;
+            --_size;
+            return 1;
+         }
+
+         void clear()
+         {
+            if( _table.size() > max_kept_table_size )
+               std::vector<value_type>().swap( _table );
+            else if( _size > 0 )
+               for( auto& entry : _table )
+                  entry.first.number = empty_key;
+            _size = 0;
+         }
+
+      private:
+         static const size_t   npos                = size_t(-1);
+         static const uint64_t empty_key           = uint64_t(-1);
+         static const size_t   min_table_size      = 16;
+         static const size_t   max_kept_table_size = 4096;
+
+         static bool is_empty( const value_type& entry ) { return entry.first.number == empty_key; }
+
+         size_t slot_of( object_id_type id )const
+         {
+            return size_t( ( id.number * 0x9E3779B97F4A7C15ULL ) >> 32 ) & ( _table.size() - 1 );
+         }
+
+         /** @return the slot holding @p id, or the empty slot where it would be inserted, the table must not be empty */
+         size_t insert_slot( object_id_type id )const
+         {
+            const size_t mask = _table.size() - 1;
+            size_t slot = slot_of( id );
+            while( !is_empty( _table[slot] ) && _table[slot].first != id )
+               slot = ( slot + 1 ) & mask;
+            return slot;
+         }
+
+         /** @return the slot holding @p id, or npos */
+         size_t find_slot( object_id_type id )const
+         {
+            if( _size == 0 )
+               return npos;
+            const size_t slot = insert_slot( id );
+            return is_empty( _table[slot] ) ? npos : slot;
+         }
+
+         void rehash( size_t new_size )
+         {
+            std::vector<value_type> old( new_size );
+            old.swap( _table );
+            for( auto& entry : _table )
+               entry.first.number = empty_key;
+            _size = 0;
+            for( const auto& entry : old )
+               if( !is_empty( entry ) )
+                  (*this)[entry.first] = entry.second;
+         }
+
+         std::vector<value_type> _table;
+         size_t                  _size = 0;
+   };
+
+   /**
+    * @class undo_id_set
+    * @brief a set of object ids in the table of an undo_id_map
+    */
+   class undo_id_set
+   {
+      private:
+         struct none {};
+         typedef undo_id_map<none> map_type;
+
+      public:
+         class const_iterator
+         {
+            public:
+               explicit const_iterator( map_type::const_iterator itr ) : _itr( itr ) {}
+
+               const object_id_type& operator*()const  { return _itr->first; }
+               const object_id_type* operator->()const { return &_itr->first; }
+               const_iterator& operator++() { ++_itr; return *this; }
+               bool operator==( const const_iterator& other )const { return _itr == other._itr; }
+               bool operator!=( const const_iterator& other )const { return _itr != other._itr; }
+
+            private:
+               map_type::const_iterator _itr;
+         };
+         typedef const_iterator iterator;
+
+         size_t size()const  { return _ids.size(); }
+         bool   empty()const { return _ids.empty(); }
+
+         const_iterator begin()const { return const_iterator( _ids.begin() ); }
+         const_iterator end()const   { return const_iterator( _ids.end() ); }
+         const_iterator find( object_id_type id )const { return const_iterator( _ids.find( id ) ); }
+         size_t count( object_id_type id )const { return _ids.count( id ); }
+
+         void   insert( object_id_type id ) { _ids[id]; }
+         size_t erase( object_id_type id )  { return _ids.erase( id ); }
+         void   clear()                     { _ids.clear(); }
+
+      private:
+         map_type _ids;
+   };
+
+   /**
+    * @class undo_state
+    * @brief the changes made to the object database during one undo session
+    *
+    * The previous values of the changed and removed objects are copied into the arena of the state.
+    * The undo_database recycles states, so that a session touching a few objects does not allocate
+    * (other than the copies of the objects do for their own members).
+    */
+   struct undo_state
+   {
+      undo_id_map< object* >        old_values;
+      undo_id_map< object_id_type > old_index_next_ids;
+      undo_id_set                   new_ids;
+      undo_id_map< object* >        removed;
+      /** holds the objects referenced by old_values and removed */
+      undo_arena                    arena;
+
+      undo_state() = default;
+      undo_state( undo_state&& ) = default;
+      undo_state( const undo_state& ) = delete;
+      undo_state& operator=( const undo_state& ) = delete;
+      ~undo_state() { clear(); }
+
+      /** @return a copy of @p obj in the arena */
+      object* save( const object& obj ) { return obj.clone_to( arena.allocate( obj.object_size() ) ); }
+      /** destroys a saved object, nullptr is ignored */
+      static void discard( object* obj ) { if( obj != nullptr ) obj->~object(); }
+
+      /** destroys the saved objects and empties the state */
+      void clear();
+   };
+
+} } // graphene::db
@@ -23,13 +23,47 @@
  */
 #include <graphene/db/object_database.hpp>
 
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/container/flat.hpp>
 #include <fc/thread/parallel.hpp>
 #include <fc/uint128.hpp>
 
+#include <fstream>
+#include <future>
+
 namespace graphene { namespace db {
 
+namespace {
+   /**
+    * Moves the files of a checkpoint in place if its manifest has been written, i.e. if all of them are
+    * complete. Renaming is idempotent, so this also completes a checkpoint interrupted while doing so.
+    */
+   void finish_checkpoint( const fc::path& dir )
+   {
+      const fc::path manifest = dir / "checkpoint";
+      if( !fc::exists( manifest ) )
+         return;
+      std::string content;
+      fc::read_file_contents( manifest, content );
+      const auto files = fc::json::from_string( content ).get_object()["files"].as< vector<std::string> >( 2 );
+      for( const auto& file : files )
+         if( fc::exists( dir / ( file + ".tmp" ) ) )
+            fc::rename( dir / ( file + ".tmp" ), dir / file );
+      fc::remove( manifest );
+   }
+
+   void write_file( const fc::path& file, const vector<char>& data )
+   {
+      std::ofstream out( file.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+      FC_ASSERT( out, "Unable to create ${f}", ("f", file) );
+      out.write( data.data(), data.size() );
+      out.close();
+      FC_ASSERT( out, "Unable to write ${f}", ("f", file) );
+   }
+}
+
 object_database::object_database()
 :_undo_db(*this)
 {
@@ -37,22 +71,36 @@ object_database::object_database()
    _undo_db.enable();
 }
 
-object_database::~object_database(){}
+object_database::~object_database()
+{
+   wait_for_checkpoint();
+}
 
 void object_database::close()
 {
+   wait_for_checkpoint();
 }
 
+thread_local read_set* object_database::_tracked_reads = nullptr;
+
 const object* object_database::find_object( object_id_type id )const
 {
-   return get_index(id.space(),id.type()).find( id );
+   note_read( id );
+   return lookup_index( id.space(), id.type() ).find( id );
 }
 const object& object_database::get_object( object_id_type id )const
 {
-   return get_index(id.space(),id.type()).get( id );
+   note_read( id );
+   return lookup_index( id.space(), id.type() ).get( id );
 }
 
 const index& object_database::get_index(uint8_t space_id, uint8_t type_id)const
+{
+   const index& result = lookup_index( space_id, type_id );
+   note_index_read( space_id, type_id );
+   return result;
+}
+const index& object_database::lookup_index(uint8_t space_id, uint8_t type_id)const
 {
    FC_ASSERT( _index.size() > space_id, "", ("space_id",space_id)("type_id",type_id)("index.size",_index.size()) );
    FC_ASSERT( _index[space_id].size() > type_id, "", ("space_id",space_id)("type_id",type_id)("index[space_id].size",_index[space_id].size()) );
@@ -72,6 +120,7 @@ index& object_database::get_mutable_index(uint8_t space_id, uint8_t type_id)
 void object_database::flush()
 {
 //   ilog("Save object_database in ${d}", ("d", _data_dir));
+   wait_for_checkpoint();
    fc::create_directories( _data_dir / "object_database.tmp" / "lock" );
    std::vector<fc::future<void>> tasks;
    tasks.reserve(200);
@@ -92,6 +141,124 @@ void object_database::flush()
       fc::rename( _data_dir / "object_database", _data_dir / "object_database.old" );
    fc::rename( _data_dir / "object_database.tmp", _data_dir / "object_database" );
    fc::remove_all( _data_dir / "object_database.old" );
+   reset_dirty_indexes();
+}
+
+object_database::oldest_state object_database::get_oldest_state()const
+{
+   // the values the undo history would restore, walking from the newest to the oldest state
+   oldest_state result;
+   const auto& states = _undo_db.states();
+   for( auto state = states.rbegin(); state != states.rend(); ++state )
+   {
+      for( const auto& item : state->old_values )
+         result.previous[index_id_of(item.first)][item.first] = item.second;
+      for( const auto& item : state->removed )
+         result.previous[index_id_of(item.first)][item.first] = item.second;
+      for( const auto& id : state->new_ids )
+         result.previous[index_id_of(id)][id] = nullptr;
+      for( const auto& item : state->old_index_next_ids )
+         result.next_ids[item.first] = item.second;
+   }
+   return result;
+}
+
+vector<char> object_database::oldest_state::pack( const index& idx )const
+{
+   static const std::unordered_map<object_id_type, const object*> unchanged;
+   const object_id_type index_id( idx.object_space_id(), idx.object_type_id(), 0 );
+   const auto next_id = next_ids.find( index_id );
+   const auto changes = previous.find( index_id );
+   return idx.pack( next_id != next_ids.end() ? next_id->second : idx.get_next_id(),
+                    changes != previous.end() ? changes->second : unchanged );
+}
+
+void object_database::inspect_all_indexes( const std::function<void(const index&)>& inspector )const
+{
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            inspector( *idx );
+}
+
+void object_database::unpack_index( uint8_t space_id, uint8_t type_id, const char* data, size_t size )
+{ try {
+   get_mutable_index( space_id, type_id ).unpack( data, size );
+   _dirty_indexes[dirty_slot( object_id_type( space_id, type_id, 0 ) )] = true;
+} FC_CAPTURE_AND_RETHROW( (space_id)(type_id) ) }
+
+void object_database::checkpoint( const fc::variant_object& info )
+{ try {
+   wait_for_checkpoint();
+
+   const oldest_state state = get_oldest_state();
+   auto files = std::make_shared< vector< std::pair< std::string, vector<char> > > >();
+   inspect_all_indexes( [this,&state,&files]( const index& idx ) {
+      if( _dirty_indexes[dirty_slot( object_id_type( idx.object_space_id(), idx.object_type_id(), 0 ) )] )
+         files->emplace_back( fc::to_string( uint32_t(idx.object_space_id()) ) + "/"
+                                 + fc::to_string( uint32_t(idx.object_type_id()) ),
+                              state.pack( idx ) );
+   });
+   reset_dirty_indexes();
+   if( files->empty() )
+      return;
+
+   vector<std::string> names;
+   names.reserve( files->size() );
+   for( const auto& file : *files )
+      names.push_back( file.first );
+   const std::string manifest = fc::json::to_string( fc::mutable_variant_object( "info", info )( "files", names ) );
+   const fc::path dir = _data_dir / "object_database";
+   // a plain thread rather than an fc task: waiting for it blocks instead of yielding, which must not happen
+   // while the caller holds the database write lock
+   _checkpoint_done = std::async( std::launch::async, [dir,files,manifest] () {
+      for( const auto& file : *files )
+      {
+         fc::create_directories( ( dir / file.first ).parent_path() );
+         write_file( dir / ( file.first + ".tmp" ), file.second );
+      }
+      write_file( dir / "checkpoint.tmp", vector<char>( manifest.begin(), manifest.end() ) );
+      fc::rename( dir / "checkpoint.tmp", dir / "checkpoint" );
+      finish_checkpoint( dir );
+   } );
+} FC_CAPTURE_AND_RETHROW( (info) ) }
+
+void object_database::wait_for_checkpoint()
+{
+   if( !_checkpoint_done.valid() )
+      return;
+   try
+   {
+      _checkpoint_done.get();
+   }
+   // the files in place are still consistent, the indexes will be written by the next flush
+   catch( const fc::exception& e )
+   {
+      wlog( "Writing the object_database checkpoint failed: ${e}", ("e", e.to_detail_string()) );
+      std::fill( _dirty_indexes.begin(), _dirty_indexes.end(), true );
+   }
+   catch( const std::exception& e )
+   {
+      wlog( "Writing the object_database checkpoint failed: ${e}", ("e", e.what()) );
+      std::fill( _dirty_indexes.begin(), _dirty_indexes.end(), true );
+   }
+}
+
+void object_database::reset_dirty_indexes()
+{
+   // indexes changed by the undo history differ from the oldest state, which is what is written next
+   std::fill( _dirty_indexes.begin(), _dirty_indexes.end(), false );
+   for( const auto& state : _undo_db.states() )
+   {
+      for( const auto& item : state.old_values )
+         _dirty_indexes[dirty_slot(item.first)] = true;
+      for( const auto& item : state.removed )
+         _dirty_indexes[dirty_slot(item.first)] = true;
+      for( const auto& id : state.new_ids )
+         _dirty_indexes[dirty_slot(id)] = true;
+      for( const auto& item : state.old_index_next_ids )
+         _dirty_indexes[dirty_slot(item.first)] = true;
+   }
 }
 
 void object_database::wipe(const fc::path& data_dir)
@@ -110,6 +277,13 @@ void object_database::open(const fc::path& data_dir)
        wlog("Ignoring locked object_database");
        return;
    }
+   finish_checkpoint( _data_dir / "object_database" );
+   // leftovers of a checkpoint interrupted before its manifest was written
+   fc::remove_all( _data_dir / "object_database" / "checkpoint.tmp" );
+   for( uint32_t space = 0; space < _index.size(); ++space )
+      for( uint32_t type = 0; type  < _index[space].size(); ++type )
+         if( _index[space][type] )
+            fc::remove_all( _data_dir / "object_database" / fc::to_string(space) / ( fc::to_string(type) + ".tmp" ) );
    std::vector<fc::future<void>> tasks;
    tasks.reserve(200);
    ilog("Opening object database from ${d} ...", ("d", data_dir));
@@ -121,6 +295,7 @@ void object_database::open(const fc::path& data_dir)
             } ) );
    for( auto& task : tasks )
       task.wait();
+   reset_dirty_indexes();
    ilog( "Done opening object database." );
 
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
@@ -133,16 +308,19 @@ void object_database::pop_undo()
 
 void object_database::save_undo( const object& obj )
 {
+   _dirty_indexes[dirty_slot(obj.id)] = true;
    _undo_db.on_modify( obj );
 }
 
 void object_database::save_undo_add( const object& obj )
 {
+   _dirty_indexes[dirty_slot(obj.id)] = true;
    _undo_db.on_create( obj );
 }
 
 void object_database::save_undo_remove(const object& obj)
 {
+   _dirty_indexes[dirty_slot(obj.id)] = true;
    _undo_db.on_remove( obj );
 }
 
@@ -25,8 +25,89 @@
 #include <graphene/db/undo_database.hpp>
 #include <fc/reflect/variant.hpp>
 
+#include <algorithm>
+
 namespace graphene { namespace db {
 
+void* undo_arena::allocate( size_t size )
+{
+   const size_t alignment = alignof(std::max_align_t);
+   size = ( size + alignment - 1 ) & ~( alignment - 1 );
+   if( _chunks.empty() || _used + size > _chunks.back().size )
+   {
+      const size_t new_chunk_size = std::max( size, chunk_size );
+      _chunks.push_back( chunk{ std::unique_ptr<char[]>( new char[new_chunk_size] ), new_chunk_size } );
+      _used = 0;
+   }
+   void* result = _chunks.back().data.get() + _used;
+   _used += size;
+   return result;
+}
+
+void undo_arena::take( undo_arena& other )
+{
+   if( other._chunks.empty() )
+      return;
+   for( auto& c : other._chunks )
+      _chunks.push_back( std::move(c) );
+   _used = other._used;
+   other._chunks.clear();
+   other._used = 0;
+}
+
+void undo_arena::reset()
+{
+   if( !_chunks.empty() && _chunks.front().size == chunk_size )
+      _chunks.resize( 1 );
+   else
+      _chunks.clear();
+   _used = 0;
+}
+
+void undo_state::clear()
+{
+   for( auto& item : old_values )
+      discard( item.second );
+   for( auto& item : removed )
+      discard( item.second );
+   old_values.clear();
+   old_index_next_ids.clear();
+   new_ids.clear();
+   removed.clear();
+   arena.reset();
+}
+
+undo_state& undo_database::push_state()
+{
+   if( _spare_states.empty() )
+      _stack.emplace_back();
+   else
+   {
+      _stack.push_back( std::move( _spare_states.back() ) );
+      _spare_states.pop_back();
+   }
+   return _stack.back();
+}
+
+void undo_database::pop_back_state()
+{
+   recycle( std::move( _stack.back() ) );
+   _stack.pop_back();
+}
+
+void undo_database::pop_front_state()
+{
+   recycle( std::move( _stack.front() ) );
+   _stack.pop_front();
+}
+
+void undo_database::recycle( undo_state&& state )
+{
+   state.clear();
+   if( _spare_states.size() < max_spare_states )
+      _spare_states.push_back( std::move(state) );
+}
+
 void undo_database::enable()  { _disabled = false; }
 void undo_database::disable() { _disabled = true; }
 
@@ -51,9 +132,9 @@ undo_database::session undo_database::start_undo_session( bool force_enable )
       _disabled = false;
 
    while( size() > max_size() )
-      _stack.pop_front();
+      pop_front_state();
 
-   _stack.emplace_back();
+   push_state();
    ++_active_sessions;
    return session(*this, disable_on_exit );
 }
@@ -61,9 +142,7 @@ void undo_database::on_create( const object& obj )
 {
    if( _disabled ) return;
 
-   if( _stack.empty() )
-      _stack.emplace_back();
-   auto& state = _stack.back();
+   auto& state = _stack.empty() ? push_state() : _stack.back();
    auto index_id = object_id_type( obj.id.space(), obj.id.type(), 0 );
    auto itr = state.old_index_next_ids.find( index_id );
    if( itr == state.old_index_next_ids.end() )
@@ -74,35 +153,35 @@ void undo_database::on_modify( const object& obj )
 {
    if( _disabled ) return;
 
-   if( _stack.empty() )
-      _stack.emplace_back();
-   auto& state = _stack.back();
+   auto& state = _stack.empty() ? push_state() : _stack.back();
    if( state.new_ids.find(obj.id) != state.new_ids.end() )
       return;
    auto itr =  state.old_values.find(obj.id);
    if( itr != state.old_values.end() ) return;
-   state.old_values[obj.id] = obj.clone();
+   object* saved = state.save( obj );
+   state.old_values[obj.id] = saved;
 }
 void undo_database::on_remove( const object& obj )
 {
    if( _disabled ) return;
 
-   if( _stack.empty() )
-      _stack.emplace_back();
-   undo_state& state = _stack.back();
+   undo_state& state = _stack.empty() ? push_state() : _stack.back();
    if( state.new_ids.count(obj.id) )
    {
       state.new_ids.erase(obj.id);
       return;
    }
-   if( state.old_values.count(obj.id) )
+   auto itr = state.old_values.find(obj.id);
+   if( itr != state.old_values.end() )
    {
-      state.removed[obj.id] = std::move(state.old_values[obj.id]);
+      object* saved = itr->second;
       state.old_values.erase(obj.id);
+      state.removed[obj.id] = saved;
       return;
    }
    if( state.removed.count(obj.id) ) return;
-   state.removed[obj.id] = obj.clone();
+   object* saved = state.save( obj );
+   state.removed[obj.id] = saved;
 }
 
 void undo_database::undo()
@@ -130,7 +209,7 @@ void undo_database::undo()
    for( auto& item : state.removed )
       _db.insert( std::move(*item.second) );
 
-   _stack.pop_back();
+   pop_back_state();
    enable();
    --_active_sessions;
 } FC_CAPTURE_AND_RETHROW() }
@@ -140,7 +219,7 @@ void undo_database::merge()
    FC_ASSERT( _active_sessions > 0 );
    if( _active_sessions == 1 && _stack.size() == 1 )
    {
-      _stack.pop_back();
+      pop_back_state();
       --_active_sessions;
       return;
    }
@@ -189,24 +268,28 @@ void undo_database::merge()
    //
 
    // We can only be outside type A/AB (the nop path) if B is not nop, so it suffices to iterate through B's three containers.
+   //
+   // The saved objects taken over by prev_state are cleared in state, the ones left there are destroyed when state is
+   // popped. Their memory is handed over to prev_state along with the arena.
 
    // *+upd
    for( auto& obj : state.old_values )
    {
-      if( prev_state.new_ids.find(obj.second->id) != prev_state.new_ids.end() )
+      if( prev_state.new_ids.find(obj.first) != prev_state.new_ids.end() )
       {
          // new+upd -> new, type A
          continue;
       }
-      if( prev_state.old_values.find(obj.second->id) != prev_state.old_values.end() )
+      if( prev_state.old_values.find(obj.first) != prev_state.old_values.end() )
       {
          // upd(was=X) + upd(was=Y) -> upd(was=X), type A
          continue;
       }
       // del+upd -> N/A
-      assert( prev_state.removed.find(obj.second->id) == prev_state.removed.end() );
+      assert( prev_state.removed.find(obj.first) == prev_state.removed.end() );
       // nop+upd(was=Y) -> upd(was=Y), type B
-      prev_state.old_values[obj.second->id] = std::move(obj.second);
+      prev_state.old_values[obj.first] = obj.second;
+      obj.second = nullptr;
    }
 
    // *+new, but we assume the N/A cases don't happen, leaving type B nop+new -> new
@@ -233,26 +316,29 @@ void undo_database::merge()
    // *+del
    for( auto& obj : state.removed )
    {
-      if( prev_state.new_ids.find(obj.second->id) != prev_state.new_ids.end() )
+      if( prev_state.new_ids.find(obj.first) != prev_state.new_ids.end() )
       {
          // new + del -> nop (type C)
-         prev_state.new_ids.erase(obj.second->id);
+         prev_state.new_ids.erase(obj.first);
          continue;
       }
-      auto it = prev_state.old_values.find(obj.second->id);
+      auto it = prev_state.old_values.find(obj.first);
       if( it != prev_state.old_values.end() )
       {
          // upd(was=X) + del(was=Y) -> del(was=X)
-         prev_state.removed[obj.second->id] = std::move(it->second);
-         prev_state.old_values.erase(obj.second->id);
+         object* was = it->second;
+         prev_state.old_values.erase(obj.first);
+         prev_state.removed[obj.first] = was;
          continue;
       }
       // del + del -> N/A
-      assert( prev_state.removed.find( obj.second->id ) == prev_state.removed.end() );
+      assert( prev_state.removed.find( obj.first ) == prev_state.removed.end() );
       // nop + del(was=Y) -> del(was=Y)
-      prev_state.removed[obj.second->id] = std::move(obj.second);
+      prev_state.removed[obj.first] = obj.second;
+      obj.second = nullptr;
    }
-   _stack.pop_back();
+   prev_state.arena.take( state.arena );
+   pop_back_state();
    --_active_sessions;
 }
 void undo_database::commit()
@@ -288,7 +374,7 @@ void undo_database::pop_commit()
       for( auto& item : state.removed )
          _db.insert( std::move(*item.second) );
 
-      _stack.pop_back();
+      pop_back_state();
    }
    catch ( const fc::exception& e )
    {
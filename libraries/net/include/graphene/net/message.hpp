@@ -33,6 +33,8 @@
 #include <fc/crypto/ripemd160.hpp>
 #include <fc/reflect/typename.hpp>
 
+#include <memory>
+
 namespace graphene { namespace net {
 
   /**
@@ -49,13 +51,52 @@ namespace graphene { namespace net {
 
   typedef fc::uint160_t message_hash_type;
 
+  /**
+   *  The payload of a message.  Copies share one reference counted buffer, so a message which is
+   *  cached and relayed to many peers is serialized and allocated only once.  The bytes are not
+   *  changed once shared, mutable_bytes() copies them first if needed.
+   */
+  class message_data
+  {
+     public:
+        message_data(){}
+        explicit message_data( std::vector<char>&& bytes )
+        :_bytes( std::make_shared<std::vector<char>>( std::move(bytes) ) ){}
+
+        size_t      size()const  { return _bytes ? _bytes->size() : 0; }
+        bool        empty()const { return size() == 0; }
+        const char* data()const  { return _bytes ? _bytes->data() : nullptr; }
+        const char* begin()const { return data(); }
+        const char* end()const   { return data() + size(); }
+        char operator[]( size_t i )const { return (*_bytes)[i]; }
+
+        const std::vector<char>& bytes()const
+        {
+           static const std::vector<char> no_bytes;
+           return _bytes ? *_bytes : no_bytes;
+        }
+
+        /** @return the bytes of this message only, copied first if they are shared with other messages */
+        std::vector<char>& mutable_bytes()
+        {
+           if( !_bytes )
+              _bytes = std::make_shared<std::vector<char>>();
+           else if( _bytes.use_count() > 1 )
+              _bytes = std::make_shared<std::vector<char>>( *_bytes );
+           return *_bytes;
+        }
+
+     private:
+        std::shared_ptr<std::vector<char>> _bytes;
+  };
+
   /**
    *  Abstracts the process of packing/unpacking a message for a 
    *  particular channel.
    */
   struct message : public message_header
   {
-     std::vector<char> data;
+     message_data data;
 
      message(){}
 
@@ -72,7 +113,7 @@ namespace graphene { namespace net {
      message( const T& m ) 
      {
         msg_type = T::type;
-        data     = fc::raw::pack(m);
+        data     = message_data( fc::raw::pack(m) );
         size     = (uint32_t)data.size();
      }
 
@@ -114,6 +155,27 @@ namespace graphene { namespace net {
 
 } } // graphene::net
 
+namespace fc {
+   void to_variant( const graphene::net::message_data& var, fc::variant& vo, uint32_t max_depth );
+   void from_variant( const fc::variant& var, graphene::net::message_data& vo, uint32_t max_depth );
+
+namespace raw {
+   template<typename Stream>
+   void pack( Stream& s, const graphene::net::message_data& data, uint32_t _max_depth=FC_PACK_MAX_DEPTH )
+   {
+      fc::raw::pack( s, data.bytes(), _max_depth );
+   }
+
+   template<typename Stream>
+   void unpack( Stream& s, graphene::net::message_data& data, uint32_t _max_depth=FC_PACK_MAX_DEPTH )
+   {
+      std::vector<char> bytes;
+      fc::raw::unpack( s, bytes, _max_depth );
+      data = graphene::net::message_data( std::move(bytes) );
+   }
+} } // fc::raw
+
+FC_REFLECT_TYPENAME( graphene::net::message_data )
 FC_REFLECT_TYPENAME( graphene::net::message_header )
 FC_REFLECT_TYPENAME( graphene::net::message )
 
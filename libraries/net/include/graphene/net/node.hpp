@@ -268,9 +268,14 @@ namespace graphene { namespace net {
          *  I have a message ready.
          */
         virtual void  broadcast( const message& item_to_broadcast );
+        /**
+         *  Same as above, @p hash_of_message_contents is the id of the block or transaction in the
+         *  message, so that it need not be unpacked again to find it.
+         */
+        virtual void  broadcast( const message& item_to_broadcast, const fc::uint160_t& hash_of_message_contents );
         virtual void  broadcast_transaction( const signed_transaction& trx )
         {
-           broadcast( trx_message(trx) );
+           broadcast( trx_message(trx), trx.id() );
         }
 
         /**
@@ -320,6 +325,7 @@ namespace graphene { namespace net {
 
       void      sync_from(const item_id& current_head_block, const std::vector<uint32_t>& hard_fork_block_numbers) override {}
       void      broadcast(const message& item_to_broadcast) override;
+      void      broadcast(const message& item_to_broadcast, const fc::uint160_t& hash_of_message_contents) override;
       void      add_node_delegate(node_delegate* node_delegate_to_add);
 
       virtual uint32_t get_connection_count() const override { return 8; }
@@ -21,9 +21,23 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+#include <graphene/net/message.hpp>
+
 #include <fc/io/raw.hpp>
 
-#include <graphene/net/message.hpp>
+namespace fc {
+   void to_variant( const graphene::net::message_data& var, fc::variant& vo, uint32_t max_depth )
+   {
+      to_variant( var.bytes(), vo, max_depth );
+   }
+
+   void from_variant( const fc::variant& var, graphene::net::message_data& vo, uint32_t max_depth )
+   {
+      std::vector<char> bytes;
+      from_variant( var, bytes, max_depth );
+      vo = graphene::net::message_data( std::move(bytes) );
+   }
+}
 
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::message_header, BOOST_PP_SEQ_NIL, (size)(msg_type) )
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::message, (graphene::net::message_header), (data) )
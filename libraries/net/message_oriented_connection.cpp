@@ -162,14 +162,16 @@ namespace graphene { namespace net {
           FC_ASSERT( m.size.value() <= MAX_MESSAGE_SIZE, "", ("m.size",m.size.value())("MAX_MESSAGE_SIZE",MAX_MESSAGE_SIZE) );
 
           size_t remaining_bytes_with_padding = 16 * ((m.size.value() - LEFTOVER + 15) / 16);
-          m.data.resize(LEFTOVER + remaining_bytes_with_padding); //give extra 16 bytes to allow for padding added in send call
-          std::copy(buffer + sizeof(message_header), buffer + sizeof(buffer), m.data.begin());
+          // read into a fresh buffer, the previous one may still be shared by copies of the last message
+          std::vector<char> data(LEFTOVER + remaining_bytes_with_padding); //give extra 16 bytes to allow for padding added in send call
+          std::copy(buffer + sizeof(message_header), buffer + sizeof(buffer), data.begin());
           if (remaining_bytes_with_padding)
           {
-            _sock.read(&m.data[LEFTOVER], remaining_bytes_with_padding);
+            _sock.read(&data[LEFTOVER], remaining_bytes_with_padding);
             _bytes_received += remaining_bytes_with_padding;
           }
-          m.data.resize(m.size.value()); // truncate off the padding bytes
+          data.resize(m.size.value()); // truncate off the padding bytes
+          m.data = message_data(std::move(data));
 
           _last_message_received_time = fc::time_point::now();
 
@@ -2869,6 +2869,7 @@ namespace graphene { namespace net { namespace detail {
     }
 
     void node_impl::process_block_during_normal_operation( peer_connection* originating_peer,
+                                                           const message& message_to_process,
                                                            const graphene::net::block_message& block_message_to_process,
                                                            const message_hash_type& message_hash )
     {
@@ -2943,7 +2944,7 @@ namespace graphene { namespace net { namespace detail {
           peer->clear_old_inventory();
         }
         message_propagation_data propagation_data{message_receive_time, message_validated_time, originating_peer->node_id};
-        broadcast( block_message_to_process, propagation_data );
+        broadcast( message_to_process, message_hash, block_message_to_process.block_id, propagation_data );
         _message_cache.block_accepted();
 
         if (is_hard_fork_block(block_number))
@@ -3028,7 +3029,7 @@ namespace graphene { namespace net { namespace detail {
       if (item_iter != originating_peer->items_requested_from_peer.end())
       {
         originating_peer->items_requested_from_peer.erase(item_iter);
-        process_block_during_normal_operation(originating_peer, block_message_to_process, message_hash);
+        process_block_during_normal_operation(originating_peer, message_to_process, block_message_to_process, message_hash);
         if (originating_peer->idle())
           trigger_fetch_items_loop();
         return;
@@ -3383,12 +3384,14 @@ namespace graphene { namespace net { namespace detail {
 
         // Next: have the delegate process the message
         fc::time_point message_validated_time;
+        fc::uint160_t hash_of_message_contents;
         try
         {
           if (message_to_process.msg_type.value() == trx_message_type)
           {
             trx_message transaction_message_to_process = message_to_process.as<trx_message>();
-            dlog("passing message containing transaction ${trx} to client", ("trx", transaction_message_to_process.trx.id()));
+            hash_of_message_contents = transaction_message_to_process.trx.id();
+            dlog("passing message containing transaction ${trx} to client", ("trx", hash_of_message_contents));
             _delegate->handle_transaction(transaction_message_to_process);
           }
           else
@@ -3409,7 +3412,7 @@ namespace graphene { namespace net { namespace detail {
 
         // finally, if the delegate validated the message, broadcast it to our other peers
         message_propagation_data propagation_data{message_receive_time, message_validated_time, originating_peer->node_id};
-        broadcast( message_to_process, propagation_data );
+        broadcast( message_to_process, message_hash, hash_of_message_contents, propagation_data );
       }
     }
 
@@ -4447,35 +4450,40 @@ namespace graphene { namespace net { namespace detail {
       return (uint32_t)_active_connections.size();
     }
 
-    void node_impl::broadcast( const message& item_to_broadcast, const message_propagation_data& propagation_data )
+    void node_impl::broadcast( const message& item_to_broadcast, const message_hash_type& hash_of_item_to_broadcast,
+                               const fc::uint160_t& hash_of_message_contents,
+                               const message_propagation_data& propagation_data )
     {
       VERIFY_CORRECT_THREAD();
-      fc::uint160_t hash_of_message_contents;
+      // the message is cached as is, peers fetching it share its buffer
       if( item_to_broadcast.msg_type.value() == graphene::net::block_message_type )
-      {
-        graphene::net::block_message block_message_to_broadcast = item_to_broadcast.as<graphene::net::block_message>();
-        hash_of_message_contents = block_message_to_broadcast.block_id; // for debugging
-        _most_recent_blocks_accepted.push_back( block_message_to_broadcast.block_id );
-      }
+        _most_recent_blocks_accepted.push_back( hash_of_message_contents );
       else if( item_to_broadcast.msg_type.value() == graphene::net::trx_message_type )
-      {
-        graphene::net::trx_message transaction_message_to_broadcast = item_to_broadcast.as<graphene::net::trx_message>();
-        hash_of_message_contents = transaction_message_to_broadcast.trx.id(); // for debugging
-        dlog( "broadcasting trx: ${trx}", ("trx", transaction_message_to_broadcast) );
-      }
-      message_hash_type hash_of_item_to_broadcast = item_to_broadcast.id();
+        dlog( "broadcasting trx: ${id}", ("id", hash_of_message_contents) );
 
       _message_cache.cache_message( item_to_broadcast, hash_of_item_to_broadcast, propagation_data, hash_of_message_contents );
       _new_inventory.insert( item_id(item_to_broadcast.msg_type.value(), hash_of_item_to_broadcast ) );
       trigger_advertise_inventory_loop();
     }
 
-    void node_impl::broadcast( const message& item_to_broadcast )
+    void node_impl::broadcast( const message& item_to_broadcast, const fc::uint160_t& hash_of_message_contents )
     {
       VERIFY_CORRECT_THREAD();
       // this version is called directly from the client
       message_propagation_data propagation_data{fc::time_point::now(), fc::time_point::now(), _node_id};
-      broadcast( item_to_broadcast, propagation_data );
+      broadcast( item_to_broadcast, item_to_broadcast.id(), hash_of_message_contents, propagation_data );
+    }
+
+    void node_impl::broadcast( const message& item_to_broadcast )
+    {
+      VERIFY_CORRECT_THREAD();
+      // the client did not tell the id of the block or transaction, get it from the message
+      fc::uint160_t hash_of_message_contents;
+      if( item_to_broadcast.msg_type.value() == graphene::net::block_message_type )
+        hash_of_message_contents = item_to_broadcast.as<graphene::net::block_message>().block_id;
+      else if( item_to_broadcast.msg_type.value() == graphene::net::trx_message_type )
+        hash_of_message_contents = item_to_broadcast.as<graphene::net::trx_message>().trx.id();
+      broadcast( item_to_broadcast, hash_of_message_contents );
     }
 
     void node_impl::sync_from(const item_id& current_head_block, const std::vector<uint32_t>& hard_fork_block_numbers)
@@ -4749,6 +4757,11 @@ namespace graphene { namespace net { namespace detail {
     INVOKE_IN_IMPL(broadcast, msg);
   }
 
+  void node::broadcast( const message& msg, const fc::uint160_t& hash_of_message_contents )
+  {
+    INVOKE_IN_IMPL(broadcast, msg, hash_of_message_contents);
+  }
+
   void node::sync_from(const item_id& current_head_block, const std::vector<uint32_t>& hard_fork_block_numbers)
   {
     INVOKE_IN_IMPL(sync_from, current_head_block, hard_fork_block_numbers);
@@ -4872,6 +4885,11 @@ namespace graphene { namespace net { namespace detail {
     }
   }
 
+  void simulated_network::broadcast( const message& item_to_broadcast, const fc::uint160_t& )
+  {
+    broadcast( item_to_broadcast );
+  }
+
   void simulated_network::broadcast( const message& item_to_broadcast  )
   {
     for (node_info* network_node_info : network_nodes)
@@ -442,7 +442,8 @@ class node_impl : public peer_connection_delegate
       void process_backlog_of_sync_blocks();
       void trigger_process_backlog_of_sync_blocks();
       void process_block_during_sync(peer_connection* originating_peer, const graphene::net::block_message& block_message, const message_hash_type& message_hash);
-      void process_block_during_normal_operation(peer_connection* originating_peer, const graphene::net::block_message& block_message, const message_hash_type& message_hash);
+      void process_block_during_normal_operation(peer_connection* originating_peer, const message& message_to_process,
+                                                 const graphene::net::block_message& block_message, const message_hash_type& message_hash);
       void process_block_message(peer_connection* originating_peer, const message& message_to_process, const message_hash_type& message_hash);
 
       void process_ordinary_message(peer_connection* originating_peer, const message& message_to_process, const message_hash_type& message_hash);
@@ -494,7 +495,10 @@ class node_impl : public peer_connection_delegate
       std::vector<peer_status> get_connected_peers() const;
       uint32_t                 get_connection_count() const;
 
-      void broadcast(const message& item_to_broadcast, const message_propagation_data& propagation_data);
+      /** caches the message for our peers, @p hash_of_message_contents is the id of the block or transaction in it */
+      void broadcast(const message& item_to_broadcast, const message_hash_type& hash_of_item_to_broadcast,
+                     const fc::uint160_t& hash_of_message_contents, const message_propagation_data& propagation_data);
+      void broadcast(const message& item_to_broadcast, const fc::uint160_t& hash_of_message_contents);
       void broadcast(const message& item_to_broadcast);
       void sync_from(const item_id& current_head_block, const std::vector<uint32_t>& hard_fork_block_numbers);
       bool is_connected() const;
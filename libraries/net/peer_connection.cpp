@@ -52,7 +52,7 @@ namespace graphene { namespace net
         // it won't work for anything after a variable-length field
         std::vector<char> packed_current_time = fc::raw::pack(fc::time_point::now());
         assert(message_send_time_field_offset + packed_current_time.size() <= message_to_send.data.size());
-        memcpy(message_to_send.data.data() + message_send_time_field_offset,
+        memcpy(message_to_send.data.mutable_bytes().data() + message_send_time_field_offset,
                packed_current_time.data(), packed_current_time.size());
       }
       return message_to_send;
@@ -39,6 +39,8 @@
 #include <fc/filesystem.hpp>
 #include <fc/thread/thread.hpp>
 
+#include <algorithm>
+
 namespace graphene { namespace account_archive {
 
 namespace detail {
@@ -53,27 +55,103 @@ namespace detail {
 
          /** This updates indices after a block is enchained. */
          void process_block(const signed_block& b);
+         /** This drops the block times past the head block left after a block is popped. */
+         void process_popped_block(uint32_t head_block_num);
 
          account_archive_plugin& _self;
 
          void                     init(const boost::program_options::variables_map& options);
-         operation_history_object load(uint32_t index) const;
+         void                     startup();
+         void                     flush();
+         operation_history_object  load(uint32_t index) const;
+         vector<operation_history_object> load(uint32_t first, uint32_t count) const;
+         uint32_t                  find_block_by_time(time_point_sec time) const;
+         operation_archive_id_type get_account_operation(const account_archive_object& archive, uint32_t index) const;
+         account_summary           get_account_summary(const account_archive_object& archive, asset_id_type asset_id, uint32_t first, uint32_t end) const;
+         /** Returns the chunks of an archive removed by undo to the on-disk lists. */
+         void                      release_chunks(const account_archive_object& archive);
 
       private:
-         operation_database _operation_db;
+         /** While replaying, the files are flushed after this many operations or this much time, and at object database checkpoints. */
+         static const uint32_t flush_operations = 10000;
+         static const int64_t  flush_interval_ms = 1000;
+
+         struct pending_append
+         {
+            operation_archive_id_type                 operation;
+            flat_map<asset_id_type, account_summary>  balance_changes;
+         };
+
+         operation_database         _operation_db;
+         block_time_index           _block_times;
+         account_operation_database _account_operation_db;
+         account_summary_database   _account_summary_db;
+
+         /** the operations of the block being processed, grouped by impacted account */
+         std::map<account_id_type, vector<pending_append>> _block_appends;
+         uint32_t                   _unflushed_operations = 0;
+         /** set once the stored lists are known to be referenced, i.e. at the first block processed */
+         bool                       _lists_checked = false;
+         fc::time_point             _last_flush;
 
          flat_set<account_id_type> get_impacted_accounts(const operation_history_object& op, const object_database& db);
    };
 
    account_archive_plugin_impl::~account_archive_plugin_impl() {}
 
+   /**
+    * Account archives are only removed by undo, i.e. when the block creating them is undone.
+    * Their chunks would never be referenced again, so they are handed back for reuse.
+    */
+   class account_archive_chunk_reclaimer : public secondary_index
+   {
+      public:
+         account_archive_chunk_reclaimer(account_archive_plugin_impl* impl) : _impl(impl) {}
+
+         virtual void object_removed(const object& obj) override
+         {
+            _impl->release_chunks(static_cast<const account_archive_object&>(obj));
+         }
+
+      private:
+         account_archive_plugin_impl* _impl;
+   };
+
+   void account_archive_plugin_impl::flush()
+   {
+      _operation_db.flush();
+      _block_times.flush();
+      _account_operation_db.flush();
+      _account_summary_db.flush();
+      _unflushed_operations = 0;
+      _last_flush = fc::time_point::now();
+   }
+
    void account_archive_plugin_impl::process_block(const signed_block& b)
    {
       auto& db = database();
       auto& account_archives = db.get_index_type<account_archive_index>().indices().get<by_id>();
 
+      // applied_block swallows exceptions, the operations collected for a failed block must not be appended with the next one
+      struct clear_on_exit
+      {
+         std::map<account_id_type, vector<pending_append>>& appends;
+         ~clear_on_exit() { appends.clear(); }
+      } clear_appends{_block_appends};
+
       // comply with undo if applied
       _operation_db.truncate(b.block_num());
+      _block_times.set(b.block_num(), b.timestamp);
+
+      // the stored lists are only referenced by account archives, there are none when replaying from the genesis
+      // or starting from a snapshot, which holds no plugin state; the lists left over are dropped once
+      if (!_lists_checked) {
+         if (account_archives.empty()) {
+            _account_operation_db.clear();
+            _account_summary_db.clear();
+         }
+         _lists_checked = true;
+      }
 
       // index enchained operations
       const auto numtrxs = static_cast<uint16_t>(b.transactions.size());
@@ -102,26 +180,53 @@ namespace detail {
             o.virtual_op = op->virtual_op;
             o.operation_id = static_cast<uint16_t>(op->op.which());
          };
-         auto& indexed_operation = db.create<operation_archive_object>(initialize_operation); // THIS OBJECT SHALL NOT BE REMOVED FROM THE DB
+         const operation_archive_id_type indexed_operation_id = db.create<operation_archive_object>(initialize_operation).id; // THIS OBJECT SHALL NOT BE REMOVED FROM THE DB
 
-         // index in account archives
-         auto append_operation = [&](account_archive_object& o) { o.operations.push_back(indexed_operation.id); }; // THE operations VECTOR SHALL NEVER BE MODIFIED EXCEPT BEING EXPANDED
+         // collect the operations of each account, they are appended to its archive at once below
          flat_set<account_id_type> impacted_accounts = get_impacted_accounts(*op, db);
          for (auto& acc : impacted_accounts) {
-            object_id_type id = account_archive_id_type(acc.instance);
-            const account_archive_object* archive = nullptr;
-            const auto& finder = account_archives.find(id);
-            if (finder != account_archives.end())
-               archive = &(*finder);
-            else
-               archive = &db.create<account_archive_object>([&](account_archive_object& aao) { aao.id = id; });
-            FC_ASSERT(archive != nullptr);
-            db.modify(*archive, append_operation);
+            auto& appends = _block_appends[acc];
+            appends.emplace_back();
+            appends.back().operation = indexed_operation_id;
+            summarize_operation(acc, *op, appends.back().balance_changes);
          }
+         _unflushed_operations++;
       }
 
-      // flush all virtual operations at once
-      _operation_db.flush();
+      // index in account archives, in the order the operations were applied
+      for (const auto& item : _block_appends) {
+         object_id_type id = account_archive_id_type(item.first.instance);
+         const account_archive_object* archive = nullptr;
+         const auto& finder = account_archives.find(id);
+         if (finder != account_archives.end())
+            archive = &(*finder);
+         else
+            archive = &db.create<account_archive_object>([&](account_archive_object& aao) { aao.id = id; });
+         FC_ASSERT(archive != nullptr);
+         db.modify(*archive, [this,&item](account_archive_object& o) { // THE STORED OPERATIONS SHALL NEVER BE MODIFIED EXCEPT BEING EXPANDED
+            for (const auto& append : item.second) {
+               _account_operation_db.append(o, append.operation);
+               _account_summary_db.append(o, append.balance_changes);
+            }
+         });
+      }
+
+      // only the ids of the operations created above are kept, their materialized views can go
+      db.get_index_type<operation_archive_index>().release_views();
+
+      // while replaying the flushes are batched, otherwise the block's operations are published to readers at once;
+      // the object database checkpoint written after this block may reference all the stored operations
+      const uint32_t checkpoint_interval = db.get_db_checkpoint_interval();
+      if (db._undo_db.enabled()
+            || _unflushed_operations >= flush_operations
+            || (checkpoint_interval && b.block_num() % checkpoint_interval == 0)
+            || fc::time_point::now() - _last_flush >= fc::milliseconds(flush_interval_ms))
+         flush();
+   }
+
+   void account_archive_plugin_impl::process_popped_block(uint32_t head_block_num)
+   {
+      _block_times.truncate(head_block_num + 1);
    }
 
    void account_archive_plugin_impl::init(const boost::program_options::variables_map& options)
@@ -134,9 +239,34 @@ namespace detail {
             data_dir = fc::current_path() / data_dir;
       }
 
-      if (options.count("resync-blockchain") || options.count("replay-blockchain") || options.count("revalidate-blockchain"))
+      if (options.count("resync-blockchain") || options.count("replay-blockchain") || options.count("revalidate-blockchain")) {
          _operation_db.wipe(data_dir);
+         _block_times.wipe(data_dir);
+         _account_operation_db.wipe(data_dir);
+         _account_summary_db.wipe(data_dir);
+      }
       _operation_db.open(data_dir);
+      _block_times.open(data_dir);
+      _account_operation_db.open(data_dir);
+      _account_summary_db.open(data_dir);
+   }
+
+   void account_archive_plugin_impl::startup()
+   {
+      _last_flush = fc::time_point::now();
+
+      // Reconcile the block times with the chain head, i.e. drop blocks popped before
+      // a restart and record blocks applied before this index was introduced. A node
+      // started from a snapshot has no blocks before it, their times are left unset.
+      const auto& db = database();
+      const uint32_t head = db.head_block_num();
+      _block_times.truncate(head + 1);
+      for (uint32_t block_num = std::max({_block_times.get_block_count(), db.first_block_num(), 1u}); block_num <= head; block_num++) {
+         const auto timestamp = db.fetch_block_time_by_number(block_num);
+         FC_ASSERT(timestamp.valid(), "Missing block ${n}", ("n", block_num));
+         _block_times.set(block_num, *timestamp);
+      }
+      _block_times.flush();
    }
 
    operation_history_object account_archive_plugin_impl::load(uint32_t index) const
@@ -144,6 +274,32 @@ namespace detail {
       return _operation_db.load(index);
    }
 
+   vector<operation_history_object> account_archive_plugin_impl::load(uint32_t first, uint32_t count) const
+   {
+      return _operation_db.load(first, count);
+   }
+
+   uint32_t account_archive_plugin_impl::find_block_by_time(time_point_sec time) const
+   {
+      return _block_times.lower_bound(time);
+   }
+
+   operation_archive_id_type account_archive_plugin_impl::get_account_operation(const account_archive_object& archive, uint32_t index) const
+   {
+      return _account_operation_db.get(archive, index);
+   }
+
+   account_summary account_archive_plugin_impl::get_account_summary(const account_archive_object& archive, asset_id_type asset_id, uint32_t first, uint32_t end) const
+   {
+      return _account_summary_db.get(archive, asset_id, first, end);
+   }
+
+   void account_archive_plugin_impl::release_chunks(const account_archive_object& archive)
+   {
+      _account_operation_db.release(archive);
+      _account_summary_db.release(archive);
+   }
+
    flat_set<account_id_type> account_archive_plugin_impl::get_impacted_accounts(const operation_history_object& op, const object_database& db)
    {
       flat_set<account_id_type> impacted;
@@ -181,15 +337,23 @@ namespace detail {
 
    void account_archive_plugin::plugin_initialize(const boost::program_options::variables_map& options)
    {
-      database().add_index<primary_index<account_archive_index>>();
+      auto archive_index = database().add_index<primary_index<account_archive_index>>();
+      archive_index->add_secondary_index<detail::account_archive_chunk_reclaimer>(impl.get());
       database().add_index<primary_index<operation_archive_index>>();
       database().applied_block.connect( [&](const signed_block& b){ impl->process_block(b); } );
+      database().popped_block.connect( [&](uint32_t head_block_num){ impl->process_popped_block(head_block_num); } );
 
       impl->init(options);
    }
 
    void account_archive_plugin::plugin_startup()
    {
+      impl->startup();
+   }
+
+   void account_archive_plugin::plugin_shutdown()
+   {
+      impl->flush();
    }
 
    void account_archive_plugin::plugin_set_program_options(
@@ -203,4 +367,24 @@ namespace detail {
       return impl->load(index);
    }
 
+   vector<operation_history_object> account_archive_plugin::load(uint32_t first, uint32_t count) const
+   {
+      return impl->load(first, count);
+   }
+
+   uint32_t account_archive_plugin::find_block_by_time(time_point_sec time) const
+   {
+      return impl->find_block_by_time(time);
+   }
+
+   operation_archive_id_type account_archive_plugin::get_account_operation(const account_archive_object& archive, uint32_t index) const
+   {
+      return impl->get_account_operation(archive, index);
+   }
+
+   account_summary account_archive_plugin::get_account_summary(const account_archive_object& archive, asset_id_type asset_id, uint32_t first, uint32_t end) const
+   {
+      return impl->get_account_summary(archive, asset_id, first, end);
+   }
+
 } } // graphene::account_archive
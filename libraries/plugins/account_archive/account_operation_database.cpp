@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2019 01 People, s.r.o. (01 CryptoHouse).
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <graphene/account_archive/account_operation_database.hpp>
+
+#include <fc/exception/exception.hpp>
+
+namespace graphene { namespace account_archive {
+
+static const uint64_t chunk_bytes = account_operation_database::chunk_size * sizeof(uint32_t);
+
+void account_operation_database::open(const fc::path& dir)
+{ try {
+    const auto dbdir = dir / "account_operation_database";
+    fc::create_directories(dbdir);
+    _chunks.open(dbdir / "chunks");
+    // the last chunk may be written only partially
+    _next_chunk = static_cast<uint32_t>((_chunks.size() + chunk_bytes - 1) / chunk_bytes);
+} FC_CAPTURE_AND_RETHROW((dir)) }
+
+void account_operation_database::close()
+{
+    _chunks.close();
+    _next_chunk = 0;
+    _free_chunks.clear();
+}
+
+void account_operation_database::flush()
+{
+    _chunks.flush();
+}
+
+void account_operation_database::wipe(const fc::path& dir)
+{
+    if (_chunks.is_open())
+        close();
+    fc::remove_all(dir / "account_operation_database");
+}
+
+void account_operation_database::clear()
+{
+    FC_ASSERT(_chunks.is_open());
+    _chunks.resize(0);
+    _next_chunk = 0;
+    _free_chunks.clear();
+}
+
+void account_operation_database::append(account_archive_object& archive, operation_archive_id_type operation)
+{
+    const uint32_t index = archive.num_operations;
+    const uint32_t chunk = index / chunk_size;
+    // chunks of undone operations are kept and reused
+    if (chunk >= archive.chunks.size()) {
+        FC_ASSERT(chunk == archive.chunks.size());
+        archive.chunks.push_back(allocate_chunk());
+    }
+
+    const uint32_t instance = static_cast<uint32_t>(operation.instance.value);
+    _chunks.write(archive.chunks[chunk] * chunk_bytes + (index % chunk_size) * sizeof(uint32_t), instance);
+    archive.num_operations++;
+}
+
+void account_operation_database::release(const account_archive_object& archive)
+{
+    _free_chunks.insert(_free_chunks.end(), archive.chunks.begin(), archive.chunks.end());
+}
+
+uint32_t account_operation_database::allocate_chunk()
+{
+    if (_free_chunks.empty())
+        return _next_chunk++;
+    const uint32_t chunk = _free_chunks.back();
+    _free_chunks.pop_back();
+    return chunk;
+}
+
+operation_archive_id_type account_operation_database::get(const account_archive_object& archive, uint32_t index) const
+{
+    FC_ASSERT(index < archive.num_operations, "Account archive ${a} does not hold operation ${i}", ("a", archive.id)("i", index));
+    const uint32_t chunk = index / chunk_size;
+    uint32_t instance = 0;
+    const bool found = _chunks.read(archive.chunks[chunk] * chunk_bytes + (index % chunk_size) * sizeof(uint32_t), instance);
+    FC_ASSERT(found, "Account archive ${a} is not stored completely", ("a", archive.id));
+    return operation_archive_id_type(instance);
+}
+
+} } // graphene::account_archive
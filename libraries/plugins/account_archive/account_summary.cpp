@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2019 01 People, s.r.o. (01 CryptoHouse).
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/account_archive/account_summary.hpp>
+
+namespace graphene { namespace account_archive {
+
+struct fee_summary_visitor
+{
+   typedef void result_type;
+
+   const account_id_type& account_id;
+   flat_map<asset_id_type, account_summary>& sums;
+
+   fee_summary_visitor(const account_id_type& account_id, flat_map<asset_id_type, account_summary>& sums) : account_id(account_id), sums(sums) {}
+
+   template<typename OpType>
+   result_type operator()(const OpType& op) const
+   {
+      if (op.fee_payer() == account_id)
+         sums[op.fee.asset_id].fees += op.fee.amount;
+   }
+};
+
+void summarize_operation(account_id_type account_id, const operation_history_object& oho, flat_map<asset_id_type, account_summary>& sums)
+{
+   const operation& op = oho.op;
+   switch(op.which()) {
+      case operation::tag<transfer_operation>::value:
+      {
+         const auto& o = op.get<transfer_operation>();
+         if (o.from == account_id)
+            sums[o.amount.asset_id].debits += o.amount.amount;
+         if (o.to == account_id)
+            sums[o.amount.asset_id].credits += o.amount.amount;
+         break;
+      }
+      case operation::tag<limit_order_create_operation>::value:
+      {
+         const auto& o = op.get<limit_order_create_operation>();
+         if (o.seller == account_id)
+            sums[o.amount_to_sell.asset_id].debits += o.amount_to_sell.amount;
+         break;
+      }
+      case operation::tag<limit_order_cancel_operation>::value:
+      {
+         // the order is gone once the operation is applied, its result holds the refunded amount
+         const auto& o = op.get<limit_order_cancel_operation>();
+         if ((o.fee_paying_account == account_id) && (oho.result.which() == operation_result::tag<asset>::value)) {
+            const auto& refunded = oho.result.get<asset>();
+            sums[refunded.asset_id].credits += refunded.amount;
+         }
+         break;
+      }
+      case operation::tag<call_order_update_operation>::value:
+      {
+         const auto& o = op.get<call_order_update_operation>();
+         if (o.funding_account == account_id) {
+            if (o.delta_collateral.amount > 0)
+               sums[o.delta_collateral.asset_id].debits += o.delta_collateral.amount;
+            if (o.delta_collateral.amount < 0)
+               sums[o.delta_collateral.asset_id].credits += o.delta_collateral.amount;
+            if (o.delta_debt.amount > 0)
+               sums[o.delta_debt.asset_id].credits += o.delta_debt.amount;
+            if (o.delta_debt.amount < 0)
+               sums[o.delta_debt.asset_id].debits += o.delta_debt.amount;
+         }
+         break;
+      }
+      case operation::tag<fill_order_operation>::value: // VIRTUAL
+      {
+         const auto& o = op.get<fill_order_operation>();
+         // the paid amount is accounted in the limit_order_create_operation
+         if (o.account_id == account_id)
+            sums[o.receives.asset_id].credits += o.receives.amount;
+         break;
+      }
+      case operation::tag<asset_issue_operation>::value:
+      {
+         const auto& o = op.get<asset_issue_operation>();
+         if (o.issue_to_account == account_id)
+            sums[o.asset_to_issue.asset_id].credits += o.asset_to_issue.amount;
+         break;
+      }
+      case operation::tag<asset_reserve_operation>::value:
+      {
+         const auto& o = op.get<asset_reserve_operation>();
+         if (o.payer == account_id)
+            sums[o.amount_to_reserve.asset_id].debits += o.amount_to_reserve.amount;
+         break;
+      }
+      case operation::tag<asset_fund_fee_pool_operation>::value:
+      {
+         const auto& o = op.get<asset_fund_fee_pool_operation>();
+         if (o.from_account == account_id)
+            sums[o.asset_id].debits += o.amount;
+         break;
+      }
+      case operation::tag<asset_settle_operation>::value:
+      {
+         const auto& o = op.get<asset_settle_operation>();
+         if (o.account == account_id)
+            sums[o.amount.asset_id].debits += o.amount.amount;
+         break;
+      }
+      case operation::tag<withdraw_permission_claim_operation>::value:
+      {
+         const auto& o = op.get<withdraw_permission_claim_operation>();
+         if (o.withdraw_from_account == account_id)
+            sums[o.amount_to_withdraw.asset_id].debits += o.amount_to_withdraw.amount;
+         if (o.withdraw_to_account == account_id)
+            sums[o.amount_to_withdraw.asset_id].credits += o.amount_to_withdraw.amount;
+         break;
+      }
+      case operation::tag<vesting_balance_create_operation>::value:
+      {
+         const auto& o = op.get<vesting_balance_create_operation>();
+         if (o.creator == account_id)
+            sums[o.amount.asset_id].debits += o.amount.amount;
+         break;
+      }
+      case operation::tag<vesting_balance_withdraw_operation>::value:
+      {
+         const auto& o = op.get<vesting_balance_withdraw_operation>();
+         if (o.owner == account_id)
+            sums[o.amount.asset_id].credits += o.amount.amount;
+         break;
+      }
+      case operation::tag<balance_claim_operation>::value:
+      {
+         const auto& o = op.get<balance_claim_operation>();
+         if (o.deposit_to_account == account_id)
+            sums[o.total_claimed.asset_id].credits += o.total_claimed.amount;
+         break;
+      }
+      case operation::tag<override_transfer_operation>::value:
+      {
+         const auto& o = op.get<override_transfer_operation>();
+         if (o.from == account_id)
+            sums[o.amount.asset_id].debits += o.amount.amount;
+         if (o.to == account_id)
+            sums[o.amount.asset_id].credits += o.amount.amount;
+         break;
+      }
+      case operation::tag<transfer_to_blind_operation>::value:
+      {
+         const auto& o = op.get<transfer_to_blind_operation>();
+         if (o.from == account_id)
+            sums[o.amount.asset_id].debits += o.amount.amount;
+         break;
+      }
+      case operation::tag<transfer_from_blind_operation>::value:
+      {
+         const auto& o = op.get<transfer_from_blind_operation>();
+         if (o.to == account_id)
+            sums[o.amount.asset_id].credits += o.amount.amount;
+         break;
+      }
+      case operation::tag<asset_settle_cancel_operation>::value: // VIRTUAL
+      {
+         const auto& o = op.get<asset_settle_cancel_operation>();
+         if (o.account == account_id)
+            sums[o.amount.asset_id].credits += o.amount.amount;
+         break;
+      }
+      case operation::tag<asset_claim_fees_operation>::value:
+      {
+         const auto& o = op.get<asset_claim_fees_operation>();
+         if (o.issuer == account_id)
+            sums[o.amount_to_claim.asset_id].credits += o.amount_to_claim.amount;
+         break;
+      }
+      case operation::tag<bid_collateral_operation>::value:
+      {
+         const auto& o = op.get<bid_collateral_operation>();
+         if (o.bidder == account_id)
+            sums[o.additional_collateral.asset_id].debits += o.additional_collateral.amount;
+         break;
+      }
+      case operation::tag<execute_bid_operation>::value: // VIRTUAL
+      {
+         const auto& o = op.get<execute_bid_operation>();
+         if (o.bidder == account_id)
+            sums[o.debt.asset_id].credits += o.debt.amount;
+         break;
+      }
+      case operation::tag<asset_claim_pool_operation>::value:
+      {
+         const auto& o = op.get<asset_claim_pool_operation>();
+         if (o.issuer == account_id)
+            sums[o.amount_to_claim.asset_id].credits += o.amount_to_claim.amount;
+         break;
+      }
+      default: // These don't modify balances directly.
+         // account_create_operation
+         // account_update_operation
+         // account_whitelist_operation
+         // account_upgrade_operation
+         // account_transfer_operation
+         // asset_create_operation
+         // asset_update_operation
+         // asset_update_bitasset_operation
+         // asset_update_feed_producers_operation
+         // asset_global_settle_operation
+         // asset_publish_feed_operation
+         // witness_create_operation
+         // witness_update_operation
+         // proposal_create_operation
+         // proposal_update_operation
+         // proposal_delete_operation
+         // withdraw_permission_create_operation
+         // withdraw_permission_update_operation
+         // withdraw_permission_delete_operation
+         // committee_member_create_operation
+         // committee_member_update_operation
+         // committee_member_update_global_parameters_operation
+         // worker_create_operation
+         // custom_operation
+         // assert_operation
+         // blind_transfer_operation
+         // fba_distribute_operation // VIRTUAL
+         // asset_update_issuer_operation
+         break;
+   }
+   op.visit(fee_summary_visitor(account_id, sums));
+}
+
+} } // graphene::account_archive
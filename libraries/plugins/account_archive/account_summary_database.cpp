@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2019 01 People, s.r.o. (01 CryptoHouse).
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/account_archive/account_summary_database.hpp>
+
+#include <fc/exception/exception.hpp>
+
+namespace graphene { namespace account_archive {
+
+/**
+ * The totals wrap around like unsigned integers do, so differences stay exact
+ * even if the totals of a very busy account exceeded the range of int64_t.
+ */
+struct account_summary_database::entry
+{
+    uint32_t num_operations = 0;
+    uint32_t reserved = 0;
+    uint64_t credits = 0;
+    uint64_t debits = 0;
+    uint64_t fees = 0;
+};
+
+static const uint64_t chunk_bytes = account_summary_database::chunk_size * 32;
+
+void account_summary_database::open(const fc::path& dir)
+{ try {
+    static_assert(sizeof(entry) == 32, "Unexpected padding of the running totals.");
+    const auto dbdir = dir / "account_summary_database";
+    fc::create_directories(dbdir);
+    _chunks.open(dbdir / "chunks");
+    // the last chunk may be written only partially
+    _next_chunk = static_cast<uint32_t>((_chunks.size() + chunk_bytes - 1) / chunk_bytes);
+} FC_CAPTURE_AND_RETHROW((dir)) }
+
+void account_summary_database::close()
+{
+    _chunks.close();
+    _next_chunk = 0;
+    _free_chunks.clear();
+}
+
+void account_summary_database::flush()
+{
+    _chunks.flush();
+}
+
+void account_summary_database::wipe(const fc::path& dir)
+{
+    if (_chunks.is_open())
+        close();
+    fc::remove_all(dir / "account_summary_database");
+}
+
+void account_summary_database::clear()
+{
+    FC_ASSERT(_chunks.is_open());
+    _chunks.resize(0);
+    _next_chunk = 0;
+    _free_chunks.clear();
+}
+
+void account_summary_database::append(account_archive_object& archive, const flat_map<asset_id_type, account_summary>& changes)
+{
+    for (const auto& change : changes) {
+        auto& list = archive.summaries[change.first];
+
+        // the previous totals are taken from the list, they may not be flushed to the file yet
+        entry e;
+        e.num_operations = archive.num_operations;
+        e.credits = list.credits + static_cast<uint64_t>(change.second.credits.value);
+        e.debits = list.debits + static_cast<uint64_t>(change.second.debits.value);
+        e.fees = list.fees + static_cast<uint64_t>(change.second.fees.value);
+
+        const uint32_t index = list.num_entries;
+        const uint32_t chunk = index / chunk_size;
+        // chunks of undone entries are kept and reused
+        if (chunk >= list.chunks.size()) {
+            FC_ASSERT(chunk == list.chunks.size());
+            list.chunks.push_back(allocate_chunk());
+        }
+        _chunks.write(list.chunks[chunk] * chunk_bytes + (index % chunk_size) * sizeof(entry), e);
+        list.num_entries++;
+        list.credits = e.credits;
+        list.debits = e.debits;
+        list.fees = e.fees;
+    }
+}
+
+account_summary account_summary_database::get(const account_archive_object& archive, asset_id_type asset_id, uint32_t first, uint32_t end) const
+{
+    account_summary result;
+    result.asset_id = asset_id;
+
+    const auto& finder = archive.summaries.find(asset_id);
+    if ((finder == archive.summaries.end()) || (first >= end))
+        return result;
+
+    const entry from = totals(finder->second, first);
+    const entry to = totals(finder->second, end);
+    result.credits = static_cast<int64_t>(to.credits - from.credits);
+    result.debits = static_cast<int64_t>(to.debits - from.debits);
+    result.fees = static_cast<int64_t>(to.fees - from.fees);
+    return result;
+}
+
+void account_summary_database::release(const account_archive_object& archive)
+{
+    for (const auto& list : archive.summaries)
+        _free_chunks.insert(_free_chunks.end(), list.second.chunks.begin(), list.second.chunks.end());
+}
+
+uint32_t account_summary_database::allocate_chunk()
+{
+    if (_free_chunks.empty())
+        return _next_chunk++;
+    const uint32_t chunk = _free_chunks.back();
+    _free_chunks.pop_back();
+    return chunk;
+}
+
+bool account_summary_database::read(const account_archive_object::summary_list& list, uint32_t index, entry& e) const
+{
+    const uint32_t chunk = index / chunk_size;
+    return _chunks.read(list.chunks[chunk] * chunk_bytes + (index % chunk_size) * sizeof(entry), e);
+}
+
+account_summary_database::entry account_summary_database::totals(const account_archive_object::summary_list& list, uint32_t end) const
+{
+    // find the last entry covering no more than 'end' operations
+    uint32_t begin = 0;
+    uint32_t count = list.num_entries;
+    entry result, e;
+    while (begin < count) {
+        const uint32_t pivot = (begin + count) >> 1;
+        FC_ASSERT(read(list, pivot, e), "Account summary is not stored completely");
+        if (e.num_operations <= end) {
+            result = e;
+            begin = pivot + 1;
+        } else {
+            count = pivot;
+        }
+    }
+    return result;
+}
+
+} } // graphene::account_archive
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2019 01 People, s.r.o. (01 CryptoHouse).
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <graphene/account_archive/block_time_index.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace account_archive {
+
+void block_time_index::open(const fc::path& dir)
+{ try {
+    const auto dbdir = dir / "block_time_index";
+    fc::create_directories(dbdir);
+    _timestamps.open(dbdir / "timestamps");
+
+    // records of blocks popped before a restart are dropped by the owner recording its head block
+    const uint32_t count = static_cast<uint32_t>(_timestamps.size() / sizeof(uint32_t));
+    _next_block_count = count;
+    _block_count.store(count);
+} FC_CAPTURE_AND_RETHROW((dir)) }
+
+void block_time_index::close()
+{
+    _timestamps.close();
+    _next_block_count = 0;
+    _block_count.store(0);
+}
+
+void block_time_index::flush()
+{
+    _timestamps.flush();
+    _block_count.store(_next_block_count);
+}
+
+void block_time_index::wipe(const fc::path& dir)
+{
+    if (_timestamps.is_open())
+        close();
+    fc::remove_all(dir / "block_time_index");
+}
+
+void block_time_index::set(uint32_t block_num, fc::time_point_sec timestamp)
+{
+    FC_ASSERT(block_num > 0);
+    _timestamps.write(block_num * sizeof(uint32_t), timestamp.sec_since_epoch());
+    _next_block_count = block_num + 1;
+}
+
+void block_time_index::truncate(uint32_t block_count)
+{
+    if (_timestamps.size() > uint64_t(block_count) * sizeof(uint32_t))
+        _timestamps.truncate(uint64_t(block_count) * sizeof(uint32_t));
+    _next_block_count = std::min(_next_block_count, block_count);
+    if (_block_count.load() > block_count)
+        _block_count.store(block_count);
+}
+
+fc::optional<fc::time_point_sec> block_time_index::get(uint32_t block_num) const
+{
+    uint32_t ts = 0;
+    if (!block_num || (block_num >= get_block_count()) || !_timestamps.read(block_num * sizeof(uint32_t), ts) || !ts)
+        return fc::optional<fc::time_point_sec>();
+    return fc::time_point_sec(ts);
+}
+
+uint32_t block_time_index::lower_bound(fc::time_point_sec time) const
+{
+    const uint32_t count = get_block_count();
+    if (count < 2)
+        return count;
+
+    // block 0 does not exist, the records start at 1
+    const auto records = _timestamps.map(sizeof(uint32_t), (count - 1) * sizeof(uint32_t));
+    FC_ASSERT(records);
+    const auto begin = reinterpret_cast<const uint32_t*>(records.get());
+    const auto end = begin + (count - 1);
+    return 1 + static_cast<uint32_t>(std::lower_bound(begin, end, time.sec_since_epoch()) - begin);
+}
+
+} } // graphene::account_archive
@@ -28,6 +28,9 @@
 
 #include <graphene/chain/operation_archive_object.hpp>
 #include <graphene/account_archive/operation_database.hpp>
+#include <graphene/account_archive/block_time_index.hpp>
+#include <graphene/account_archive/account_operation_database.hpp>
+#include <graphene/account_archive/account_summary_database.hpp>
 
 #include <fc/thread/future.hpp>
 
@@ -62,11 +65,19 @@ namespace detail
          std::string plugin_name() const override;
          void plugin_initialize(const boost::program_options::variables_map& options) override;
          void plugin_startup() override;
+         void plugin_shutdown() override;
          void plugin_set_program_options(
             boost::program_options::options_description& cli,
             boost::program_options::options_description& cfg) override;
 
          operation_history_object load(uint32_t index) const;
+         vector<operation_history_object> load(uint32_t first, uint32_t count) const;
+         /** @return the first block not older than @p time, or the head block number plus one if there is none */
+         uint32_t                 find_block_by_time(time_point_sec time) const;
+         /** @return the id of the @p index th operation archived for the account */
+         operation_archive_id_type get_account_operation(const account_archive_object& archive, uint32_t index) const;
+         /** @return the summary of the balance changes caused by the account's operations with indices in [@p first, @p end) */
+         account_summary           get_account_summary(const account_archive_object& archive, asset_id_type asset_id, uint32_t first, uint32_t end) const;
 
          friend class detail::account_archive_plugin_impl;
          std::unique_ptr<detail::account_archive_plugin_impl> impl;
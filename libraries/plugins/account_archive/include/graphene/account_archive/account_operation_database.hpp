@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2019 01 People, s.r.o. (01 CryptoHouse).
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/filesystem.hpp>
+
+#include <graphene/chain/mapped_file.hpp>
+#include <graphene/chain/operation_archive_object.hpp>
+
+namespace graphene { namespace account_archive {
+    using namespace chain;
+
+    /**
+     * @brief On-disk storage of the per-account lists of archived operations.
+     *
+     * Every list is split into fixed-size chunks of a single, memory mapped, append-only file.
+     * The @ref account_archive_object only keeps the number of its operations and the positions
+     * of its chunks, so the RAM needed by an account does not grow with its history, and the
+     * object_database does not save and reload the whole history on every flush / startup.
+     * The operating system's page cache keeps the chunks of the recently used accounts in RAM.
+     *
+     * Undo works like before: the @ref account_archive_object remembers the number of operations
+     * only, and operations appended after an undo simply overwrite the undone ones. The chunks of
+     * an archive which is removed, because the block creating it was undone, are released for reuse.
+     */
+    class account_operation_database
+    {
+        public:
+
+        /** Number of operation ids stored in one chunk. */
+        static const uint32_t chunk_size = 64;
+
+        void open(const fc::path& dir);
+        void close();
+        void flush();
+        void wipe(const fc::path& dir);
+        /** Drops all the lists, e.g. when the archive is being rebuilt from the genesis. */
+        void clear();
+
+        /** Appends an operation to the account's list. Shall be called within database::modify() of @p archive. */
+        void                      append(account_archive_object& archive, operation_archive_id_type operation);
+        operation_archive_id_type get(const account_archive_object& archive, uint32_t index) const;
+        /** Releases the chunks of an archive removed from the database, they are reused by later appends. */
+        void                      release(const account_archive_object& archive);
+
+        private:
+
+        uint32_t    allocate_chunk();
+
+        mapped_file           _chunks;
+        uint32_t              _next_chunk = 0;
+        /** chunks released by removed archives, reused before the file is extended */
+        std::vector<uint32_t> _free_chunks;
+    };
+
+} } // graphene::account_archive
@@ -23,6 +23,8 @@
  */
 #pragma once
 
+#include <graphene/chain/operation_history_object.hpp>
+
 namespace graphene { namespace account_archive {
    using namespace chain;
 
@@ -34,6 +36,12 @@ struct account_summary
    share_type fees; // paid
 };
 
+/**
+ * Adds the balance changes of @p account_id caused by the operation to @p sums, per asset.
+ * Operations which don't modify balances directly only contribute their fee, if paid by the account.
+ */
+void summarize_operation(account_id_type account_id, const operation_history_object& oho, flat_map<asset_id_type, account_summary>& sums);
+
 } } // graphene::account_archive
 
 FC_REFLECT( graphene::account_archive::account_summary, (asset_id)(debits)(credits)(fees) )
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2019 01 People, s.r.o. (01 CryptoHouse).
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/filesystem.hpp>
+
+#include <graphene/chain/mapped_file.hpp>
+#include <graphene/chain/operation_archive_object.hpp>
+#include <graphene/account_archive/account_summary.hpp>
+
+namespace graphene { namespace account_archive {
+    using namespace chain;
+
+    /**
+     * @brief On-disk storage of the running totals of the balance changes per account and asset.
+     *
+     * Whenever an archived operation changes a balance of an account, the totals of the asset
+     * over all the account's operations so far are appended to the (account, asset) list, tagged
+     * with the number of the account's operations they cover. A summary of any range of the
+     * account's operations is the difference of two running totals, found by binary search.
+     *
+     * The lists are stored in chunks the same way as in the @ref account_operation_database,
+     * and undo works the same way too: the @ref account_archive_object remembers the number of
+     * entries of every list and its last totals only, and entries appended after an undo overwrite
+     * the undone ones. The last totals are kept in the object, so appending never reads the file.
+     */
+    class account_summary_database
+    {
+        public:
+
+        /** Number of running totals stored in one chunk. */
+        static const uint32_t chunk_size = 32;
+
+        void open(const fc::path& dir);
+        void close();
+        void flush();
+        void wipe(const fc::path& dir);
+        /** Drops all the lists, e.g. when the archive is being rebuilt from the genesis. */
+        void clear();
+
+        /**
+         * Adds the balance changes of the account's last archived operation to the running totals.
+         * Shall be called within database::modify() of @p archive, after the operation was appended.
+         */
+        void append(account_archive_object& archive, const flat_map<asset_id_type, account_summary>& changes);
+        /** @return the summary of the account's operations with indices in [@p first, @p end) */
+        account_summary get(const account_archive_object& archive, asset_id_type asset_id, uint32_t first, uint32_t end) const;
+        /** Releases the chunks of an archive removed from the database, they are reused by later appends. */
+        void release(const account_archive_object& archive);
+
+        private:
+
+        struct entry;
+
+        bool read(const account_archive_object::summary_list& list, uint32_t index, entry& e) const;
+        /** @return the running totals of the operations with indices lower than @p end */
+        entry totals(const account_archive_object::summary_list& list, uint32_t end) const;
+
+        uint32_t    allocate_chunk();
+
+        mapped_file           _chunks;
+        uint32_t              _next_chunk = 0;
+        /** chunks released by removed archives, reused before the file is extended */
+        std::vector<uint32_t> _free_chunks;
+    };
+
+} } // graphene::account_archive
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2019 01 People, s.r.o. (01 CryptoHouse).
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/filesystem.hpp>
+#include <fc/optional.hpp>
+#include <fc/time.hpp>
+
+#include <graphene/chain/mapped_file.hpp>
+
+namespace graphene { namespace account_archive {
+    using namespace chain;
+
+    /**
+     * @brief A dense block_num -> timestamp array, stored in a memory mapped file.
+     *
+     * Block timestamps grow monotonically with block numbers, so a time bound of an archive query
+     * translates into a block number bound by a single binary search over this array, instead of
+     * loading a block header for every step of a search over the operations.
+     *
+     * Records of popped blocks are dropped logically by recording a block with a lower number, or
+     * by truncate() when the owner reconciles with a chain head; readers never see past the last
+     * flushed record.
+     */
+    class block_time_index
+    {
+        public:
+
+        void open(const fc::path& dir);
+        void close();
+        void flush();
+        void wipe(const fc::path& dir);
+
+        /** Records the timestamp of a block, dropping the records of all blocks after it. */
+        void                          set(uint32_t block_num, fc::time_point_sec timestamp);
+        /** Drops the records of all blocks from @p block_count on. */
+        void                          truncate(uint32_t block_count);
+        fc::optional<fc::time_point_sec> get(uint32_t block_num) const;
+        /** @return the first recorded block not older than @p time, or get_block_count() if there is none */
+        uint32_t                      lower_bound(fc::time_point_sec time) const;
+        /** @return the number of the last recorded block plus one */
+        uint32_t                      get_block_count() const { return _block_count.load(); }
+
+        private:
+
+        mapped_file           _timestamps;
+        uint32_t              _next_block_count = 0;
+        std::atomic<uint32_t> _block_count{0};
+    };
+
+} } // graphene::account_archive
@@ -23,15 +23,27 @@
  */
 #pragma once
 
-#include <fstream>
 #include <fc/filesystem.hpp>
 
 #include <graphene/protocol/operations.hpp>
+#include <graphene/chain/mapped_file.hpp>
 #include <graphene/chain/operation_history_object.hpp>
 
+#include <atomic>
+
 namespace graphene { namespace account_archive {
     using namespace chain;
 
+    /**
+     * Stores operations in an append-only file, with a file of fixed size entries indexing them.
+     *
+     * A single writer appends through the buffers of the files, the stored operations become
+     * visible to readers on flush(). Readers access the mapped files and take no lock (but when
+     * the mapping has to grow), the number of readable operations is tracked in memory.
+     *
+     * Truncating drops the tail of both files, the following stores overwrite it. A reader which
+     * raced with the truncation notices it and fails as if it had asked for a dropped operation.
+     */
     class operation_database
     {
         public:
@@ -41,25 +53,38 @@ namespace graphene { namespace account_archive {
 
         void open(const fc::path& dir);
         void close();
+        /** Publishes the stored operations to readers. */
         void flush();
         void wipe(const fc::path& dir);
 
         operation_history_object load(uint32_t index) const;
+        /** Loads @p count operations starting at @p first, reading consecutive records together. */
+        vector<operation_history_object> load(uint32_t first, uint32_t count) const;
         uint32_t                 store(const operation_history_object& oho);
+        /** Drops the operations of the blocks from @p block_num on. */
         void                     truncate(uint32_t block_num);
-        uint32_t                 get_stored_operation_count() const { return _next_index; }
+        /** @return the number of operations visible to readers */
+        uint32_t                 get_stored_operation_count() const { return _stored_count.load(); }
 
         private:
 
-        mutable std::fstream _indices;
-        mutable std::fstream _operations;
+        mapped_file _indices;
+        mapped_file _operations;
 
+        /** the index of the next operation to be stored */
         uint32_t _next_index;
+        /** the block of the last stored operation */
         uint32_t _last_block_num;
+        /** the lowest block accepted by store(), operations are stored in block order since opening */
+        uint32_t _min_block_num;
+
+        std::atomic<uint32_t> _stored_count{0};
+        /** incremented by every truncation, before any dropped record is overwritten */
+        std::atomic<uint64_t> _truncations{0};
 
         bool     is_open() const;
         void     load_index();
-        uint32_t get_block_num(uint32_t index);
+        void     drop_tail(uint32_t count);
     };
 
 } } // graphene::account_archive
@@ -36,7 +36,7 @@ struct index_entry
     uint32_t nbytes;
     uint32_t block_num;
 
-    inline bool operator==(const index_entry& e)
+    inline bool operator==(const index_entry& e) const
     {
         return offset == e.offset
             && nbytes == e.nbytes
@@ -44,6 +44,7 @@ struct index_entry
     }
 };
 
+// former versions invalidated the entries of undone blocks instead of truncating the files
 const struct index_entry stop_entry =
 {
     0xffffffffffffffff,
@@ -55,6 +56,7 @@ operation_database::operation_database()
 {
     _next_index = 0xffffffff;
     _last_block_num = 0xffffffff;
+    _min_block_num = 0xffffffff;
 }
 
 operation_database::~operation_database()
@@ -68,35 +70,31 @@ void operation_database::open(const fc::path& dir)
     const auto dbdir = dir / "operation_database";
     const auto indices_path = dbdir / "indices";
     const auto operations_path = dbdir / "operations";
-    const auto exception_flags = std::ios_base::failbit | std::ios_base::badbit;
-    const auto filestream_flags = std::fstream::binary | std::fstream::in | std::fstream::out;
 
     fc::create_directories(dbdir);
-    _indices.exceptions(exception_flags);
-    _operations.exceptions(exception_flags);
-
-    if (!fc::exists(indices_path)) {
-        _indices.open(indices_path.generic_string().c_str(), filestream_flags | std::fstream::trunc);
-        _operations.open(operations_path.generic_string().c_str(), filestream_flags | std::fstream::trunc);
-    } else {
-        _indices.open(indices_path.generic_string().c_str(), filestream_flags);
-        _operations.open(operations_path.generic_string().c_str(), filestream_flags);
-    }
+    const bool create = !fc::exists(indices_path);
+    _indices.open(indices_path, create);
+    _operations.open(operations_path, create);
 
     load_index();
 } FC_CAPTURE_AND_RETHROW((dir)) }
 
 void operation_database::close()
 {
+    _stored_count.store(0);
     _indices.close();
     _operations.close();
-    operation_database();
+    _next_index = 0xffffffff;
+    _last_block_num = 0xffffffff;
+    _min_block_num = 0xffffffff;
 }
 
 void operation_database::flush()
 {
-    _indices.flush();
+    // an operation is visible once its index entry is
     _operations.flush();
+    _indices.flush();
+    _stored_count.store(_next_index);
 }
 
 void operation_database::wipe(const fc::path& dir)
@@ -108,78 +106,125 @@ void operation_database::wipe(const fc::path& dir)
 
 operation_history_object operation_database::load(uint32_t index) const
 {
-    _indices.seekg(0, _indices.end);
-    const auto indices_toldg = static_cast<size_t>(_indices.tellg());
-    const auto offset = index * sizeof(index_entry);
-    if ((index >= _next_index) || (indices_toldg < offset + sizeof(index_entry))) {
+    const auto truncations = _truncations.load();
+    if (index >= _stored_count.load()) {
         FC_THROW_EXCEPTION(fc::key_not_found_exception, "Virtual operations database does not hold index ${index}", ("index",index));
     }
 
     index_entry e;
-    _indices.seekg(offset);
-    _indices.read((char*)&e, sizeof(e));
-
-    if (e == stop_entry || !e.nbytes) {
+    if (!_indices.read(uint64_t(index) * sizeof(index_entry), e) || e == stop_entry || !e.nbytes) {
         FC_THROW_EXCEPTION(fc::key_not_found_exception, "Virtual operations database does not contain correct data at index ${index}", ("index",index));
     }
 
-    _operations.seekg(0, _operations.end);
-    const auto operations_toldg = static_cast<uint64_t>(_operations.tellg());
-    if (operations_toldg < e.offset + e.nbytes) {
-        FC_ASSERT(operations_toldg >= e.offset + e.nbytes);
+    const auto record = _operations.map(e.offset, e.nbytes);
+    if (!record) {
         FC_THROW_EXCEPTION(fc::key_not_found_exception, "Virtual operations database does not hold the operation indexed ${index}", ("index", index));
     }
+    const vector<char> data(record.get(), record.get() + e.nbytes);
 
-    vector<char> data(e.nbytes);
-    _operations.seekg(e.offset);
-    _operations.read(data.data(), data.size());
+    // the record may have been overwritten while it was copied
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (_truncations.load() != truncations) {
+        FC_THROW_EXCEPTION(fc::key_not_found_exception, "Virtual operations database dropped index ${index} while it was loaded", ("index", index));
+    }
     return fc::raw::unpack<operation_history_object>(data);
 }
 
-uint32_t operation_database::store(const operation_history_object& oho)
+vector<operation_history_object> operation_database::load(uint32_t first, uint32_t count) const
 {
-    FC_ASSERT(oho.block_num >= _last_block_num);
+    vector<operation_history_object> result;
+    if (!count)
+        return result;
+
+    const auto truncations = _truncations.load();
+    const auto entries_data = uint64_t(first) + count <= _stored_count.load()
+                            ? _indices.map(uint64_t(first) * sizeof(index_entry), uint64_t(count) * sizeof(index_entry))
+                            : std::shared_ptr<const char>();
+    if (!entries_data) {
+        FC_THROW_EXCEPTION(fc::key_not_found_exception, "Virtual operations database does not hold indices ${first} to ${last}",
+                           ("first", first)("last", uint64_t(first) + count - 1));
+    }
+    const auto entries_begin = reinterpret_cast<const index_entry*>(entries_data.get());
+    const vector<index_entry> entries(entries_begin, entries_begin + count);
+
+    // operations stored one after another are copied together, the runs only break where the
+    // database was truncated and written again
+    vector<char> data;
+    for (uint32_t i = 0; i < count; ) {
+        uint32_t j = i;
+        uint64_t run_end = entries[i].offset;
+        for (; j < count; ++j) {
+            const auto& e = entries[j];
+            if (e == stop_entry || !e.nbytes) {
+                FC_THROW_EXCEPTION(fc::key_not_found_exception, "Virtual operations database does not contain correct data at index ${index}", ("index", first + j));
+            }
+            if (e.offset != run_end)
+                break;
+            run_end += e.nbytes;
+        }
+
+        const auto run = _operations.map(entries[i].offset, run_end - entries[i].offset);
+        if (!run) {
+            FC_THROW_EXCEPTION(fc::key_not_found_exception, "Virtual operations database does not hold the operation indexed ${index}", ("index", first + j - 1));
+        }
+        data.insert(data.end(), run.get(), run.get() + (run_end - entries[i].offset));
+        i = j;
+    }
+
+    // the records may have been overwritten while they were copied
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (_truncations.load() != truncations) {
+        FC_THROW_EXCEPTION(fc::key_not_found_exception, "Virtual operations database dropped indices ${first} to ${last} while they were loaded",
+                           ("first", first)("last", uint64_t(first) + count - 1));
+    }
+
+    result.reserve(count);
+    fc::datastream<const char*> ds(data.data(), data.size());
+    for (uint32_t i = 0; i < count; ++i) {
+        result.emplace_back();
+        fc::raw::unpack(ds, result.back());
+    }
+    return result;
+}
 
-    _indices.seekp(0, _indices.end);
-    _operations.seekp(0, _operations.end);
+uint32_t operation_database::store(const operation_history_object& oho)
+{
+    FC_ASSERT(oho.block_num >= _min_block_num);
 
     const auto packed = fc::raw::pack(oho);
     index_entry e = {};
 
-    e.offset = _operations.tellp();
+    e.offset = _operations.append(packed.data(), packed.size());
     e.nbytes = packed.size();
     e.block_num = oho.block_num;
-
-    _indices.write((const char*)&e, sizeof(e));
-    _operations.write(packed.data(), packed.size());
+    _indices.append((const char*)&e, sizeof(e));
 
     _last_block_num = oho.block_num;
+    _min_block_num = oho.block_num;
     return _next_index++;
 }
 
 void operation_database::truncate(uint32_t block_num)
 {
-    // The standard C++ libraries do not support truncating
-    // a file before the C++17 standard. While the Boost does
-    // provide such feature, the truncated data will be small
-    // and the databases will grow further anyway. From both
-    // the implementation and the performance perspectives,
-    // it is a better solution to just invalidate the tail.
-
     FC_ASSERT(is_open());
 
-    auto i = _next_index;
-    while (i) {
-        const auto b = get_block_num(--i);
-        if (b < block_num) {
-            _next_index = ++i;
+    // nothing to drop, e.g. while replaying
+    if (!_next_index || _last_block_num < block_num)
+        return;
+
+    // the entries to drop are at the end, possibly not flushed yet
+    _operations.flush();
+    _indices.flush();
+
+    uint32_t count = _next_index;
+    index_entry e;
+    while (count) {
+        FC_ASSERT(_indices.read(uint64_t(count - 1) * sizeof(index_entry), e));
+        if (e.block_num < block_num)
             break;
-        } else {
-            _indices.seekp(i * sizeof(index_entry));
-            _indices.write((const char*)&stop_entry, sizeof(stop_entry));
-        }
+        --count;
     }
-    load_index();
+    drop_tail(count);
 }
 
 bool operation_database::is_open() const
@@ -189,37 +234,49 @@ bool operation_database::is_open() const
 
 void operation_database::load_index()
 {
-    // Find last valid index_entry stored in the indices file.
+    // Drop the tail not stored completely before a crash, and the entries invalidated by former versions.
 
     FC_ASSERT(is_open());
 
-    _next_index = 0;
-    _last_block_num = 0;
-
-    _indices.seekg(0, _indices.end);
-    const uint32_t toldg = static_cast<uint32_t>(_indices.tellg());
-    _next_index = toldg / sizeof(index_entry);
-    FC_ASSERT(toldg % sizeof(index_entry) == 0);
-
-    if (_next_index) {
-        while (_next_index--) {
-            index_entry e;
-            _indices.seekg(_next_index * sizeof(index_entry));
-            _indices.read((char*)&e, sizeof(e));
-            if (!(e == stop_entry)) {
-                _next_index++;
-                break;
-            }
-        }
+    const uint64_t operations_size = _operations.size();
+    uint32_t count = static_cast<uint32_t>(_indices.size() / sizeof(index_entry));
+    index_entry e = {};
+    while (count) {
+        FC_ASSERT(_indices.read(uint64_t(count - 1) * sizeof(index_entry), e));
+        if (!(e == stop_entry) && e.nbytes && e.offset + e.nbytes <= operations_size)
+            break;
+        --count;
     }
+
+    const uint64_t indices_end = uint64_t(count) * sizeof(index_entry);
+    const uint64_t operations_end = count ? e.offset + e.nbytes : 0;
+    if (_indices.size() != indices_end)
+        _indices.resize(indices_end);
+    if (operations_size != operations_end)
+        _operations.resize(operations_end);
+
+    _next_index = count;
+    _last_block_num = count ? e.block_num : 0;
+    _min_block_num = 0;
+    _stored_count.store(count);
 }
 
-uint32_t operation_database::get_block_num(uint32_t index)
+void operation_database::drop_tail(uint32_t count)
 {
-    index_entry e;
-    _indices.seekg(index * sizeof(index_entry));
-    _indices.read((char*)&e, sizeof(e));
-    return e.block_num;
+    // hide the dropped operations from the readers before their records can be overwritten
+    if (_stored_count.load() > count)
+        _stored_count.store(count);
+    ++_truncations;
+
+    index_entry last = {};
+    if (count)
+        FC_ASSERT(_indices.read(uint64_t(count - 1) * sizeof(index_entry), last));
+    _indices.truncate(uint64_t(count) * sizeof(index_entry));
+    _operations.truncate(count ? last.offset + last.nbytes : 0);
+
+    _next_index = count;
+    _last_block_num = last.block_num;
+    _min_block_num = last.block_num;
 }
 
 } } // graphene::account_archive
@@ -28,11 +28,13 @@
 
 #include <fc/time.hpp>
 
+#include <thread>
+
 namespace graphene { namespace snapshot_plugin {
 
 class snapshot_plugin : public graphene::app::plugin {
    public:
-      ~snapshot_plugin() {}
+      ~snapshot_plugin() { if( writer.joinable() ) writer.join(); }
 
       std::string plugin_name()const override;
       std::string plugin_description()const override;
@@ -48,10 +50,14 @@ class snapshot_plugin : public graphene::app::plugin {
 
    private:
        void check_snapshot( const graphene::chain::signed_block& b);
+       void create_binary_snapshot();
 
        uint32_t           snapshot_block = -1, last_block = 0;
        fc::time_point_sec snapshot_time = fc::time_point_sec::maximum(), last_time = fc::time_point_sec(1);
        fc::path           dest;
+       bool               binary = false;
+       /** writes the last binary snapshot */
+       std::thread        writer;
 };
 
 } } //graphene::snapshot_plugin
@@ -23,6 +23,7 @@
  */
 #include <graphene/snapshot/snapshot.hpp>
 
+#include <graphene/chain/binary_snapshot.hpp>
 #include <graphene/chain/database.hpp>
 
 #include <fc/io/fstream.hpp>
@@ -36,6 +37,7 @@ namespace bpo = boost::program_options;
 static const char* OPT_BLOCK_NUM  = "snapshot-at-block";
 static const char* OPT_BLOCK_TIME = "snapshot-at-time";
 static const char* OPT_DEST       = "snapshot-to";
+static const char* OPT_FORMAT     = "snapshot-format";
 
 void snapshot_plugin::plugin_set_program_options(
    boost::program_options::options_description& command_line_options,
@@ -45,6 +47,8 @@ void snapshot_plugin::plugin_set_program_options(
          (OPT_BLOCK_NUM, bpo::value<uint32_t>(), "Block number after which to do a snapshot")
          (OPT_BLOCK_TIME, bpo::value<string>(), "Block time (ISO format) after which to do a snapshot")
          (OPT_DEST, bpo::value<string>(), "Pathname of JSON file where to store the snapshot")
+         (OPT_FORMAT, bpo::value<string>()->default_value("json"),
+               "Format of the snapshot, json (one object per line) or binary (compressed, written in the background)")
          ;
    config_file_options.add(command_line_options);
 }
@@ -71,6 +75,12 @@ void snapshot_plugin::plugin_initialize(const boost::program_options::variables_
          snapshot_block = options[OPT_BLOCK_NUM].as<uint32_t>();
       if( options.count(OPT_BLOCK_TIME) )
          snapshot_time = fc::time_point_sec::from_iso_string( options[OPT_BLOCK_TIME].as<std::string>() );
+      if( options.count(OPT_FORMAT) )
+      {
+         const std::string format = options[OPT_FORMAT].as<std::string>();
+         FC_ASSERT( format == "json" || format == "binary", "Unknown snapshot-format ${f}", ("f",format) );
+         binary = ( format == "binary" );
+      }
       database().applied_block.connect( [&]( const graphene::chain::signed_block& b ) {
          check_snapshot( b );
       });
@@ -82,7 +92,11 @@ void snapshot_plugin::plugin_initialize(const boost::program_options::variables_
 
 void snapshot_plugin::plugin_startup() {}
 
-void snapshot_plugin::plugin_shutdown() {}
+void snapshot_plugin::plugin_shutdown()
+{
+   if( writer.joinable() )
+      writer.join();
+}
 
 static void create_snapshot( const graphene::chain::database& db, const fc::path& dest )
 {
@@ -97,32 +111,49 @@ static void create_snapshot( const graphene::chain::database& db, const fc::path
       wlog( "Failed to open snapshot destination: ${ex}", ("ex",e) );
       return;
    }
-   for( uint32_t space_id = 0; space_id < 256; space_id++ )
-      for( uint32_t type_id = 0; type_id < 256; type_id++ )
-      {
-         try
-         {
-            db.get_index( (uint8_t)space_id, (uint8_t)type_id );
-         }
-         catch (fc::assert_exception& e)
-         {
-            continue;
-         }
-         auto& index = db.get_index( (uint8_t)space_id, (uint8_t)type_id );
-         index.inspect_all_objects( [&out]( const graphene::db::object& o ) {
-            out << fc::json::to_string( o.to_variant() ) << '\n';
-         });
-      }
+   db.inspect_all_indexes( [&out]( const graphene::db::index& index ) {
+      index.inspect_all_objects( [&out]( const graphene::db::object& o ) {
+         out << fc::json::to_string( o.to_variant() ) << '\n';
+      });
+   });
    out.close();
    ilog("snapshot plugin: created snapshot");
 }
 
+void snapshot_plugin::create_binary_snapshot()
+{
+   if( writer.joinable() )
+      writer.join();
+   // blocks are applied again once the indexes are packed, compressing and writing them runs meanwhile
+   ilog("snapshot plugin: creating binary snapshot");
+   auto snapshot = std::make_shared<graphene::chain::binary_snapshot_writer>( database() );
+   ilog( "snapshot plugin: packed the state at block ${n}", ("n", snapshot->header().block_num) );
+   const fc::path to = dest;
+   writer = std::thread( [snapshot,to]() {
+      try
+      {
+         snapshot->write( to );
+         ilog( "snapshot plugin: created snapshot of block ${n} with state hash ${h}",
+               ("n", snapshot->header().block_num)("h", snapshot->header().state_hash) );
+      }
+      catch( const fc::exception& e )
+      {
+         elog( "Failed to write snapshot: ${ex}", ("ex", e.to_detail_string()) );
+      }
+   });
+}
+
 void snapshot_plugin::check_snapshot( const graphene::chain::signed_block& b )
 { try {
     uint32_t current_block = b.block_num();
     if( (last_block < snapshot_block && snapshot_block <= current_block)
            || (last_time < snapshot_time && snapshot_time <= b.timestamp) )
-       create_snapshot( database(), dest );
+    {
+       if( binary )
+          create_binary_snapshot();
+       else
+          create_snapshot( database(), dest );
+    }
     last_block = current_block;
     last_time = b.timestamp;
 } FC_LOG_AND_RETHROW() }
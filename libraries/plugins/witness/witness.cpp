@@ -373,7 +373,10 @@ block_production_condition::block_production_condition_enum witness_plugin::mayb
       _production_skip_flags
       );
    capture("n", block.block_num())("t", block.timestamp)("c", now)("x", block.transactions.size());
-   fc::async( [this,block](){ p2p_node().broadcast(net::block_message(block)); } );
+   fc::async( [this,block](){
+      net::block_message block_msg( block );
+      p2p_node().broadcast( block_msg, block_msg.block_id );
+   } );
 
    return block_production_condition::produced;
 }
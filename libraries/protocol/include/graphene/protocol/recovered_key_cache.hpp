@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/protocol/types.hpp>
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace graphene { namespace protocol {
+
+   /**
+    *  A bounded cache of the public keys recovered from compact signatures, shared by all threads of
+    *  the process. Entries are keyed by the signed digest and the signature, so a transaction received
+    *  from the network and then in a block has its signatures recovered only once. When full, the
+    *  oldest entries are dropped first.
+    */
+   class recovered_key_cache
+   {
+      public:
+         static const size_t default_capacity = 100000;
+
+         /** the cache used by signed_transaction::get_signature_keys() */
+         static recovered_key_cache& instance();
+
+         /** @return the key which made @p signature of @p digest, from the cache or recovered */
+         public_key_type recover( const digest_type& digest, const signature_type& signature );
+
+         /**
+          *  Recovers the keys of many signatures at once, on up to @p threads threads (0 for one per
+          *  core), and adds them to the cache.
+          *  @return the keys, in the order of @p signatures
+          */
+         vector<public_key_type> recover( const vector< std::pair<digest_type, signature_type> >& signatures,
+                                          uint32_t threads = 0 );
+
+         /** Sets the maximum number of cached keys, 0 disables the cache */
+         void   set_capacity( size_t entries );
+         size_t capacity()const { return _shard_capacity * shard_count; }
+         size_t size()const;
+         void   clear();
+
+      private:
+         struct key_type
+         {
+            digest_type    digest;
+            signature_type signature;
+            bool operator==( const key_type& other )const;
+         };
+         struct key_hash
+         {
+            size_t operator()( const key_type& key )const;
+         };
+         /** the cache is split into shards with their own lock, so that threads rarely wait for each other */
+         struct shard
+         {
+            mutable std::mutex                                        mutex;
+            std::unordered_map<key_type, public_key_type, key_hash>  keys;
+            /** the keys in insertion order, for dropping the oldest */
+            std::deque<key_type>                                      order;
+         };
+         static const size_t shard_count = 16;
+
+         shard& shard_of( const key_type& key );
+         void   insert( const key_type& key, const public_key_type& value );
+
+         shard               _shards[shard_count];
+         std::atomic<size_t> _shard_capacity{ default_capacity / shard_count };
+   };
+
+} } // graphene::protocol
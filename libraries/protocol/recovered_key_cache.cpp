@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/protocol/recovered_key_cache.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <thread>
+
+namespace graphene { namespace protocol {
+
+recovered_key_cache& recovered_key_cache::instance()
+{
+   static recovered_key_cache cache;
+   return cache;
+}
+
+bool recovered_key_cache::key_type::operator==( const key_type& other )const
+{
+   return digest == other.digest && signature == other.signature;
+}
+
+size_t recovered_key_cache::key_hash::operator()( const key_type& key )const
+{
+   // the digest is uniformly distributed already
+   uint64_t r;
+   std::memcpy( &r, key.signature.data + 1, sizeof(r) );
+   return size_t( key.digest._hash[0] ^ r );
+}
+
+recovered_key_cache::shard& recovered_key_cache::shard_of( const key_type& key )
+{
+   return _shards[ key.digest._hash[1] % shard_count ];
+}
+
+public_key_type recovered_key_cache::recover( const digest_type& digest, const signature_type& signature )
+{
+   const key_type key{ digest, signature };
+   {
+      shard& s = shard_of( key );
+      std::lock_guard<std::mutex> lock( s.mutex );
+      const auto itr = s.keys.find( key );
+      if( itr != s.keys.end() )
+         return itr->second;
+   }
+   const public_key_type result( fc::ecc::public_key( signature, digest ) );
+   insert( key, result );
+   return result;
+}
+
+vector<public_key_type> recovered_key_cache::recover( const vector< std::pair<digest_type, signature_type> >& signatures,
+                                                       uint32_t threads )
+{
+   // signatures are handed out to the threads in small batches, so that they all finish at about the same time
+   static const size_t batch_size = 16;
+   vector<public_key_type> result( signatures.size() );
+   std::atomic<size_t> next( 0 );
+   const auto recover_batches = [this,&signatures,&result,&next]() {
+      for( size_t begin = next.fetch_add( batch_size ); begin < signatures.size(); begin = next.fetch_add( batch_size ) )
+         for( size_t i = begin; i < std::min( begin + batch_size, signatures.size() ); ++i )
+            result[i] = recover( signatures[i].first, signatures[i].second );
+   };
+
+   if( threads == 0 )
+      threads = std::max( 1u, std::thread::hardware_concurrency() );
+   const size_t num_tasks = std::min<size_t>( threads, ( signatures.size() + batch_size - 1 ) / batch_size );
+   if( num_tasks <= 1 )
+   {
+      recover_batches();
+      return result;
+   }
+
+   vector< std::future<void> > tasks;
+   tasks.reserve( num_tasks );
+   for( size_t i = 0; i < num_tasks; ++i )
+      tasks.push_back( std::async( std::launch::async, recover_batches ) );
+   // all tasks have to be done with the local variables before an exception is passed on
+   for( auto& task : tasks )
+      task.wait();
+   for( auto& task : tasks )
+      task.get();
+   return result;
+}
+
+void recovered_key_cache::insert( const key_type& key, const public_key_type& value )
+{
+   const size_t capacity = _shard_capacity;
+   if( capacity == 0 )
+      return;
+   shard& s = shard_of( key );
+   std::lock_guard<std::mutex> lock( s.mutex );
+   if( !s.keys.emplace( key, value ).second )
+      return;
+   s.order.push_back( key );
+   while( s.order.size() > capacity )
+   {
+      s.keys.erase( s.order.front() );
+      s.order.pop_front();
+   }
+}
+
+void recovered_key_cache::set_capacity( size_t entries )
+{
+   const size_t capacity = ( entries + shard_count - 1 ) / shard_count;
+   _shard_capacity = capacity;
+   for( auto& s : _shards )
+   {
+      std::lock_guard<std::mutex> lock( s.mutex );
+      while( s.order.size() > capacity )
+      {
+         s.keys.erase( s.order.front() );
+         s.order.pop_front();
+      }
+   }
+}
+
+size_t recovered_key_cache::size()const
+{
+   size_t result = 0;
+   for( const auto& s : _shards )
+   {
+      std::lock_guard<std::mutex> lock( s.mutex );
+      result += s.keys.size();
+   }
+   return result;
+}
+
+void recovered_key_cache::clear()
+{
+   for( auto& s : _shards )
+   {
+      std::lock_guard<std::mutex> lock( s.mutex );
+      s.keys.clear();
+      s.order.clear();
+   }
+}
+
+} } // graphene::protocol
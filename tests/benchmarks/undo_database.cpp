@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/account_object.hpp>
+#include <graphene/db/object_database.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+using namespace graphene::chain;
+
+namespace {
+   const account_balance_object& create_balance( graphene::db::object_database& db, uint64_t owner, uint64_t asset )
+   {
+      return db.create<account_balance_object>( [owner,asset]( account_balance_object& b ) {
+         b.owner = account_id_type( owner );
+         b.asset_type = asset_id_type( asset );
+         b.balance = 1000;
+      });
+   }
+}
+
+BOOST_AUTO_TEST_CASE( undo_session_bench )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t sessions = 1000000;
+#else
+      const uint32_t sessions = 100000;
+#endif
+      const uint32_t num_balances = 10000;
+
+      graphene::db::object_database db;
+      db.add_index< graphene::db::primary_index< account_balance_index > >();
+      vector<const account_balance_object*> balances;
+      db._undo_db.disable();
+      for( uint32_t i = 0; i < num_balances; ++i )
+         balances.push_back( &create_balance( db, i, 0 ) );
+      db._undo_db.enable();
+
+      // like _push_transaction: a session touching a few objects, then discarded
+      fc::time_point start_time = fc::time_point::now();
+      for( uint32_t i = 0; i < sessions; ++i )
+      {
+         auto session = db._undo_db.start_undo_session();
+         for( uint32_t j = 0; j < 3; ++j )
+            db.modify( *balances[ ( i * 3 + j ) % num_balances ], []( account_balance_object& b ) { b.balance += 1; } );
+         db.remove( create_balance( db, i, 1 ) );
+         create_balance( db, i, 2 );
+      }
+      auto elapsed = fc::time_point::now() - start_time;
+      ilog( "${n} discarded sessions touching 5 objects in ${t} milliseconds, ${s} ns per session",
+            ("n", sessions)("t", elapsed.count() / 1000)("s", elapsed.count() * 1000 / sessions) );
+
+      // like a block: transaction sessions merged into a block session, which is kept and later popped
+      const uint32_t blocks = sessions / 100;
+      db._undo_db.set_max_size( 10 );
+      start_time = fc::time_point::now();
+      for( uint32_t i = 0; i < blocks; ++i )
+      {
+         auto block_session = db._undo_db.start_undo_session();
+         for( uint32_t t = 0; t < 100; ++t )
+         {
+            auto trx_session = db._undo_db.start_undo_session();
+            for( uint32_t j = 0; j < 3; ++j )
+               db.modify( *balances[ ( i * 300 + t * 3 + j ) % num_balances ],
+                          []( account_balance_object& b ) { b.balance += 1; } );
+            trx_session.merge();
+         }
+         block_session.commit();
+      }
+      elapsed = fc::time_point::now() - start_time;
+      ilog( "${n} blocks of 100 merged sessions in ${t} milliseconds, ${s} ns per merged session",
+            ("n", blocks)("t", elapsed.count() / 1000)("s", elapsed.count() * 10 / blocks) );
+
+      start_time = fc::time_point::now();
+      uint32_t popped = 0;
+      for( ; db._undo_db.size() > 0; ++popped )
+         db.pop_undo();
+      elapsed = fc::time_point::now() - start_time;
+      ilog( "Popped ${n} blocks in ${t} microseconds", ("n", popped)("t", elapsed.count()) );
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
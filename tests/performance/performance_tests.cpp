@@ -29,6 +29,8 @@
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
 
+#include <graphene/protocol/recovered_key_cache.hpp>
+
 #include <graphene/db/simple_index.hpp>
 
 #include <fc/crypto/digest.hpp>
@@ -55,6 +57,39 @@ BOOST_AUTO_TEST_CASE( sigcheck_benchmark )
    wlog( "Benchmark: verify ${sps} signatures/s", ("sps",(cycles*1000000)/elapsed.count()) );
 }
 
+BOOST_AUTO_TEST_CASE( sigcheck_batch_benchmark )
+{
+   fc::ecc::private_key nathan_key = fc::ecc::private_key::generate();
+   const uint64_t count = 20000;
+   vector< std::pair<digest_type, signature_type> > signatures;
+   signatures.reserve( count );
+   for( uint32_t i = 0; i < count; ++i )
+   {
+      const auto digest = fc::sha256::hash( fc::to_string( i ) );
+      signatures.emplace_back( digest, nathan_key.sign_compact( digest ) );
+   }
+   recovered_key_cache cache;
+   cache.set_capacity( count );
+
+   auto start = fc::time_point::now();
+   for( const auto& sig : signatures )
+      fc::ecc::public_key( sig.second, sig.first );
+   auto elapsed = std::max<int64_t>( 1, ( fc::time_point::now() - start ).count() );
+   wlog( "Benchmark: recover ${sps} signatures/s one by one", ("sps",(count*1000000)/elapsed) );
+
+   start = fc::time_point::now();
+   const auto keys = cache.recover( signatures );
+   elapsed = std::max<int64_t>( 1, ( fc::time_point::now() - start ).count() );
+   wlog( "Benchmark: recover ${sps} signatures/s in a batch", ("sps",(count*1000000)/elapsed) );
+   BOOST_CHECK( keys.back() == public_key_type( nathan_key.get_public_key() ) );
+
+   start = fc::time_point::now();
+   for( const auto& sig : signatures )
+      cache.recover( sig.first, sig.second );
+   elapsed = std::max<int64_t>( 1, ( fc::time_point::now() - start ).count() );
+   wlog( "Benchmark: recover ${sps} signatures/s from the cache", ("sps",(count*1000000)/elapsed) );
+}
+
 // See https://bitshares.org/blog/2015/06/08/measuring-performance/
 // (note this is not the original test mentioned in the above post, but was
 //  recreated later according to the description)
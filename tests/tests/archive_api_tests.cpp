@@ -1186,6 +1186,44 @@ BOOST_AUTO_TEST_CASE(get_account_summary) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(account_summary_of_operations_in_one_block) {
+    try {
+        graphene::app::database_api db_api(db);
+        graphene::app::archive_api arch_api(app);
+        const auto& cra = asset_id_type()(db); // core asset
+
+        const auto mario = create_account("mario");
+        const auto marek = create_account("marek");
+        fund(mario, cra.amount(1000 * GRAPHENE_BLOCKCHAIN_PRECISION));
+        generate_block();
+
+        flat_set<fee_parameters> fees;
+        fees.insert(transfer_operation::fee_parameters_type());
+        enable_fees();
+        change_fees(fees);
+        generate_block();
+
+        // both transfers change mario's core balance within one block, before the archive is flushed
+        transfer(mario, marek, cra.amount(100));
+        transfer(mario, marek, cra.amount(200));
+        generate_block();
+
+        const auto nops = arch_api.get_archived_account_operation_count(mario.name);
+        const auto last = arch_api.get_account_summary(mario.name, cra.symbol, nops - 1u, 1u);
+        const auto both = arch_api.get_account_summary(mario.name, cra.symbol, nops - 1u, 2u);
+        BOOST_CHECK_EQUAL(last.summary.debits.value, 200);
+        BOOST_CHECK_EQUAL(both.summary.debits.value, 300);
+        BOOST_CHECK(last.summary.fees.value > 0);
+        BOOST_CHECK_EQUAL(both.summary.fees.value, 2 * last.summary.fees.value);
+        assert_summary(db_api, arch_api, mario, { &cra });
+        assert_summary(db_api, arch_api, marek, { &cra });
+
+    } catch (fc::exception &e) {
+        edump((e.to_detail_string()));
+        throw;
+    }
+}
+
 BOOST_AUTO_TEST_CASE(including_virtual_operations) {
     try {
         graphene::app::database_api db_api(db);
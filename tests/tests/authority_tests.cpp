@@ -2183,6 +2183,55 @@ BOOST_AUTO_TEST_CASE( irrelevant_signatures )
    PUSH_TX( db, trx );
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( authorities_changed_in_block )
+{ try {
+   ACTORS( (alice)(bob) );
+   fund( alice );
+   generate_block();
+
+   const fc::ecc::private_key new_key = generate_private_key( "alice-new" );
+   const auto update_active = [this,alice_id]( const fc::ecc::private_key& key, const fc::ecc::private_key& signer ) {
+      account_update_operation auo;
+      auo.account = alice_id;
+      auo.active = authority( 1, public_key_type( key.get_public_key() ), 1 );
+      trx.clear();
+      set_expiration( db, trx );
+      trx.operations.push_back( auo );
+      sign( trx, signer );
+      PUSH_TX( db, trx );
+   };
+   const auto transfer_to_bob = [this,alice_id,bob_id]( int64_t amount, const fc::ecc::private_key& signer ) {
+      transfer_operation to;
+      to.amount = asset( amount );
+      to.from = alice_id;
+      to.to = bob_id;
+      trx.clear();
+      set_expiration( db, trx );
+      trx.operations.push_back( to );
+      sign( trx, signer );
+      PUSH_TX( db, trx, database::skip_transaction_signatures );
+   };
+
+   // the transfer is not authorized by the state before the block, but by the preceding account update
+   update_active( new_key, alice_private_key );
+   transfer_to_bob( 1, new_key );
+   const signed_block valid_block = generate_block();
+   BOOST_REQUIRE_EQUAL( 2u, valid_block.transactions.size() );
+   db.pop_block();
+   PUSH_BLOCK( db, valid_block, database::skip_nothing );
+   BOOST_CHECK( db.head_block_id() == valid_block.id() );
+   BOOST_CHECK_EQUAL( 1, get_balance( bob_id, asset_id_type() ) );
+
+   // the transfer is authorized by the state before the block, but not after the preceding account update
+   update_active( alice_private_key, new_key );
+   transfer_to_bob( 2, new_key );
+   const signed_block invalid_block = generate_block();
+   BOOST_REQUIRE_EQUAL( 2u, invalid_block.transactions.size() );
+   db.pop_block();
+   GRAPHENE_REQUIRE_THROW( PUSH_BLOCK( db, invalid_block, database::skip_nothing ), fc::exception );
+   BOOST_CHECK( db.head_block_id() == valid_block.id() );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( self_approving_proposal )
 { try {
    ACTORS( (alice) );
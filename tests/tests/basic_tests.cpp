@@ -30,6 +30,8 @@
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/exceptions.hpp>
 
+#include <graphene/protocol/recovered_key_cache.hpp>
+
 #include <graphene/db/simple_index.hpp>
 
 #include <fc/crypto/digest.hpp>
@@ -370,6 +372,42 @@ BOOST_AUTO_TEST_CASE( memo_test )
    BOOST_CHECK_EQUAL(m.get_message(receiver, sender.get_public_key()), "Hello, world!");
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( recovered_key_cache_test )
+{ try {
+   recovered_key_cache cache;
+   cache.set_capacity( 32 );
+   BOOST_CHECK_EQUAL( 32u, cache.capacity() );
+   const auto key = generate_private_key( "1" );
+   const public_key_type pub_key( key.get_public_key() );
+
+   vector< std::pair<digest_type, signature_type> > signatures;
+   for( uint32_t i = 0; i < 100; ++i )
+   {
+      const auto digest = fc::sha256::hash( fc::to_string( i ) );
+      signatures.emplace_back( digest, key.sign_compact( digest ) );
+   }
+   BOOST_CHECK( cache.recover( signatures[0].first, signatures[0].second ) == pub_key );
+   BOOST_CHECK_EQUAL( 1u, cache.size() );
+   BOOST_CHECK( cache.recover( signatures[0].first, signatures[0].second ) == pub_key );
+   BOOST_CHECK_EQUAL( 1u, cache.size() );
+
+   // the cache is bounded, the keys are recovered anyway
+   const auto keys = cache.recover( signatures, 4 );
+   BOOST_REQUIRE_EQUAL( signatures.size(), keys.size() );
+   for( const auto& k : keys )
+      BOOST_CHECK( k == pub_key );
+   BOOST_CHECK( cache.size() <= 32u );
+
+   // a signature of another digest gives another key
+   BOOST_CHECK( cache.recover( signatures[1].first, signatures[0].second ) != pub_key );
+
+   cache.set_capacity( 0 );
+   BOOST_CHECK_EQUAL( 0u, cache.capacity() );
+   BOOST_CHECK_EQUAL( 0u, cache.size() );
+   BOOST_CHECK( cache.recover( signatures[2].first, signatures[2].second ) == pub_key );
+   BOOST_CHECK_EQUAL( 0u, cache.size() );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( exceptions )
 {
    GRAPHENE_CHECK_THROW(FC_THROW_EXCEPTION(balance_claim_invalid_claim_amount, "Etc"), balance_claim_invalid_claim_amount);
@@ -25,6 +25,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include <graphene/chain/database.hpp>
+#include <graphene/chain/binary_snapshot.hpp>
 #include <graphene/chain/exceptions.hpp>
 
 #include <graphene/chain/account_object.hpp>
@@ -32,6 +33,7 @@
 #include <graphene/chain/committee_member_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
 #include <graphene/chain/market_object.hpp>
+#include <graphene/chain/operation_archive_object.hpp>
 #include <graphene/chain/hardfork.hpp>
 #include <graphene/chain/witness_schedule_object.hpp>
 #include <graphene/chain/witness_object.hpp>
@@ -40,6 +42,9 @@
 
 #include <fc/crypto/digest.hpp>
 
+#include <atomic>
+#include <thread>
+
 #include "../common/database_fixture.hpp"
 
 using namespace graphene::chain;
@@ -98,6 +103,11 @@ BOOST_AUTO_TEST_CASE( block_database_test )
          fetch = bdb.fetch_optional( b.id() );
          FC_ASSERT( fetch.valid() );
          FC_ASSERT( fetch->witness ==  b.witness );
+         auto header = bdb.fetch_block_header( i+1 );
+         FC_ASSERT( header.valid() );
+         FC_ASSERT( header->id() == b.id() );
+         auto time = bdb.fetch_block_time( i+1 );
+         FC_ASSERT( time.valid() && *time == b.timestamp );
       }
 
       for( uint32_t i = 1; i < 5; ++i )
@@ -111,6 +121,13 @@ BOOST_AUTO_TEST_CASE( block_database_test )
       FC_ASSERT( last );
       FC_ASSERT( last->id() == b.id() );
 
+      auto packed = bdb.fetch_packed_by_number( 3 );
+      FC_ASSERT( packed.valid() );
+      FC_ASSERT( packed->id == bdb.fetch_block_id( 3 ) );
+      FC_ASSERT( fc::raw::unpack<signed_block>( vector<char>( packed->data.get(), packed->data.get() + packed->size ) )
+                    .id() == packed->id );
+      FC_ASSERT( !bdb.fetch_packed_by_number( 6 ).valid() );
+
       bdb.close();
       bdb.open( data_dir.path() );
       last = bdb.last();
@@ -124,6 +141,189 @@ BOOST_AUTO_TEST_CASE( block_database_test )
          FC_ASSERT( blk->witness == witness_id_type(blk->block_num()) );
       }
 
+      // the blocks read above are served from the decoded block cache now
+      auto stats = bdb.get_cache_stats();
+      FC_ASSERT( stats.entries == 5 );
+      auto blk = bdb.fetch_by_number( 3 );
+      FC_ASSERT( blk.valid() && blk->block_num() == 3 );
+      FC_ASSERT( bdb.get_cache_stats().hits == stats.hits + 1 );
+
+      bdb.remove( blk->id() );
+      FC_ASSERT( bdb.get_cache_stats().entries == 4 );
+      FC_ASSERT( !bdb.fetch_optional( blk->id() ).valid() );
+      FC_ASSERT( !bdb.fetch_shared( blk->id() ) );
+
+      // shared fetches hand out the cached block itself
+      auto shared = bdb.fetch_shared_by_number( 4 );
+      FC_ASSERT( shared && shared->block_num() == 4 );
+      FC_ASSERT( bdb.fetch_shared( shared->id() ) == shared );
+
+      bdb.set_cache_capacity( 0 );
+      FC_ASSERT( bdb.get_cache_stats().entries == 0 );
+      FC_ASSERT( bdb.fetch_by_number( 5 ).valid() );
+      FC_ASSERT( bdb.get_cache_stats().entries == 0 );
+
+      // blocks read while the cache is not filled, like during a replay, are not cached
+      bdb.set_cache_capacity( block_cache::default_capacity );
+      bdb.set_cache_filling( false );
+      FC_ASSERT( bdb.fetch_shared_by_number( 5 ) );
+      FC_ASSERT( bdb.get_cache_stats().entries == 0 );
+      bdb.set_cache_filling( true );
+      FC_ASSERT( bdb.fetch_shared_by_number( 5 ) );
+      FC_ASSERT( bdb.get_cache_stats().entries == 1 );
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_operation_offsets_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+
+      signed_block b;
+      b.witness = witness_id_type(1);
+      for( uint32_t t = 0; t < 3; ++t )
+      {
+         processed_transaction trx;
+         trx.ref_block_num = t;
+         trx.expiration = fc::time_point_sec( 1000 + t );
+         for( uint32_t o = 0; o <= t; ++o )
+         {
+            transfer_operation op;
+            op.from = account_id_type(t);
+            op.to = account_id_type(o);
+            op.amount = asset( 100 * t + o );
+            trx.operations.push_back( op );
+            trx.operation_results.push_back( asset( o ) );
+         }
+         trx.signatures.resize( t );
+         b.transactions.push_back( trx );
+      }
+      bdb.store( b.id(), b );
+
+      const auto check = [&]() {
+         for( uint16_t t = 0; t < 3; ++t )
+         {
+            for( uint16_t o = 0; o <= t; ++o )
+            {
+               operation op;
+               operation_result result;
+               FC_ASSERT( bdb.fetch_operation( 1, t, o, op, &result ) );
+               const auto& transfer = op.get<transfer_operation>();
+               FC_ASSERT( transfer.from == account_id_type(t) && transfer.to == account_id_type(o) );
+               FC_ASSERT( transfer.amount == asset( 100 * t + o ) );
+               FC_ASSERT( result.get<asset>() == asset( o ) );
+            }
+            operation op;
+            FC_ASSERT( !bdb.fetch_operation( 1, t, t + 1, op ) );
+         }
+         operation op;
+         FC_ASSERT( !bdb.fetch_operation( 1, 3, 0, op ) );
+         FC_ASSERT( !bdb.fetch_operation( 2, 0, 0, op ) );
+      };
+      check();
+
+      bdb.close();
+      bdb.open( data_dir.path() );
+      check();
+
+      // a popped block takes its operation offsets along, the block stored in its place reads its own
+      bdb.remove( b.id() );
+      operation op;
+      FC_ASSERT( !bdb.fetch_operation( 1, 0, 0, op ) );
+      FC_ASSERT( !bdb.fetch_block_header( 1 ).valid() );
+
+      signed_block other;
+      other.witness = witness_id_type(2);
+      processed_transaction trx;
+      transfer_operation transfer;
+      transfer.from = account_id_type(7);
+      transfer.amount = asset( 42 );
+      trx.operations.push_back( transfer );
+      trx.operation_results.push_back( void_result() );
+      other.transactions.push_back( trx );
+      bdb.store( other.id(), other );
+
+      const auto check_other = [&]() {
+         operation op;
+         FC_ASSERT( bdb.fetch_operation( 1, 0, 0, op ) );
+         FC_ASSERT( op.get<transfer_operation>().from == account_id_type(7) );
+         FC_ASSERT( op.get<transfer_operation>().amount == asset( 42 ) );
+         FC_ASSERT( !bdb.fetch_operation( 1, 0, 1, op ) );
+         FC_ASSERT( !bdb.fetch_operation( 1, 1, 0, op ) );
+      };
+      check_other();
+
+      bdb.close();
+      bdb.open( data_dir.path() );
+      check_other();
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_concurrent_read_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+
+      clearable_block b;
+      vector<block_id_type> ids;
+      for( uint32_t i = 0; i < 50; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+      }
+
+      // readers must not interfere with each other nor with the writer appending behind them
+      std::atomic<uint32_t> failures{0};
+      vector<std::thread> readers;
+      for( uint32_t t = 0; t < 4; ++t )
+         readers.emplace_back( [&]() {
+            for( uint32_t round = 0; round < 20; ++round )
+               for( uint32_t i = 0; i < ids.size(); ++i )
+               {
+                  auto blk = bdb.fetch_by_number( i+1 );
+                  if( !blk.valid() || blk->witness != witness_id_type(i+1) || !bdb.contains( ids[i] ) )
+                     failures++;
+               }
+         } );
+      for( uint32_t i = 50; i < 100; ++i )
+      {
+         b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+      }
+      for( auto& r : readers )
+         r.join();
+      BOOST_CHECK_EQUAL( failures.load(), 0u );
+
+      // removed blocks disappear, and the index tail is trimmed on reopen
+      bdb.remove( b.id() );
+      BOOST_CHECK( !bdb.contains( b.id() ) );
+      BOOST_CHECK( !bdb.fetch_by_number( 100 ).valid() );
+      bdb.close();
+      bdb.open( data_dir.path() );
+      BOOST_REQUIRE( bdb.last_id().valid() );
+      BOOST_CHECK( *bdb.last_id() == b.previous );
+      BOOST_CHECK( bdb.fetch_by_number( 99 ).valid() );
+      BOOST_CHECK( !bdb.fetch_by_number( 100 ).valid() );
+
    } catch (fc::exception& e) {
       edump((e.to_detail_string()));
       throw;
@@ -189,6 +389,104 @@ BOOST_AUTO_TEST_CASE( generate_empty_blocks )
    }
 }
 
+BOOST_AUTO_TEST_CASE( replay_pipeline )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      block_id_type head_id;
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis, "TEST" );
+         for( uint32_t i = 0; i < 100; ++i )
+            db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         db.close();
+      }
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis, "TEST" );
+         head_id = db.head_block_id();
+         db.close();
+      }
+      {
+         database db;
+         db.wipe( data_dir.path(), false );
+         // a short queue and more threads than blocks in flight, to exercise the waits between the stages
+         db.set_replay_queue_depth( 2 );
+         db.set_replay_threads( 3 );
+         db.open(data_dir.path(), make_genesis, "TEST" );
+         BOOST_CHECK( db.head_block_id() == head_id );
+         db.close();
+      }
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( snapshot_bootstrap )
+{
+   try {
+      fc::temp_directory source_dir( graphene::utilities::temp_directory_path() );
+      fc::temp_directory target_dir( graphene::utilities::temp_directory_path() );
+      const fc::path snapshot_file = source_dir.path() / "snapshot.bin";
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+
+      database source;
+      // the indexes of plugins are not in the snapshot, the target runs without this one
+      source.add_index< primary_index< operation_archive_index > >();
+      BOOST_CHECK( !source.is_chain_index( operation_archive_object::space_id, operation_archive_object::type_id ) );
+      BOOST_CHECK( source.is_chain_index( account_object::space_id, account_object::type_id ) );
+      source.open(source_dir.path(), make_genesis, "TEST" );
+      for( uint32_t i = 0; i < 50; ++i )
+         source.generate_block(source.get_slot_time(1), source.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      binary_snapshot_writer writer( source );
+      writer.write( snapshot_file );
+      const uint32_t snapshot_block = writer.header().block_num;
+      BOOST_REQUIRE( snapshot_block > 0 && snapshot_block <= source.head_block_num() );
+      for( uint32_t i = 0; i < 10; ++i )
+         source.generate_block(source.get_slot_time(1), source.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+
+      {
+         // a snapshot with another state hash is refused
+         fc::temp_directory other_dir( graphene::utilities::temp_directory_path() );
+         database other;
+         other.set_bootstrap_snapshot( snapshot_file, fc::sha256::hash( string("other") ) );
+         GRAPHENE_REQUIRE_THROW( other.open(other_dir.path(), make_genesis, "TEST" ), fc::exception );
+      }
+
+      {
+         database target;
+         target.set_bootstrap_snapshot( snapshot_file, writer.header().state_hash );
+         target.open(target_dir.path(), make_genesis, "TEST" );
+         BOOST_CHECK_EQUAL( target.head_block_num(), snapshot_block );
+         BOOST_CHECK( target.head_block_id() == writer.header().block_id );
+         BOOST_CHECK( target.get_block_id_for_num( snapshot_block ) == writer.header().block_id );
+         // plugins begin at the snapshot block, there are no blocks before it
+         BOOST_CHECK_EQUAL( target.first_block_num(), snapshot_block );
+         BOOST_CHECK_EQUAL( source.first_block_num(), 1u );
+
+         // the following blocks are pushed like received from a peer
+         for( uint32_t num = snapshot_block + 1; num <= source.head_block_num(); ++num )
+            target.push_block( *source.fetch_block_by_number( num ), database::skip_nothing );
+         BOOST_CHECK( target.head_block_id() == source.head_block_id() );
+         source.inspect_all_indexes( [&source,&target]( const graphene::db::index& idx ) {
+            if( source.is_chain_index( idx.object_space_id(), idx.object_type_id() ) )
+               BOOST_CHECK( idx.hash() == target.get_index( idx.object_space_id(), idx.object_type_id() ).hash() );
+         });
+         BOOST_CHECK_EQUAL( target.first_block_num(), snapshot_block );
+         target.close();
+      }
+
+      {
+         // once there is an object database, the snapshot is not loaded again
+         database target;
+         target.set_bootstrap_snapshot( snapshot_file, fc::sha256::hash( string("other") ) );
+         target.open(target_dir.path(), make_genesis, "TEST" );
+         BOOST_CHECK( target.head_block_id() == source.head_block_id() );
+         target.close();
+      }
+      source.close();
+   } FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( undo_block )
 {
    try {
@@ -1924,4 +2222,329 @@ BOOST_FIXTURE_TEST_CASE( block_size_test, database_fixture )
    }
 }
 
+BOOST_FIXTURE_TEST_CASE( generated_block_keeps_pending_state, database_fixture )
+{
+   try
+   {
+      ACTORS((alice)(bob));
+      transfer(committee_account, alice_id, asset(10000000));
+      generate_block();
+
+      const fc::ecc::private_key& key = generate_private_key("null_key");
+      const auto block_interval = db.get_global_properties().parameters.block_interval;
+
+      // the transfers the observers of the generated block see
+      vector<operation_history_object> applied_ops;
+      boost::signals2::scoped_connection connection = db.applied_block.connect( [&]( const signed_block& ) {
+         for( const auto& op : db.get_applied_operations() )
+            if( op.valid() && op->op.is_type<transfer_operation>() )
+               applied_ops.push_back( *op );
+      });
+
+      for( uint64_t i = 1; i <= 3; ++i )
+      {
+         signed_transaction xfer_tx;
+         transfer_operation xfer_op;
+         xfer_op.from = alice_id;
+         xfer_op.to = bob_id;
+         xfer_op.amount = asset(i * 1000);
+         xfer_tx.operations.push_back( xfer_op );
+         xfer_tx.set_expiration( db.head_block_time() + fc::seconds( 0x1000 * block_interval ) );
+         xfer_tx.set_reference_block( db.head_block_id() );
+         sign( xfer_tx, alice_private_key );
+         PUSH_TX( db, xfer_tx, database::skip_nothing );
+      }
+      const int64_t bob_balance = get_balance( bob_id, asset_id_type() );
+      BOOST_CHECK_EQUAL( bob_balance, 6000 );
+
+      auto block = db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), key, database::skip_nothing );
+      BOOST_REQUIRE_EQUAL( block.transactions.size(), 3u );
+      BOOST_CHECK( db.head_block_id() == block.id() );
+      BOOST_CHECK( db.fetch_block_by_number( block.block_num() )->id() == block.id() );
+      BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), bob_balance );
+
+      // the operations applied while generating are reported with their place in the block
+      BOOST_REQUIRE_EQUAL( applied_ops.size(), 3u );
+      for( uint16_t i = 0; i < 3; ++i )
+      {
+         BOOST_CHECK_EQUAL( applied_ops[i].block_num, block.block_num() );
+         BOOST_CHECK_EQUAL( applied_ops[i].trx_in_block, i );
+         BOOST_CHECK_EQUAL( applied_ops[i].op_in_trx, 0u );
+         BOOST_CHECK_EQUAL( applied_ops[i].op.get<transfer_operation>().amount.amount.value, ( i + 1 ) * 1000 );
+      }
+
+      // the kept state is a regular block, which can be popped and pushed again
+      db.pop_block();
+      db.clear_pending();
+      BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 0 );
+      db.push_block( block, database::skip_nothing );
+      BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), bob_balance );
+   }
+   catch( fc::exception& e )
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( pending_transactions_kept_over_block, database_fixture )
+{
+   try
+   {
+      ACTORS((alice)(bob)(carol)(dave));
+      transfer(committee_account, alice_id, asset(1000000));
+      transfer(committee_account, bob_id, asset(1000));
+      transfer(committee_account, carol_id, asset(1000000));
+      transfer(committee_account, dave_id, asset(1000));
+      generate_block();
+
+      const auto make_transfer = [this]( account_id_type from, const fc::ecc::private_key& key,
+                                         account_id_type to, int64_t amount ) {
+         signed_transaction tx;
+         transfer_operation op;
+         op.from = from;
+         op.to = to;
+         op.amount = asset(amount);
+         tx.operations.push_back( op );
+         set_expiration( db, tx );
+         sign( tx, key );
+         return tx;
+      };
+
+      // a block changing the balances of alice and bob, which is popped to push other transactions first
+      PUSH_TX( db, make_transfer( alice_id, alice_private_key, bob_id, 100 ), database::skip_nothing );
+      const signed_block block = generate_block( database::skip_nothing );
+      db.pop_block();
+      db._popped_tx.clear();
+
+      const signed_transaction carol_tx = make_transfer( carol_id, carol_private_key, dave_id, 200 );
+      PUSH_TX( db, carol_tx, database::skip_nothing );
+      PUSH_TX( db, make_transfer( alice_id, alice_private_key, bob_id, 300 ), database::skip_nothing );
+      BOOST_CHECK_EQUAL( db.get_pending_pool_stats().pending, 2u );
+
+      db.push_block( block, database::skip_nothing );
+
+      // the transfer of carol does not depend on the block and is kept, the one of alice is applied again
+      const pending_pool_stats stats = db.get_pending_pool_stats();
+      BOOST_CHECK_EQUAL( stats.pending, 2u );
+      BOOST_CHECK_EQUAL( stats.last_kept, 1u );
+      BOOST_CHECK_EQUAL( stats.last_reapplied, 1u );
+      BOOST_CHECK_EQUAL( stats.last_dropped, 0u );
+      BOOST_CHECK_EQUAL( get_balance( alice_id, asset_id_type() ), 1000000 - 100 - 300 );
+      BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 1000 + 100 + 300 );
+      BOOST_CHECK_EQUAL( get_balance( carol_id, asset_id_type() ), 1000000 - 200 );
+      BOOST_CHECK_EQUAL( get_balance( dave_id, asset_id_type() ), 1000 + 200 );
+
+      // the kept transaction is still a duplicate, and it is included in the next block like the other one
+      GRAPHENE_REQUIRE_THROW( PUSH_TX( db, carol_tx, database::skip_nothing ), fc::exception );
+      const signed_block next_block = generate_block();
+      BOOST_CHECK_EQUAL( next_block.transactions.size(), 2u );
+      BOOST_CHECK_EQUAL( get_balance( dave_id, asset_id_type() ), 1000 + 200 );
+   }
+   catch( fc::exception& e )
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( pending_transactions_reading_head_block_applied_again, database_fixture )
+{
+   try
+   {
+      ACTORS((carol)(dave));
+      transfer(committee_account, carol_id, asset(1000000));
+      upgrade_to_lifetime_member(carol);
+      generate_block();
+
+      // a block which is popped to push other transactions first
+      const signed_block block = generate_block( database::skip_nothing );
+      db.pop_block();
+      db._popped_tx.clear();
+
+      signed_transaction transfer_tx;
+      transfer_operation transfer_op;
+      transfer_op.from = carol_id;
+      transfer_op.to = dave_id;
+      transfer_op.amount = asset(200);
+      transfer_tx.operations.push_back( transfer_op );
+      set_expiration( db, transfer_tx );
+      sign( transfer_tx, carol_private_key );
+      PUSH_TX( db, transfer_tx, database::skip_nothing );
+
+      // the evaluator of account_create_operation reads the head block time, which the block changes
+      signed_transaction create_tx;
+      create_tx.operations.push_back( make_account( "eve", carol, carol, 0, carol_private_key.get_public_key() ) );
+      set_expiration( db, create_tx );
+      sign( create_tx, carol_private_key );
+      PUSH_TX( db, create_tx, database::skip_nothing );
+      BOOST_CHECK_EQUAL( db.get_pending_pool_stats().pending, 2u );
+
+      db.push_block( block, database::skip_nothing );
+
+      const pending_pool_stats stats = db.get_pending_pool_stats();
+      BOOST_CHECK_EQUAL( stats.pending, 2u );
+      BOOST_CHECK_EQUAL( stats.last_kept, 1u );
+      BOOST_CHECK_EQUAL( stats.last_reapplied, 1u );
+      BOOST_CHECK_EQUAL( stats.last_dropped, 0u );
+      BOOST_CHECK_EQUAL( get_account( "eve" ).registrar.instance.value, carol_id.instance.value );
+      BOOST_CHECK_EQUAL( get_balance( dave_id, asset_id_type() ), 200 );
+   }
+   catch( fc::exception& e )
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( pending_pool_fee_priority, database_fixture )
+{
+   try
+   {
+      ACTORS((alice)(bob)(carol)(dave));
+      transfer(committee_account, alice_id, asset(1000000));
+      transfer(committee_account, bob_id, asset(1000000));
+      transfer(committee_account, carol_id, asset(1000000));
+      generate_block();
+
+      uint64_t amount = 0;
+      const auto make_transfer = [this,&amount]( account_id_type from, const fc::ecc::private_key& key, int64_t fee ) {
+         signed_transaction tx;
+         transfer_operation op;
+         op.from = from;
+         op.to = dave_id;
+         op.amount = asset(100 + (amount++ % 2));
+         op.fee = asset(fee);
+         tx.operations.push_back( op );
+         set_expiration( db, tx );
+         sign( tx, key );
+         return tx;
+      };
+
+      // the block takes the highest fee first, then the fee payers take turns, each in the order it pushed
+      db.set_pending_pool_limits( 0, 2 );
+      PUSH_TX( db, make_transfer( alice_id, alice_private_key, 10 ), database::skip_nothing );
+      PUSH_TX( db, make_transfer( alice_id, alice_private_key, 10 ), database::skip_nothing );
+      GRAPHENE_REQUIRE_THROW( PUSH_TX( db, make_transfer( alice_id, alice_private_key, 10 ), database::skip_nothing ),
+                              fc::exception );
+      PUSH_TX( db, make_transfer( carol_id, carol_private_key, 10 ), database::skip_nothing );
+      PUSH_TX( db, make_transfer( bob_id, bob_private_key, 1000 ), database::skip_nothing );
+      BOOST_CHECK_EQUAL( db.get_pending_pool_stats().pending, 4u );
+      BOOST_CHECK_EQUAL( db.get_pending_pool_stats().total_rejected, 1u );
+
+      const signed_block block = generate_block();
+      BOOST_REQUIRE_EQUAL( block.transactions.size(), 4u );
+      const vector<account_id_type> expected_order = { bob_id, alice_id, carol_id, alice_id };
+      for( size_t i = 0; i < expected_order.size(); ++i )
+         BOOST_CHECK( block.transactions[i].operations[0].get<transfer_operation>().from == expected_order[i] );
+
+      // a full pool evicts a lower fee rate for a higher one, and refuses the same fee rate
+      const signed_transaction alice_tx = make_transfer( alice_id, alice_private_key, 10 );
+      const uint64_t tx_size = fc::raw::pack_size( alice_tx );
+      db.set_pending_pool_limits( tx_size + tx_size / 2, 0 );
+      const int64_t alice_balance = get_balance( alice_id, asset_id_type() );
+      PUSH_TX( db, alice_tx, database::skip_nothing );
+      BOOST_CHECK( get_balance( alice_id, asset_id_type() ) < alice_balance );
+      GRAPHENE_REQUIRE_THROW( PUSH_TX( db, make_transfer( carol_id, carol_private_key, 10 ), database::skip_nothing ),
+                              fc::exception );
+      PUSH_TX( db, make_transfer( bob_id, bob_private_key, 1000 ), database::skip_nothing );
+      pending_pool_stats stats = db.get_pending_pool_stats();
+      BOOST_CHECK_EQUAL( stats.pending, 1u );
+      BOOST_CHECK_EQUAL( stats.total_evicted, 1u );
+      BOOST_CHECK_EQUAL( stats.total_rejected, 2u );
+      BOOST_CHECK_EQUAL( get_balance( alice_id, asset_id_type() ), alice_balance );
+
+      // the evicted transaction is neither in the block nor pending after it
+      const signed_block next_block = generate_block();
+      BOOST_REQUIRE_EQUAL( next_block.transactions.size(), 1u );
+      BOOST_CHECK( next_block.transactions[0].operations[0].get<transfer_operation>().from == bob_id );
+      BOOST_CHECK_EQUAL( get_balance( alice_id, asset_id_type() ), alice_balance );
+   }
+   catch( fc::exception& e )
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( pending_pool_evicts_after_applying, database_fixture )
+{
+   try
+   {
+      ACTORS((alice)(bob)(carol)(dave));
+      transfer(committee_account, alice_id, asset(1000000));
+      transfer(committee_account, bob_id, asset(1000000));
+      generate_block();
+
+      uint64_t amount = 0;
+      const auto make_transfer = [this,&amount]( account_id_type from, const fc::ecc::private_key& key, int64_t fee ) {
+         signed_transaction tx;
+         transfer_operation op;
+         op.from = from;
+         op.to = dave_id;
+         op.amount = asset(100 + (amount++ % 2));
+         op.fee = asset(fee);
+         tx.operations.push_back( op );
+         set_expiration( db, tx );
+         sign( tx, key );
+         return tx;
+      };
+
+      // a higher fee rate which cannot be paid evicts nothing from a full pool
+      const signed_transaction alice_tx = make_transfer( alice_id, alice_private_key, 10 );
+      const uint64_t tx_size = fc::raw::pack_size( alice_tx );
+      db.set_pending_pool_limits( tx_size + tx_size / 2, 0 );
+      PUSH_TX( db, alice_tx, database::skip_nothing );
+      GRAPHENE_REQUIRE_THROW( PUSH_TX( db, make_transfer( carol_id, carol_private_key, 1000 ), database::skip_nothing ),
+                              fc::exception );
+      pending_pool_stats stats = db.get_pending_pool_stats();
+      BOOST_CHECK_EQUAL( stats.pending, 1u );
+      BOOST_CHECK_EQUAL( stats.total_evicted, 0u );
+      BOOST_CHECK_EQUAL( stats.total_rejected, 0u );
+
+      signed_block block = generate_block();
+      BOOST_REQUIRE_EQUAL( block.transactions.size(), 1u );
+      BOOST_CHECK( block.transactions[0].operations[0].get<transfer_operation>().from == alice_id );
+
+      // at the limit of its fee payer, a higher fee rate replaces the payer's lowest one, the same one is refused
+      db.set_pending_pool_limits( 0, 2 );
+      PUSH_TX( db, make_transfer( alice_id, alice_private_key, 20 ), database::skip_nothing );
+      const int64_t alice_balance = get_balance( alice_id, asset_id_type() );
+      PUSH_TX( db, make_transfer( alice_id, alice_private_key, 10 ), database::skip_nothing );
+      PUSH_TX( db, make_transfer( bob_id, bob_private_key, 10 ), database::skip_nothing );
+      const int64_t bob_balance = get_balance( bob_id, asset_id_type() );
+      GRAPHENE_REQUIRE_THROW( PUSH_TX( db, make_transfer( alice_id, alice_private_key, 10 ), database::skip_nothing ),
+                              fc::exception );
+      const signed_transaction replacing_tx = make_transfer( alice_id, alice_private_key, 1000 );
+      PUSH_TX( db, replacing_tx, database::skip_nothing );
+      stats = db.get_pending_pool_stats();
+      BOOST_CHECK_EQUAL( stats.pending, 3u );
+      BOOST_CHECK_EQUAL( stats.total_evicted, 1u );
+      BOOST_CHECK_EQUAL( stats.total_rejected, 1u );
+
+      // the changes of the replaced transaction are undone at once, the other pending ones stay
+      const auto& replacing_op = replacing_tx.operations[0].get<transfer_operation>();
+      BOOST_CHECK_EQUAL( get_balance( alice_id, asset_id_type() ),
+                         alice_balance - replacing_op.amount.amount.value - replacing_op.fee.amount.value );
+      BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), bob_balance );
+
+      block = generate_block();
+      BOOST_REQUIRE_EQUAL( block.transactions.size(), 3u );
+      vector<int64_t> alice_fees;
+      for( const auto& tx : block.transactions )
+      {
+         const auto& op = tx.operations[0].get<transfer_operation>();
+         if( op.from == alice_id )
+            alice_fees.push_back( op.fee.amount.value );
+      }
+      // the transactions of a fee payer stay in the order they were pushed
+      BOOST_CHECK( alice_fees == vector<int64_t>( { 20, 1000 } ) );
+   }
+   catch( fc::exception& e )
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -24,14 +24,21 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <graphene/app/api_worker_pool.hpp>
 #include <graphene/app/database_api.hpp>
 #include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/witness_object.hpp>
 
 #include <fc/crypto/digest.hpp>
 
 #include <fc/crypto/hex.hpp>
+#include <fc/io/json.hpp>
 #include "../common/database_fixture.hpp"
 
+#include <atomic>
+#include <future>
+#include <thread>
+
 using namespace graphene::chain;
 using namespace graphene::chain::test;
 
@@ -979,6 +986,172 @@ BOOST_AUTO_TEST_CASE( subscription_notification_test )
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE( subscription_past_indexed_objects_test )
+{
+   try {
+      uint32_t objects_changed1 = 0;
+      auto callback1 = [&]( const variant& v ) { ++objects_changed1; };
+      uint32_t objects_changed2 = 0;
+      auto callback2 = [&]( const variant& v ) { ++objects_changed2; };
+
+      graphene::app::database_api db_api1( db );
+      db_api1.set_subscribe_callback( callback1, false );
+      graphene::app::database_api db_api2( db );
+      db_api2.set_subscribe_callback( callback2, false );
+
+      // more objects than the subscription hub indexes per session, none of them exists
+      vector<object_id_type> ids;
+      for( uint64_t i = 0; i < 10000; ++i )
+         ids.push_back( limit_order_id_type( 1000000 + i ) );
+      db_api1.get_objects( ids );
+
+      // db_api1 is notified of an object subscribed to past the indexed ones
+      vector<object_id_type> obj_ids;
+      obj_ids.push_back( db.get_dynamic_global_properties().id );
+      db_api1.get_objects( obj_ids );
+
+      generate_block();
+      fc::usleep(fc::milliseconds(200)); // sleep a while to execute callback in another thread
+      BOOST_CHECK_GT( objects_changed1, 0u );
+      BOOST_CHECK_EQUAL( objects_changed2, 0u );
+
+      // and no longer after cancelling its subscriptions
+      db_api1.set_subscribe_callback( callback1, false );
+      objects_changed1 = 0;
+
+      generate_block();
+      fc::usleep(fc::milliseconds(200));
+      BOOST_CHECK_EQUAL( objects_changed1, 0u );
+      BOOST_CHECK_EQUAL( objects_changed2, 0u );
+
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( api_worker_pool_test )
+{
+   try {
+      ACTORS( (alice)(bob) );
+      fund( alice );
+
+      graphene::app::api_worker_pool workers( db, 2 );
+      graphene::app::database_api direct_api( db, &( app.get_options() ) );
+      graphene::app::database_api worker_api( db, &( app.get_options() ), &workers );
+
+      vector<object_id_type> ids;
+      ids.push_back( alice_id );
+      ids.push_back( bob_id );
+      ids.push_back( db.get_dynamic_global_properties().id );
+
+      // the calls run on the workers return what they return on the calling thread, and blocks are
+      // applied in between
+      for( uint32_t i = 0; i < 3; ++i )
+      {
+         BOOST_CHECK_EQUAL( fc::json::to_string( fc::variant( worker_api.get_objects( ids ), GRAPHENE_MAX_NESTED_OBJECTS ) ),
+                            fc::json::to_string( fc::variant( direct_api.get_objects( ids ), GRAPHENE_MAX_NESTED_OBJECTS ) ) );
+         const auto worker_accounts = worker_api.get_full_accounts( { "alice", "bob" }, false );
+         const auto direct_accounts = direct_api.get_full_accounts( { "alice", "bob" }, false );
+         BOOST_CHECK_EQUAL( fc::json::to_string( fc::variant( worker_accounts, GRAPHENE_MAX_NESTED_OBJECTS ) ),
+                            fc::json::to_string( fc::variant( direct_accounts, GRAPHENE_MAX_NESTED_OBJECTS ) ) );
+         generate_block();
+      }
+
+      // exceptions are rethrown on the calling thread
+      GRAPHENE_REQUIRE_THROW( worker_api.get_account_balances( "nobody", {} ), fc::exception );
+
+      const fc::variant_object statistics = workers.get_call_statistics();
+      BOOST_CHECK( statistics.contains( "_note" ) );
+      BOOST_CHECK_EQUAL( statistics["get_objects"]["count"].as_uint64(), 3u );
+      BOOST_CHECK_EQUAL( statistics["get_full_accounts"]["count"].as_uint64(), 3u );
+      BOOST_CHECK_EQUAL( statistics["get_account_balances"]["count"].as_uint64(), 1u );
+      BOOST_CHECK( !statistics.contains( "get_accounts" ) );
+
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( api_worker_pool_concurrent_blocks_test )
+{
+   try {
+      ACTORS( (alice)(bob) );
+      fund( alice );
+      generate_block();
+
+      graphene::app::api_worker_pool workers( db, 2 );
+      graphene::app::database_api worker_api( db, &( app.get_options() ), &workers );
+
+      // a consistent state has the witness of the head block confirming it
+      vector<object_id_type> ids;
+      ids.push_back( db.get_dynamic_global_properties().id );
+      for( const auto& w : db.get_global_properties().active_witnesses )
+         ids.push_back( w );
+
+      struct observed_head
+      {
+         uint32_t      block_num;
+         block_id_type block_id;
+         uint32_t      confirmed_by_witness;
+      };
+
+      // the calls are made from several threads while this one pushes transactions and blocks,
+      // the results are checked here afterwards, as the checks are not thread safe
+      std::atomic<bool> done( false );
+      std::atomic<uint32_t> started( 0 );
+      const auto read_heads = [&]() {
+         vector<observed_head> heads;
+         bool counted = false;
+         while( !done.load() )
+         {
+            const auto objects = worker_api.get_objects( ids );
+            const auto dgpo = objects[0].as<dynamic_global_property_object>( GRAPHENE_MAX_NESTED_OBJECTS );
+            observed_head head{ dgpo.head_block_number, dgpo.head_block_id, 0 };
+            for( size_t i = 1; i < objects.size(); ++i )
+            {
+               const auto witness = objects[i].as<witness_object>( GRAPHENE_MAX_NESTED_OBJECTS );
+               if( witness.id == object_id_type( dgpo.current_witness ) )
+                  head.confirmed_by_witness = witness.last_confirmed_block_num;
+            }
+            heads.push_back( head );
+            if( !counted )
+            {
+               counted = true;
+               ++started;
+            }
+         }
+         return heads;
+      };
+      const uint32_t num_readers = 4;
+      vector< std::future< vector<observed_head> > > readers;
+      for( uint32_t i = 0; i < num_readers; ++i )
+         readers.push_back( std::async( std::launch::async, read_heads ) );
+      while( started.load() < num_readers )
+         std::this_thread::yield();
+
+      const uint32_t first_block = db.head_block_num();
+      for( uint32_t i = 0; i < 10; ++i )
+      {
+         transfer( alice_id, bob_id, asset( 1 ) );
+         generate_block();
+      }
+      done = true;
+
+      for( auto& reader : readers )
+      {
+         const auto heads = reader.get();
+         BOOST_REQUIRE( !heads.empty() );
+         uint32_t previous = first_block;
+         for( const auto& head : heads )
+         {
+            // each call sees the state at a block of the chain, never one in between, and no older one than before
+            BOOST_CHECK_GE( head.block_num, previous );
+            BOOST_CHECK_LE( head.block_num, db.head_block_num() );
+            BOOST_CHECK( head.block_id == db.get_block_id_for_num( head.block_num ) );
+            BOOST_CHECK_EQUAL( head.confirmed_by_witness, head.block_num );
+            previous = head.block_num;
+         }
+      }
+
+   } FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( lookup_vote_ids )
 { try {
    ACTORS( (connie)(whitney)(wolverine) );
@@ -27,10 +27,17 @@
 #include <graphene/chain/database.hpp>
 
 #include <graphene/chain/account_object.hpp>
+#include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
+#include <graphene/chain/operation_archive_object.hpp>
+#include <graphene/chain/binary_snapshot.hpp>
+
+#include <graphene/utilities/tempdir.hpp>
 
 #include <fc/crypto/digest.hpp>
 
+#include <fstream>
+
 #include "../common/database_fixture.hpp"
 
 using namespace graphene::chain;
@@ -63,6 +70,54 @@ BOOST_AUTO_TEST_CASE( undo_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( operation_archive_index_undo_test )
+{
+   try {
+      const auto& archive = db.get_index_type<operation_archive_index>();
+      const auto initial_size = archive.size();
+
+      auto ses = db._undo_db.start_undo_session();
+      for( uint16_t i = 0; i < 3; ++i )
+         db.create<operation_archive_object>( [&]( operation_archive_object& o ){
+            o.block_num = 1000 + i;
+            o.trx_in_block = i;
+            o.op_in_trx = i + 1;
+            o.operation_id = i;
+         });
+      BOOST_REQUIRE_EQUAL( archive.size(), initial_size + 3 );
+
+      const auto oao = archive.at( initial_size + 1 );
+      BOOST_CHECK( oao.id == operation_archive_id_type( initial_size + 1 ) );
+      BOOST_CHECK_EQUAL( oao.block_num, 1001u );
+      BOOST_CHECK_EQUAL( oao.trx_in_block, 1u );
+      BOOST_CHECK_EQUAL( oao.op_in_trx, 2u );
+      BOOST_CHECK( !oao.has_virtual_op() );
+      BOOST_CHECK( db.find_object( operation_archive_id_type( initial_size + 2 ) ) != nullptr );
+
+      // references handed out by the index are not overwritten by later lookups
+      const auto& first = db.get( operation_archive_id_type( initial_size ) );
+      const auto& second = db.get( operation_archive_id_type( initial_size + 1 ) );
+      BOOST_CHECK_EQUAL( first.block_num, 1000u );
+      BOOST_CHECK_EQUAL( second.block_num, 1001u );
+      db.modify( first, []( operation_archive_object& o ){ o.virtual_op = 7; } );
+      BOOST_CHECK_EQUAL( first.virtual_op, 7u );
+      BOOST_CHECK_EQUAL( second.virtual_op, 0u );
+      archive.release_views();
+      BOOST_CHECK_EQUAL( db.get( operation_archive_id_type( initial_size ) ).virtual_op, 7u );
+      BOOST_CHECK_EQUAL( archive.at( initial_size ).virtual_op, 7u );
+
+      // undo truncates the records
+      ses.undo();
+      BOOST_CHECK_EQUAL( archive.size(), initial_size );
+      BOOST_CHECK( db.find_object( operation_archive_id_type( initial_size ) ) == nullptr );
+      BOOST_CHECK( archive.get_next_id() == operation_archive_id_type( initial_size ) );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
 /**
  * Check that database modify() functors that throw do not get caught by boost, which will remove the object
  */
@@ -223,6 +278,159 @@ BOOST_AUTO_TEST_CASE( direct_index_test )
    // but the secondary has not updated its representation
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( primary_index_open_test )
+{ try {
+   typedef graphene::db::primary_index< account_index, 8 > index_type;
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const auto file = data_dir.path() / "accounts";
+   // large enough to be decoded by several threads where available
+   const uint32_t n = 2 * index_type::objects_per_load_task + 5;
+
+   {
+      index_type saved( db );
+      account_object test_account;
+      for( uint32_t i = 0; i < n; i++ )
+      {
+         test_account.id = account_id_type(i);
+         test_account.name = "account" + std::to_string( i );
+         test_account.referrer = account_id_type( i % 7 );
+         saved.load( fc::raw::pack( test_account ) );
+      }
+      saved.save( file );
+   }
+
+   index_type opened( db );
+   const auto* referrers = opened.add_secondary_index<account_referrer_index>();
+   opened.open( file );
+   BOOST_REQUIRE_EQUAL( n, opened.indices().size() );
+
+   const auto& direct = opened.get_secondary_index<graphene::db::direct_index< account_object, 8 >>();
+   for( uint32_t i = 0; i < n; i++ )
+      BOOST_CHECK_EQUAL( "account" + std::to_string( i ), direct.get( account_id_type(i) ).name );
+   BOOST_CHECK_EQUAL( (n + 3) / 7, referrers->referred_by.at( account_id_type(3) ).size() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( object_database_checkpoint_test )
+{ try {
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const fc::path accounts_file = data_dir.path() / "object_database" / fc::to_string( account_object::space_id )
+                                                  / fc::to_string( account_object::type_id );
+   const fc::path assets_file = data_dir.path() / "object_database" / fc::to_string( asset_object::space_id )
+                                                / fc::to_string( asset_object::type_id );
+
+   graphene::db::object_database odb;
+   odb.add_index< primary_index< account_index > >();
+   odb.add_index< primary_index< asset_index > >();
+   odb.open( data_dir.path() );
+
+   odb._undo_db.disable();
+   const account_id_type alice_id = odb.create<account_object>( []( account_object& a ) { a.name = "alice"; } ).id;
+   const account_id_type bob_id = odb.create<account_object>( []( account_object& a ) { a.name = "bob"; } ).id;
+   odb._undo_db.enable();
+   {
+      // changes still in the undo history are not written
+      auto session = odb._undo_db.start_undo_session();
+      odb.modify( odb.get( alice_id ), []( account_object& a ) { a.name = "alice2"; } );
+      odb.remove( odb.get( bob_id ) );
+      odb.create<account_object>( []( account_object& a ) { a.name = "charlie"; } );
+      odb.checkpoint( fc::mutable_variant_object( "head_block_num", 1 ) );
+      odb.wait_for_checkpoint();
+      session.commit();
+   }
+   BOOST_CHECK( fc::exists( accounts_file ) );
+   BOOST_CHECK( !fc::exists( assets_file ) );
+   BOOST_CHECK( !fc::exists( data_dir.path() / "object_database" / "checkpoint" ) );
+
+   {
+      graphene::db::object_database opened;
+      opened.add_index< primary_index< account_index > >();
+      opened.add_index< primary_index< asset_index > >();
+      opened.open( data_dir.path() );
+      const auto& accounts = opened.get_index_type< primary_index< account_index > >();
+      BOOST_CHECK_EQUAL( 2u, accounts.indices().size() );
+      BOOST_CHECK_EQUAL( "alice", opened.get( alice_id ).name );
+      BOOST_CHECK_EQUAL( "bob", opened.get( bob_id ).name );
+      BOOST_CHECK( object_id_type( account_id_type(2) ) == accounts.get_next_id() );
+   }
+
+   // the committed changes are written by the next checkpoint, an interrupted one is discarded
+   odb._undo_db.set_max_size( 0 );
+   odb._undo_db.start_undo_session();
+   odb.checkpoint( fc::variant_object() );
+   odb.wait_for_checkpoint();
+   fc::create_directories( assets_file.parent_path() );
+   {
+      std::ofstream interrupted( assets_file.generic_string() + ".tmp" );
+      interrupted << "garbage";
+   }
+   {
+      graphene::db::object_database opened;
+      opened.add_index< primary_index< account_index > >();
+      opened.add_index< primary_index< asset_index > >();
+      opened.open( data_dir.path() );
+      BOOST_CHECK( !fc::exists( assets_file.generic_string() + ".tmp" ) );
+      BOOST_CHECK_EQUAL( 2u, opened.get_index_type< primary_index< account_index > >().indices().size() );
+      BOOST_CHECK_EQUAL( "alice2", opened.get( alice_id ).name );
+      BOOST_CHECK( nullptr == opened.find( bob_id ) );
+      BOOST_CHECK_EQUAL( "charlie", opened.get( account_id_type(2) ).name );
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( binary_snapshot_test )
+{ try {
+   ACTORS( (alice)(bob) );
+   transfer( committee_account, alice_id, asset( 1000 ) );
+   generate_block();
+
+   // enough blocks for some to become irreversible
+   generate_blocks( 20 );
+
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const fc::path snapshot_file = data_dir.path() / "snapshot.bin";
+   binary_snapshot_writer writer( db );
+   // the state is the one the undo history can return to
+   BOOST_REQUIRE( writer.header().block_num > 0 );
+   BOOST_CHECK_EQUAL( db.head_block_num() - db._undo_db.size(), writer.header().block_num );
+   writer.write( snapshot_file );
+   BOOST_CHECK( !fc::exists( snapshot_file.generic_string() + ".tmp" ) );
+
+   // return to the state of the snapshot to compare it
+   while( db.head_block_num() > writer.header().block_num )
+      db.pop_block();
+
+   // the indexes of the plugins the fixture runs are not in the snapshot
+   database loaded;
+   loaded.initialize_indexes();
+   const auto header = load_binary_snapshot( loaded, snapshot_file );
+   BOOST_CHECK( header.chain_id == db.get_chain_id() );
+   BOOST_CHECK_EQUAL( header.block_num, db.head_block_num() );
+   BOOST_CHECK( header.block_id == db.head_block_id() );
+   db.inspect_all_indexes( [this,&loaded]( const graphene::db::index& idx ) {
+      if( !db.is_chain_index( idx.object_space_id(), idx.object_type_id() ) )
+         return;
+      const auto& loaded_idx = loaded.get_index( idx.object_space_id(), idx.object_type_id() );
+      BOOST_CHECK( idx.hash() == loaded_idx.hash() );
+      BOOST_CHECK( idx.get_next_id() == loaded_idx.get_next_id() );
+   });
+   BOOST_CHECK_EQUAL( "alice", loaded.get( alice_id ).name );
+   BOOST_CHECK_EQUAL( 1000, loaded.get_balance( alice_id, asset_id_type() ).amount.value );
+
+   // a damaged index is detected by its checksum
+   std::vector<char> content;
+   {
+      std::ifstream in( snapshot_file.generic_string(), std::ifstream::binary );
+      content.assign( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() );
+   }
+   content.back() ^= 1;
+   {
+      std::ofstream out( snapshot_file.generic_string(), std::ofstream::binary | std::ofstream::trunc );
+      out.write( content.data(), content.size() );
+   }
+   database damaged;
+   damaged.initialize_indexes();
+   GRAPHENE_REQUIRE_THROW( load_binary_snapshot( damaged, snapshot_file ), fc::exception );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( required_approval_index_test ) // see https://github.com/bitshares/bitshares-core/issues/1719
 { try {
    ACTORS( (alice)(bob)(charlie)(agnetha)(benny)(carlos) );
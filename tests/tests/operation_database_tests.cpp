@@ -25,10 +25,15 @@
 #include <boost/test/unit_test.hpp>
 
 #include <graphene/account_archive/operation_database.hpp>
+#include <graphene/account_archive/block_time_index.hpp>
+#include <graphene/account_archive/account_operation_database.hpp>
+#include <graphene/account_archive/account_summary_database.hpp>
 #include <graphene/utilities/tempdir.hpp>
 
 #include <fc/crypto/digest.hpp>
 
+#include <algorithm>
+
 #include "../common/database_fixture.hpp"
 
 using namespace graphene::chain;
@@ -136,6 +141,8 @@ BOOST_AUTO_TEST_CASE(op_db_store_load_sigle) {
         opdb.wipe(dir);
         opdb.open(dir);
         index = opdb.store(stored);
+        BOOST_CHECK_THROW(opdb.load(index), fc::key_not_found_exception);
+        opdb.flush();
         loaded = opdb.load(index);
         opdb.close();
 
@@ -164,6 +171,7 @@ BOOST_AUTO_TEST_CASE(op_db_store_load_multiple) {
         opdb.open(dir);
         for (size_t i = 0; i < n; i++) {
             indices[i] = opdb.store(ohos[i]);
+            opdb.flush();
             const auto loaded = opdb.load(indices[i]);
             check_ohos_equal(ohos[i], loaded);
         }
@@ -183,6 +191,7 @@ BOOST_AUTO_TEST_CASE(op_db_store_load_multiple) {
         opdb.open(dir);
         for (size_t i = 0; i < n; i++) {
             indices[n + i] = opdb.store(ohos[i]);
+            opdb.flush();
             const auto loaded = opdb.load(indices[n - i - 1]);
             check_ohos_equal(ohos[n - i - 1], loaded);
         }
@@ -220,6 +229,7 @@ BOOST_AUTO_TEST_CASE(op_db_truncate) {
         opdb.open(dir);
         for (size_t i = 0; i < n; i++) {
             indices[i] = opdb.store(ohos[i]);
+            opdb.flush();
             const auto loaded = opdb.load(indices[i]);
             check_ohos_equal(ohos[i], loaded);
         }
@@ -248,6 +258,15 @@ BOOST_AUTO_TEST_CASE(op_db_truncate) {
             const auto index = opdb.store(ohos[i]);
             BOOST_CHECK_EQUAL(index, indices[i]);
         }
+        opdb.flush();
+
+        // ranges spanning the records written before and after the truncation
+
+        const auto range = opdb.load(0, n);
+        BOOST_REQUIRE_EQUAL(range.size(), n);
+        for (size_t i = 0; i < n; i++)
+            check_ohos_equal(ohos[i], range[i]);
+        BOOST_CHECK_THROW(opdb.load(n - 1, 2), fc::exception);
 
         // truncate multiple times
 
@@ -256,12 +275,259 @@ BOOST_AUTO_TEST_CASE(op_db_truncate) {
         opdb.truncate(b);
         opdb.truncate(b);
 
-        for (size_t i = 0; i < opdb.get_stored_operation_count(); i++) {
+        const size_t count_after_truncate = opdb.get_stored_operation_count();
+        for (size_t i = 0; i < count_after_truncate; i++) {
             const auto loaded = opdb.load(indices[i]);
             check_ohos_equal(ohos[i], loaded);
         }
         opdb.close();
 
+        // the truncated records are removed from the files
+
+        uint64_t stored_bytes = 0;
+        for (size_t i = 0; i < count_after_truncate; i++)
+            stored_bytes += fc::raw::pack_size(ohos[i]);
+        BOOST_CHECK_EQUAL(fc::file_size(dir / "operation_database" / "operations"), stored_bytes);
+        BOOST_CHECK_EQUAL(fc::file_size(dir / "operation_database" / "indices"), count_after_truncate * 16u);
+
+        // truncating past the last stored block keeps everything, also after a fresh open
+
+        opdb.open(dir);
+        const auto count = opdb.get_stored_operation_count();
+        BOOST_REQUIRE(count > 0);
+        opdb.truncate(ohos[count - 1].block_num + 1);
+        BOOST_CHECK_EQUAL(opdb.get_stored_operation_count(), count);
+        check_ohos_equal(ohos[count - 1], opdb.load(indices[count - 1]));
+
+        // truncating everything leaves an empty database
+        opdb.truncate(0);
+        BOOST_CHECK_EQUAL(opdb.get_stored_operation_count(), 0u);
+        opdb.close();
+        opdb.open(dir);
+        BOOST_CHECK_EQUAL(opdb.get_stored_operation_count(), 0u);
+        opdb.close();
+
+    } catch (fc::exception &e) {
+        edump((e.to_detail_string()));
+        throw;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(block_time_index_lower_bound) {
+    try {
+        const auto dir = fc::temp_directory(graphene::utilities::temp_directory_path()).path();
+        block_time_index bti;
+
+        const fc::time_point_sec genesis(1500000000);
+        const uint32_t interval = 3;
+
+        bti.wipe(dir);
+        bti.open(dir);
+        BOOST_CHECK_EQUAL(bti.get_block_count(), 0u);
+        BOOST_CHECK_EQUAL(bti.lower_bound(genesis), 0u);
+
+        for (uint32_t n = 1; n <= 100; n++)
+            bti.set(n, genesis + n * interval);
+        // nothing is visible before flush
+        BOOST_CHECK_EQUAL(bti.get_block_count(), 0u);
+        bti.flush();
+        BOOST_CHECK_EQUAL(bti.get_block_count(), 101u);
+
+        BOOST_CHECK_EQUAL(bti.lower_bound(genesis), 1u);
+        BOOST_CHECK_EQUAL(bti.lower_bound(genesis + 3), 1u);
+        BOOST_CHECK_EQUAL(bti.lower_bound(genesis + 4), 2u);
+        BOOST_CHECK_EQUAL(bti.lower_bound(genesis + 150), 50u);
+        BOOST_CHECK_EQUAL(bti.lower_bound(genesis + 300), 100u);
+        BOOST_CHECK_EQUAL(bti.lower_bound(genesis + 301), 101u);
+        BOOST_CHECK(*bti.get(42) == genesis + 42 * interval);
+        BOOST_CHECK(!bti.get(101).valid());
+
+        // popping blocks drops their records
+        bti.set(60, genesis + 60 * interval + 1);
+        bti.flush();
+        BOOST_CHECK_EQUAL(bti.get_block_count(), 61u);
+        BOOST_CHECK_EQUAL(bti.lower_bound(genesis + 200), 61u);
+        BOOST_CHECK_EQUAL(bti.lower_bound(genesis + 181), 60u);
+        bti.close();
+
+        // the dropped records are kept on disk until the plugin reconciles them with the chain head
+        bti.open(dir);
+        BOOST_CHECK_EQUAL(bti.get_block_count(), 101u);
+        BOOST_CHECK(*bti.get(60) == genesis + 60 * interval + 1);
+
+        // reconciling with a wiped chain drops all of them
+        bti.truncate(1);
+        BOOST_CHECK_EQUAL(bti.get_block_count(), 1u);
+        BOOST_CHECK(!bti.get(60).valid());
+        bti.close();
+        bti.open(dir);
+        BOOST_CHECK_EQUAL(bti.get_block_count(), 1u);
+        BOOST_CHECK_EQUAL(bti.lower_bound(genesis), 1u);
+        bti.close();
+
+    } catch (fc::exception &e) {
+        edump((e.to_detail_string()));
+        throw;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(block_times_dropped_on_pop) {
+    try {
+        auto aaplugin = app.get_plugin<account_archive_plugin>("account_archive");
+        BOOST_REQUIRE(aaplugin);
+
+        generate_blocks(5);
+        const uint32_t head = db.head_block_num();
+        const auto head_time = db.head_block_time();
+        BOOST_CHECK_EQUAL(aaplugin->find_block_by_time(head_time), head);
+        BOOST_CHECK_EQUAL(aaplugin->find_block_by_time(head_time + 1), head + 1);
+
+        // the popped block's time is dropped right away, not at the next restart
+        db.pop_block();
+        BOOST_CHECK_EQUAL(aaplugin->find_block_by_time(head_time), head);
+        BOOST_CHECK_EQUAL(aaplugin->find_block_by_time(head_time + 1), head);
+
+        generate_block();
+        BOOST_CHECK_EQUAL(db.head_block_num(), head);
+        BOOST_CHECK_EQUAL(aaplugin->find_block_by_time(db.head_block_time()), head);
+
+    } catch (fc::exception &e) {
+        edump((e.to_detail_string()));
+        throw;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(account_operation_db_append_undo) {
+    try {
+        const auto dir = fc::temp_directory(graphene::utilities::temp_directory_path()).path();
+        account_operation_database aodb;
+        const uint32_t n = 3 * account_operation_database::chunk_size + 5;
+
+        aodb.wipe(dir);
+        aodb.open(dir);
+
+        // interleave two accounts so that their chunks are interleaved too
+        account_archive_object a, b;
+        for (uint32_t i = 0; i < n; i++) {
+            aodb.append(a, operation_archive_id_type(2 * i));
+            aodb.append(b, operation_archive_id_type(2 * i + 1));
+        }
+        aodb.flush();
+        BOOST_CHECK_EQUAL(a.num_operations, n);
+        BOOST_CHECK_EQUAL(a.chunks.size(), 4u);
+        for (uint32_t i = 0; i < n; i++) {
+            BOOST_CHECK(aodb.get(a, i) == operation_archive_id_type(2 * i));
+            BOOST_CHECK(aodb.get(b, i) == operation_archive_id_type(2 * i + 1));
+        }
+        BOOST_CHECK_THROW(aodb.get(a, n), fc::exception);
+
+        // undo restores the remembered number of operations, the chunks are reused
+        auto remembered = a.clone();
+        for (uint32_t i = 0; i < account_operation_database::chunk_size; i++)
+            aodb.append(a, operation_archive_id_type(1000000 + i));
+        BOOST_CHECK_EQUAL(a.chunks.size(), 5u);
+        a.move_from(*remembered);
+        BOOST_CHECK_EQUAL(a.num_operations, n);
+        aodb.append(a, operation_archive_id_type(7));
+        aodb.flush();
+        BOOST_CHECK_EQUAL(a.chunks.size(), 5u);
+        BOOST_CHECK(aodb.get(a, n) == operation_archive_id_type(7));
+        BOOST_CHECK(aodb.get(a, n - 1) == operation_archive_id_type(2 * (n - 1)));
+
+        // the chunks of an archive removed by undo are reused by the next archive
+        const uint32_t m = account_operation_database::chunk_size + 1;
+        account_archive_object c, d;
+        for (uint32_t i = 0; i < m; i++)
+            aodb.append(c, operation_archive_id_type(i));
+        const auto released = c.chunks;
+        aodb.release(c);
+        for (uint32_t i = 0; i < m; i++)
+            aodb.append(d, operation_archive_id_type(3 * i));
+        aodb.flush();
+        BOOST_CHECK(std::is_permutation(d.chunks.begin(), d.chunks.end(), released.begin(), released.end()));
+        for (uint32_t i = 0; i < m; i++)
+            BOOST_CHECK(aodb.get(d, i) == operation_archive_id_type(3 * i));
+        for (uint32_t i = 0; i < n; i++)
+            BOOST_CHECK(aodb.get(b, i) == operation_archive_id_type(2 * i + 1));
+        aodb.close();
+
+        // the lists survive reopening
+        aodb.open(dir);
+        for (uint32_t i = 0; i < n; i++)
+            BOOST_CHECK(aodb.get(b, i) == operation_archive_id_type(2 * i + 1));
+        aodb.close();
+
+    } catch (fc::exception &e) {
+        edump((e.to_detail_string()));
+        throw;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(account_summary_db_range_undo) {
+    try {
+        const auto dir = fc::temp_directory(graphene::utilities::temp_directory_path()).path();
+        account_summary_database asdb;
+        const uint32_t n = 2 * account_summary_database::chunk_size + 3;
+        const asset_id_type core, eur(1);
+
+        asdb.wipe(dir);
+        asdb.open(dir);
+
+        // every operation credits i to core, every other debits 1 of eur
+        account_archive_object a;
+        for (uint32_t i = 0; i < n; i++) {
+            flat_map<asset_id_type, account_summary> changes;
+            changes[core].credits = i;
+            if (i % 2)
+                changes[eur].debits = 1;
+            a.num_operations++;
+            asdb.append(a, changes);
+        }
+        asdb.flush();
+        BOOST_CHECK_EQUAL(a.summaries[core].num_entries, n);
+        BOOST_CHECK_EQUAL(a.summaries[eur].num_entries, n / 2);
+
+        const auto check_range = [&](uint32_t first, uint32_t end) {
+            int64_t credits = 0, debits = 0;
+            for (uint32_t i = first; i < end; i++) {
+                credits += i;
+                debits += i % 2;
+            }
+            BOOST_CHECK_EQUAL(asdb.get(a, core, first, end).credits.value, credits);
+            BOOST_CHECK_EQUAL(asdb.get(a, eur, first, end).debits.value, debits);
+            BOOST_CHECK_EQUAL(asdb.get(a, eur, first, end).credits.value, 0);
+        };
+        check_range(0, n);
+        check_range(1, 2);
+        check_range(5, n - 7);
+        check_range(n - 1, n);
+        BOOST_CHECK_EQUAL(asdb.get(a, asset_id_type(2), 0, n).credits.value, 0);
+
+        // undo restores the remembered number of entries, appended entries overwrite the undone ones
+        auto remembered = a.clone();
+        for (uint32_t i = 0; i < 3; i++) {
+            flat_map<asset_id_type, account_summary> changes;
+            changes[core].credits = 1000;
+            changes[asset_id_type(2)].fees = 1;
+            a.num_operations++;
+            asdb.append(a, changes);
+        }
+        a.move_from(*remembered);
+        BOOST_CHECK_EQUAL(a.summaries[core].num_entries, n);
+        BOOST_CHECK_EQUAL(a.summaries[asset_id_type(2)].num_entries, 0u);
+        BOOST_CHECK_EQUAL(asdb.get(a, asset_id_type(2), 0, n + 3).fees.value, 0);
+        check_range(0, n);
+
+        // appending after an undo continues from the restored totals
+        flat_map<asset_id_type, account_summary> changes;
+        changes[core].credits = 5;
+        a.num_operations++;
+        asdb.append(a, changes);
+        asdb.flush();
+        BOOST_CHECK_EQUAL(asdb.get(a, core, n, n + 1).credits.value, 5);
+        check_range(0, n);
+        asdb.close();
+
     } catch (fc::exception &e) {
         edump((e.to_detail_string()));
         throw;
@@ -25,6 +25,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include <graphene/chain/database.hpp>
+#include <graphene/net/core_messages.hpp>
 
 
 #include <fc/crypto/digest.hpp>
@@ -112,4 +113,36 @@ BOOST_AUTO_TEST_CASE( extension_serialization_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( net_message_shares_payload_test )
+{
+   try
+   {
+      signed_block block;
+      block.timestamp = fc::time_point_sec( 1234567 );
+      block.witness = witness_id_type( 5 );
+
+      graphene::net::message msg( graphene::net::block_message( block ) );
+      graphene::net::message copy( msg );
+      BOOST_CHECK( copy.data.data() == msg.data.data() );
+      BOOST_CHECK( copy.id() == msg.id() );
+      BOOST_CHECK( copy.as<graphene::net::block_message>().block_id == block.id() );
+
+      // modifying a copy leaves the other messages alone
+      copy.data.mutable_bytes()[0] ^= 1;
+      BOOST_CHECK( copy.data.data() != msg.data.data() );
+      BOOST_CHECK( copy.id() != msg.id() );
+      BOOST_CHECK( msg.as<graphene::net::block_message>().block_id == block.id() );
+
+      auto packed = fc::raw::pack( msg );
+      graphene::net::message unpacked = fc::raw::unpack<graphene::net::message>( packed );
+      BOOST_CHECK_EQUAL( unpacked.msg_type.value(), msg.msg_type.value() );
+      BOOST_CHECK( unpacked.data.bytes() == msg.data.bytes() );
+   }
+   catch ( const fc::exception& e )
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()